@@ -0,0 +1,414 @@
+//
+// AssetLoader.cpp
+//
+
+#include "pch.h"
+#include "AssetLoader.h"
+
+#include <chrono>
+
+#include "Gfx/SdkMesh.h"
+
+using namespace DirectX;
+using namespace DirectX::SimpleMath;
+
+namespace
+{
+	std::vector<uint8_t> ReadFile(const std::wstring& path)
+	{
+		std::ifstream file(path, std::ios::binary | std::ios::ate);
+		if (!file)
+		{
+			throw std::runtime_error("Cannot open file");
+		}
+		std::vector<uint8_t> data(static_cast<size_t>(file.tellg()));
+		file.seekg(0);
+		file.read(reinterpret_cast<char*>(data.data()), data.size());
+		if (!file)
+		{
+			throw std::runtime_error("Cannot read file");
+		}
+		return data;
+	}
+
+	// Contents of a texture and their hash; a missing file is a key of its
+	// own, hash 0
+	uint64_t ReadTexture(const std::wstring& path, std::vector<uint8_t>& data)
+	{
+		try
+		{
+			data = ReadFile(path);
+		}
+		catch (const std::exception&)
+		{
+			data.clear();
+		}
+		return data.empty() ? 0 : Gfx::ContentHash(data.data(), data.size());
+	}
+
+	bool IsDds(const std::wstring& path)
+	{
+		auto extension = std::filesystem::path(path).extension().wstring();
+		return Gfx::NormalizeAssetPath(extension) == L".dds";
+	}
+
+	// Samples as black
+	void WriteNullTexture(ID3D12Device* device, D3D12_CPU_DESCRIPTOR_HANDLE descriptor)
+	{
+		D3D12_SHADER_RESOURCE_VIEW_DESC description = {};
+		description.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+		description.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+		description.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+		description.Texture2D.MipLevels = 1;
+		device->CreateShaderResourceView(nullptr, &description, descriptor);
+	}
+
+	bool IsReady(const std::shared_future<void>& upload)
+	{
+		return !upload.valid() || upload.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+	}
+}
+
+AssetLoader::AssetLoader(ID3D12Device* device, ID3D12CommandQueue* queue, CommonStates& states,
+	const RenderTargetState& renderTarget, D3D12RenderBackend& backend, size_t threads) :
+	m_device(device),
+	m_queue(queue),
+	m_states(states),
+	m_renderTarget(renderTarget),
+	m_backend(backend),
+	m_models(MAX_MODELS),
+	m_textures(MAX_TEXTURES),
+	m_workers(threads)
+{
+	m_textureHeap = std::make_unique<DescriptorHeap>(device, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV,
+		D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE, MAX_TEXTURES);
+}
+
+AssetLoader::~AssetLoader()
+{
+	Cancel();
+}
+
+void AssetLoader::Load(std::wstring path, std::wstring textureFolder, Callback ready, std::function<void()> prepare)
+{
+	auto request = std::make_shared<Request>();
+	request->path = std::move(path);
+	request->ready = std::move(ready);
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_requests.push_back(request);
+	}
+
+	// The workers are in the main thread's multithreaded apartment, which
+	// WIC needs for decoding the textures
+	m_workers.Push([this, request, textureFolder = std::move(textureFolder), prepare = std::move(prepare)]()
+	{
+		Decode(*request, textureFolder, prepare);
+	});
+}
+
+void AssetLoader::Decode(Request& request, const std::wstring& textureFolder, const std::function<void()>& prepare)
+{
+	Handle model = Gfx::NO_ASSET;
+	std::string error;
+	try
+	{
+		if (prepare)
+		{
+			prepare();
+		}
+
+		// The files are read either way: their contents are part of the key.
+		// So are the texture folder and the textures the materials name,
+		// a changed texture makes a new model, which finds its unchanged
+		// textures again and only loads the ones that changed.
+		auto data = ReadFile(request.path);
+		Gfx::AssetKey key = { Gfx::NormalizeAssetPath(request.path) + L'|' + Gfx::NormalizeAssetPath(textureFolder),
+			Gfx::ContentHash(data.data(), data.size()) };
+		std::vector<uint8_t> texture;
+		for (auto& name : Gfx::ReadSdkMeshTextures(data))
+		{
+			key.hash = (key.hash ^ ReadTexture(textureFolder + std::filesystem::u8path(name).wstring(), texture)) * 0x100000001b3ull;
+		}
+
+		bool created;
+		model = m_models.Acquire(key, created);
+		if (created)
+		{
+			auto& asset = m_models.Get(model);
+			asset.path = request.path;
+			LoadModel(asset, data, textureFolder);
+		}
+	}
+	catch (const std::exception& e)
+	{
+		error = e.what();
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	request.model = model;
+	request.error = error;
+	request.decoded = true;
+}
+
+void AssetLoader::LoadModel(ModelAsset& asset, const std::vector<uint8_t>& data, const std::wstring& textureFolder)
+{
+	std::vector<Handle> created;
+	try
+	{
+		asset.model = Model::CreateFromSDKMESH(data.data(), data.size());
+		if (asset.model->textureNames.empty())
+		{
+			throw std::runtime_error("Model NO Texture!!");
+		}
+
+		// Every worker records into its own batch; submitting to the queue
+		// is safe from any thread
+		ResourceUploadBatch resourceUpload(m_device);
+		resourceUpload.Begin();
+
+		// Textures go to the shared heap, the materials are pointed at
+		// their slots
+		for (auto& texName : asset.model->textureNames)
+		{
+			asset.textures.push_back(AcquireTexture(textureFolder + texName, resourceUpload, created));
+		}
+		auto remap = [&asset](int& index)
+		{
+			if (index >= 0 && size_t(index) < asset.textures.size())
+			{
+				index = static_cast<int>(asset.textures[index]);
+			}
+		};
+		for (auto& material : asset.model->materials)
+		{
+			remap(material.diffuseTextureIndex);
+			remap(material.specularTextureIndex);
+			remap(material.normalTextureIndex);
+		}
+
+		asset.model->LoadStaticBuffers(m_device, resourceUpload, true);
+
+		EffectFactory fxFactory(m_textureHeap->Heap(), m_states.Heap());
+
+		EffectPipelineStateDescription pd(
+			nullptr,
+			CommonStates::Opaque,
+			CommonStates::DepthDefault,
+			CommonStates::CullClockwise,
+			m_renderTarget);
+
+		EffectPipelineStateDescription pdAlpha(
+			nullptr,
+			CommonStates::AlphaBlend,
+			CommonStates::DepthDefault,
+			CommonStates::CullClockwise,
+			m_renderTarget);
+
+		asset.effects = asset.model->CreateEffects(fxFactory, pd, pdAlpha);
+
+		// For static batching; LoadStaticBuffers kept the vertices in memory
+		asset.meshes = D3D12RenderBackend::ExtractMeshes(*asset.model);
+		for (auto& mesh : asset.model->meshes)
+		{
+			auto& sphere = mesh->boundingSphere;
+			asset.radius = std::max(asset.radius, Vector3(sphere.Center).Length() + sphere.Radius);
+		}
+
+		asset.upload = resourceUpload.End(m_queue).share();
+	}
+	catch (const std::exception& e)
+	{
+		asset.error = e.what();
+		asset.model.reset();
+		asset.effects.clear();
+		asset.meshes.clear();
+
+		// Recorded into a batch that never ran
+		for (auto handle : created)
+		{
+			m_textures.Get(handle).resource.Reset();
+			WriteNullTexture(m_device, m_textureHeap->GetCpuHandle(handle));
+		}
+	}
+
+	for (auto handle : created)
+	{
+		auto& texture = m_textures.Get(handle);
+		texture.upload = asset.upload;
+		texture.done.store(true, std::memory_order_release);
+	}
+	asset.done.store(true, std::memory_order_release);
+}
+
+AssetLoader::Handle AssetLoader::AcquireTexture(const std::wstring& path, ResourceUploadBatch& upload, std::vector<Handle>& created)
+{
+	std::vector<uint8_t> data;
+	uint64_t hash = ReadTexture(path, data);
+
+	bool isNew;
+	Handle handle = m_textures.Acquire({ Gfx::NormalizeAssetPath(path), hash }, isNew);
+	if (!isNew)
+	{
+		return handle;
+	}
+
+	auto& texture = m_textures.Get(handle);
+	try
+	{
+		if (data.empty())
+		{
+			throw std::runtime_error("Cannot read file");
+		}
+		if (IsDds(path))
+		{
+			DX::ThrowIfFailed(CreateDDSTextureFromMemory(m_device, upload, data.data(), data.size(), texture.resource.ReleaseAndGetAddressOf()));
+		}
+		else
+		{
+			DX::ThrowIfFailed(CreateWICTextureFromMemory(m_device, upload, data.data(), data.size(), texture.resource.ReleaseAndGetAddressOf()));
+		}
+		CreateShaderResourceView(m_device, texture.resource.Get(), m_textureHeap->GetCpuHandle(handle));
+		created.push_back(handle);
+	}
+	catch (const std::exception&)
+	{
+		// Drawn black rather than failing the model
+		OutputDebugStringW((L"AssetLoader: cannot load texture " + path + L"\n").c_str());
+		texture.resource.Reset();
+		WriteNullTexture(m_device, m_textureHeap->GetCpuHandle(handle));
+		texture.done.store(true, std::memory_order_release);
+	}
+	return handle;
+}
+
+bool AssetLoader::IsReady(const ModelAsset& asset) const
+{
+	if (!asset.done.load(std::memory_order_acquire))
+	{
+		return false;
+	}
+	if (!asset.model)
+	{
+		return true;
+	}
+	if (!::IsReady(asset.upload))
+	{
+		return false;
+	}
+
+	// Textures shared with a model still loading elsewhere
+	for (auto handle : asset.textures)
+	{
+		auto& texture = m_textures.Get(handle);
+		if (!texture.done.load(std::memory_order_acquire) || !::IsReady(texture.upload))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+void AssetLoader::Update(uint64_t frame, double budgetMs)
+{
+	m_frame = frame;
+	m_models.Collect(frame, [this](Handle, ModelAsset& asset) { Destroy(asset); });
+	m_textures.Collect(frame, [](Handle, TextureAsset&) {});
+
+	auto start = std::chrono::steady_clock::now();
+	for (;;)
+	{
+		std::shared_ptr<Request> request;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (m_requests.empty() || !m_requests.front()->decoded)
+			{
+				return;
+			}
+			auto& front = *m_requests.front();
+			if (front.model != Gfx::NO_ASSET && !IsReady(m_models.Get(front.model)))
+			{
+				return;
+			}
+			request = std::move(m_requests.front());
+			m_requests.pop_front();
+		}
+
+		Handle model = request->model;
+		std::string error = request->error;
+		if (model != Gfx::NO_ASSET)
+		{
+			auto& asset = m_models.Get(model);
+			if (!asset.model)
+			{
+				error = asset.error;
+				m_models.Release(model, frame);
+				model = Gfx::NO_ASSET;
+			}
+			else if (asset.backendModel == UINT32_MAX)
+			{
+				asset.backendModel = m_backend.RegisterModel(*asset.model, m_textureHeap->Heap());
+			}
+		}
+
+		// The callback may queue more loads
+		request->ready(model, error);
+
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+		if (elapsed.count() >= budgetMs)
+		{
+			return;
+		}
+	}
+}
+
+void AssetLoader::Release(Handle model)
+{
+	if (model != Gfx::NO_ASSET)
+	{
+		m_models.Release(model, m_frame);
+	}
+}
+
+void AssetLoader::Destroy(ModelAsset& asset)
+{
+	if (asset.backendModel != UINT32_MAX)
+	{
+		m_backend.ReleaseModel(asset.backendModel);
+	}
+	if (asset.upload.valid())
+	{
+		// Only a model that was never delivered can still be uploading
+		asset.upload.wait();
+	}
+	for (auto handle : asset.textures)
+	{
+		m_textures.Release(handle, m_frame);
+	}
+}
+
+void AssetLoader::Cancel()
+{
+	m_workers.Cancel();
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for (auto& request : m_requests)
+	{
+		if (request->model != Gfx::NO_ASSET)
+		{
+			auto& asset = m_models.Get(request->model);
+			if (asset.upload.valid())
+			{
+				asset.upload.wait();
+			}
+			m_models.Release(request->model, m_frame);
+		}
+	}
+	m_requests.clear();
+}
+
+size_t AssetLoader::Pending() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_requests.size();
+}
@@ -0,0 +1,129 @@
+//
+// AssetLoader.h - Loads SDKMESH models without stalling the frame
+//
+
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <vector>
+
+#include "D3D12RenderBackend.h"
+#include "Gfx/AssetRegistry.h"
+#include "Gfx/GfxTypes.h"
+#include "Track/Parallel.h"
+
+// A model goes through three stages:
+//  1. a worker thread reads the file, and unless the registry has it
+//     already (same path, texture folder, and contents of the file and of
+//     its textures, see Gfx/AssetRegistry.h) decodes it and the textures
+//     not loaded yet and records their upload in its own
+//     ResourceUploadBatch, which it submits to the command queue;
+//  2. the upload is fenced: Update polls the batch's future every frame
+//     instead of waiting on it;
+//  3. once the GPU has the data, Update registers the model with the
+//     backend and hands it to its callback, on the render thread. Stage 3
+//     has a time budget per frame, so a station of a few hundred models
+//     arrives over a few frames instead of in one long one.
+// Until then the caller draws a placeholder.
+//
+// Models and textures are shared: a model loaded twice is one asset, a
+// texture used by several models is loaded once into one shared
+// descriptor heap. The effects of a model are created once with it.
+class AssetLoader
+{
+public:
+	using Handle = Gfx::AssetHandle;
+
+	static constexpr size_t MAX_MODELS = 4096;
+	static constexpr size_t MAX_TEXTURES = 1024;    // descriptors in the shared heap
+
+	struct TextureAsset
+	{
+		Microsoft::WRL::ComPtr<ID3D12Resource> resource;    // null when it could not be loaded
+		std::shared_future<void> upload;
+		std::atomic<bool> done{ false };                    // resource and upload are set
+	};
+
+	struct ModelAsset
+	{
+		std::wstring path;
+		std::unique_ptr<DirectX::Model> model;              // material texture indices are texture handles
+		std::vector<Handle> textures;
+		std::vector<std::shared_ptr<DirectX::IEffect>> effects;
+		std::vector<Gfx::MeshData> meshes;                  // the parts as plain meshes, for static batching
+		float radius = 0.f;                                 // bounds around the model origin
+		uint32_t backendModel = UINT32_MAX;                 // registered on the render thread
+		std::string error;                                  // empty when loaded
+		std::shared_future<void> upload;
+		std::atomic<bool> done{ false };                    // everything above is set
+	};
+
+	// model holds a reference for the callee, to be given back with
+	// Release; NO_ASSET with error set when it could not be loaded.
+	using Callback = std::function<void(Handle model, const std::string& error)>;
+
+	// states provides the sampler heap of the effects; it and backend must
+	// outlive the loader.
+	AssetLoader(ID3D12Device* device, ID3D12CommandQueue* queue, DirectX::CommonStates& states,
+		const DirectX::RenderTargetState& renderTarget, D3D12RenderBackend& backend, size_t threads = 2);
+	~AssetLoader();
+
+	// Queues the model at path; texture names in it are relative to
+	// textureFolder. prepare, if given, runs on the worker first (converting
+	// the source file, say).
+	void Load(std::wstring path, std::wstring textureFolder, Callback ready, std::function<void()> prepare = nullptr);
+
+	// Hands finished models to their callbacks in request order (a later
+	// request never overtakes an earlier one), for at most budgetMs; at
+	// least one model per call. Destroys the assets released a few frames
+	// before frame.
+	void Update(uint64_t frame, double budgetMs = 2.0);
+
+	const ModelAsset& GetModel(Handle model) const { return m_models.Get(model); }
+	void Release(Handle model);
+
+	// Drops everything not delivered yet. Uploads already submitted are
+	// still waited for, their memory must outlive the copy.
+	void Cancel();
+
+	// Requests not delivered yet
+	size_t Pending() const;
+
+	size_t ModelCount() const { return m_models.Count(); }
+	size_t TextureCount() const { return m_textures.Count(); }
+
+private:
+	struct Request
+	{
+		std::wstring path;
+		Callback ready;
+		Handle model = Gfx::NO_ASSET;
+		std::string error;
+		bool decoded = false;
+	};
+
+	void Decode(Request& request, const std::wstring& textureFolder, const std::function<void()>& prepare);
+	void LoadModel(ModelAsset& asset, const std::vector<uint8_t>& data, const std::wstring& textureFolder);
+	Handle AcquireTexture(const std::wstring& path, DirectX::ResourceUploadBatch& upload, std::vector<Handle>& created);
+	bool IsReady(const ModelAsset& asset) const;
+	void Destroy(ModelAsset& asset);
+
+	ID3D12Device* m_device;
+	ID3D12CommandQueue* m_queue;
+	DirectX::CommonStates& m_states;
+	DirectX::RenderTargetState m_renderTarget;
+	D3D12RenderBackend& m_backend;
+
+	std::unique_ptr<DirectX::DescriptorHeap> m_textureHeap;     // slot = texture handle
+	Gfx::AssetRegistry<ModelAsset> m_models;
+	Gfx::AssetRegistry<TextureAsset> m_textures;
+	uint64_t m_frame = 0;
+
+	mutable std::mutex m_mutex;
+	std::deque<std::shared_ptr<Request>> m_requests;    // in request order
+	Track::WorkQueue m_workers;
+};
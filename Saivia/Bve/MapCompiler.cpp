@@ -0,0 +1,404 @@
+//
+// MapCompiler.cpp
+//
+
+#include "MapCompiler.h"
+
+#include <cmath>
+#include <limits>
+
+namespace Bve
+{
+	namespace
+	{
+		enum class Element : uint8_t
+		{
+			Other,
+			Curve,
+			Gradient,
+			Track,
+			Structure,
+			Repeater,
+			Signal,
+			Section,
+			Beacon,
+			SpeedLimit,
+			Station,
+		};
+
+		enum class Function : uint8_t
+		{
+			Other,
+			Ignored,            // Load and the like: set-up, not events
+			Begin,
+			Begin0,
+			BeginTransition,
+			End,
+			Gauge,
+			Position,
+			Cant,
+			Put,
+			Put0,
+		};
+
+		struct CompileError
+		{
+			std::string message;
+		};
+
+		class Compiler
+		{
+		public:
+			Compiler(const MapFile& map, EventTable& table) : m_map(map), m_table(table)
+			{
+				// Symbols are dense and case-insensitive: one lookup per name
+				// here, then statements dispatch by indexing
+				m_elements.assign(map.symbols.Size(), Element::Other);
+				m_functions.assign(map.symbols.Size(), Function::Other);
+
+				NameElement("Curve", Element::Curve);
+				NameElement("Gradient", Element::Gradient);
+				NameElement("Track", Element::Track);
+				NameElement("Structure", Element::Structure);
+				NameElement("Repeater", Element::Repeater);
+				NameElement("Signal", Element::Signal);
+				NameElement("Section", Element::Section);
+				NameElement("Beacon", Element::Beacon);
+				NameElement("SpeedLimit", Element::SpeedLimit);
+				NameElement("Station", Element::Station);
+
+				NameFunction("Load", Function::Ignored);
+				NameFunction("SpeedLimit", Function::Ignored);        // Signal.SpeedLimit(...)
+				NameFunction("SetSpeedLimit", Function::Ignored);     // Section.SetSpeedLimit(...)
+				NameFunction("Begin", Function::Begin);
+				NameFunction("BeginCircular", Function::Begin);
+				NameFunction("BeginConst", Function::Begin);
+				NameFunction("Begin0", Function::Begin0);
+				NameFunction("BeginTransition", Function::BeginTransition);
+				NameFunction("End", Function::End);
+				NameFunction("Gauge", Function::Gauge);
+				NameFunction("SetGauge", Function::Gauge);
+				NameFunction("Position", Function::Position);
+				NameFunction("Cant", Function::Cant);
+				NameFunction("Put", Function::Put);
+				NameFunction("Put0", Function::Put0);
+			}
+
+			void Run()
+			{
+				for (auto& statement : m_map.statements)
+				{
+					Element element = m_elements[statement.element];
+					if (element == Element::Other)
+					{
+						continue;
+					}
+					size_t structureKeys = m_table.structureKeys.size();
+					size_t aspects = m_table.aspects.size();
+					try
+					{
+						Compile(element, statement);
+					}
+					catch (const CompileError& error)
+					{
+						m_table.structureKeys.resize(structureKeys);
+						m_table.aspects.resize(aspects);
+						m_table.errors.push_back("line " + std::to_string(statement.line) + ": " + Name(statement) + ": " + error.message);
+					}
+				}
+			}
+
+		private:
+			void NameElement(const char* name, Element element)
+			{
+				Symbol symbol = m_map.symbols.Find(name);
+				if (symbol != NO_SYMBOL)
+				{
+					m_elements[symbol] = element;
+				}
+			}
+
+			void NameFunction(const char* name, Function function)
+			{
+				Symbol symbol = m_map.symbols.Find(name);
+				if (symbol != NO_SYMBOL)
+				{
+					m_functions[symbol] = function;
+				}
+			}
+
+			std::string Name(const MapStatement& statement) const
+			{
+				std::string name(m_map.symbols.Name(statement.element));
+				if (statement.subElement != NO_SYMBOL)
+				{
+					name.append(".").append(m_map.symbols.Name(statement.subElement));
+				}
+				return name.append(".").append(m_map.symbols.Name(statement.function));
+			}
+
+			void Compile(Element element, const MapStatement& statement)
+			{
+				m_statement = &statement;
+				m_arguments = m_map.Arguments(statement);
+
+				Function function = m_functions[statement.function];
+				if (function == Function::Ignored)
+				{
+					return;
+				}
+				if (statement.subElement != NO_SYMBOL)
+				{
+					throw CompileError{ "not supported" };
+				}
+
+				switch (element)
+				{
+				case Element::Curve:
+					if (function == Function::BeginTransition)
+						return Emit(EventType::CurveTransition);
+					if (function == Function::Begin)
+						return Emit(EventType::Curve, m_table.curves, CurveEvent{ Number(0), Number(1, 0.0) });
+					if (function == Function::End)
+						return Emit(EventType::Curve, m_table.curves, CurveEvent{ 0.0, 0.0 });
+					if (function == Function::Gauge)
+						return Emit(EventType::Gauge, m_table.gauges, GaugeEvent{ NO_SYMBOL, Number(0) });
+					break;
+
+				case Element::Gradient:
+					if (function == Function::BeginTransition)
+						return Emit(EventType::GradientTransition);
+					if (function == Function::Begin)
+						return Emit(EventType::Gradient, m_table.gradients, GradientEvent{ Number(0) });
+					if (function == Function::End)
+						return Emit(EventType::Gradient, m_table.gradients, GradientEvent{ 0.0 });
+					break;
+
+				case Element::Track:
+					if (function == Function::Gauge)
+						return Emit(EventType::Gauge, m_table.gauges, GaugeEvent{ m_statement->key, Number(0) });
+					if (function == Function::Position)
+						return Emit(EventType::TrackPosition, m_table.trackPositions,
+							TrackPositionEvent{ Key(), Number(0), Number(1), Number(2, 0.0), Number(3, 0.0) });
+					if (function == Function::Cant)
+						return Emit(EventType::TrackCant, m_table.trackCants, TrackCantEvent{ Key(), Number(0) });
+					break;
+
+				case Element::Structure:
+					if (function == Function::Put)
+						return Emit(EventType::StructurePut, m_table.structures, StructureEvent{ Key(), FullPlacement(0) });
+					if (function == Function::Put0)
+						return Emit(EventType::StructurePut, m_table.structures, StructureEvent{ Key(), ShortPlacement(0) });
+					break;
+
+				case Element::Repeater:
+					if (function == Function::Begin)
+						return EmitRepeater(FullPlacement(0), 9);
+					if (function == Function::Begin0)
+						return EmitRepeater(ShortPlacement(0), 3);
+					if (function == Function::End)
+						return Emit(EventType::RepeaterEnd, m_table.repeaterEnds, RepeaterEndEvent{ Key() });
+					break;
+
+				case Element::Signal:
+					if (function == Function::Put)
+						return Emit(EventType::Signal, m_table.signals, SignalEvent{ Key(), Integer(0), FullPlacement(1) });
+					break;
+
+				case Element::Section:
+					if (function == Function::Begin)
+					{
+						SectionEvent section{ uint32_t(m_table.aspects.size()), m_statement->argumentCount };
+						for (uint32_t n = 0; n < section.aspectCount; n++)
+						{
+							m_table.aspects.push_back(Integer(n));
+						}
+						return Emit(EventType::Section, m_table.sections, section);
+					}
+					break;
+
+				case Element::Beacon:
+					if (function == Function::Put)
+						return Emit(EventType::Beacon, m_table.beacons, BeaconEvent{ Integer(0), Integer(1), Integer(2, 0) });
+					break;
+
+				case Element::SpeedLimit:
+					if (function == Function::Begin)
+						return Emit(EventType::SpeedLimit, m_table.speedLimits, SpeedLimitEvent{ Number(0) });
+					if (function == Function::End)
+						return Emit(EventType::SpeedLimit, m_table.speedLimits, SpeedLimitEvent{ std::numeric_limits<double>::infinity() });
+					break;
+
+				case Element::Station:
+					if (function == Function::Put)
+						return Emit(EventType::Station, m_table.stations,
+							StationEvent{ Key(), Integer(0), float(Number(1)), float(Number(2)) });
+					break;
+
+				default:
+					break;
+				}
+				throw CompileError{ "not supported" };
+			}
+
+			// Rows without a payload
+			void Emit(EventType type)
+			{
+				auto& rows = m_table.rows[size_t(type)];
+				AddRow(type, uint32_t(rows.size()));
+			}
+
+			template <class T>
+			void Emit(EventType type, std::vector<T>& payloads, const T& payload)
+			{
+				AddRow(type, uint32_t(payloads.size()));
+				payloads.push_back(payload);
+			}
+
+			void AddRow(EventType type, uint32_t payload)
+			{
+				m_table.rows[size_t(type)].push_back(uint32_t(m_table.distances.size()));
+				m_table.distances.push_back(m_statement->distance);
+				m_table.types.push_back(type);
+				m_table.payloads.push_back(payload);
+				m_table.lines.push_back(m_statement->line);
+			}
+
+			// Begin(track, x, y, z, rx, ry, rz, tilt, span, interval, structures...)
+			// or Begin0(track, tilt, span, interval, structures...)
+			void EmitRepeater(const Placement& placement, uint32_t intervalArgument)
+			{
+				RepeaterBeginEvent repeater{ Key(), placement, float(Number(intervalArgument)),
+					uint32_t(m_table.structureKeys.size()), 0 };
+				for (uint32_t n = intervalArgument + 1; n < m_statement->argumentCount; n++)
+				{
+					m_table.structureKeys.push_back(String(n));
+				}
+				repeater.structureCount = uint32_t(m_table.structureKeys.size()) - repeater.firstStructure;
+				if (repeater.structureCount == 0)
+				{
+					throw CompileError{ "structure expected" };
+				}
+				Emit(EventType::RepeaterBegin, m_table.repeaterBegins, repeater);
+			}
+
+			// track, x, y, z, rx, ry, rz, tilt, span from argument first on
+			Placement FullPlacement(uint32_t first) const
+			{
+				Placement placement;
+				placement.track = TrackKey(first);
+				placement.x = float(Number(first + 1));
+				placement.y = float(Number(first + 2));
+				placement.z = float(Number(first + 3, 0.0));
+				placement.rx = float(Number(first + 4, 0.0));
+				placement.ry = float(Number(first + 5, 0.0));
+				placement.rz = float(Number(first + 6, 0.0));
+				placement.tilt = uint8_t(Integer(first + 7, 0) & 3);
+				placement.span = float(Number(first + 8, 0.0));
+				return placement;
+			}
+
+			// track, tilt, span
+			Placement ShortPlacement(uint32_t first) const
+			{
+				Placement placement;
+				placement.track = TrackKey(first);
+				placement.tilt = uint8_t(Integer(first + 1, 0) & 3);
+				placement.span = float(Number(first + 2, 0.0));
+				return placement;
+			}
+
+			const MapArgument* Argument(uint32_t n) const
+			{
+				if (n >= m_statement->argumentCount || m_arguments[n].type == ArgumentType::Null)
+				{
+					return nullptr;
+				}
+				return &m_arguments[n];
+			}
+
+			double Number(uint32_t n) const
+			{
+				const MapArgument* argument = Argument(n);
+				if (!argument || argument->type != ArgumentType::Number)
+				{
+					throw CompileError{ "argument " + std::to_string(n + 1) + " must be a number" };
+				}
+				return argument->number;
+			}
+
+			double Number(uint32_t n, double fallback) const
+			{
+				return Argument(n) ? Number(n) : fallback;
+			}
+
+			int32_t Integer(uint32_t n) const
+			{
+				return int32_t(std::lround(Number(n)));
+			}
+
+			int32_t Integer(uint32_t n, int32_t fallback) const
+			{
+				return Argument(n) ? Integer(n) : fallback;
+			}
+
+			Symbol String(uint32_t n) const
+			{
+				const MapArgument* argument = Argument(n);
+				if (!argument || argument->type != ArgumentType::String)
+				{
+					throw CompileError{ "argument " + std::to_string(n + 1) + " must be a string" };
+				}
+				return argument->string;
+			}
+
+			// The own track is '', 0 (older maps) or left out
+			Symbol TrackKey(uint32_t n) const
+			{
+				const MapArgument* argument = Argument(n);
+				if (!argument)
+				{
+					return NO_SYMBOL;
+				}
+				if (argument->type == ArgumentType::Number)
+				{
+					if (argument->number != 0.0)
+					{
+						throw CompileError{ "argument " + std::to_string(n + 1) + " must be a track key" };
+					}
+					return NO_SYMBOL;
+				}
+				return m_map.symbols.Name(argument->string).empty() ? NO_SYMBOL : argument->string;
+			}
+
+			Symbol Key() const
+			{
+				if (m_statement->key == NO_SYMBOL)
+				{
+					throw CompileError{ "key expected" };
+				}
+				return m_statement->key;
+			}
+
+			const MapFile& m_map;
+			EventTable& m_table;
+			std::vector<Element> m_elements;    // by symbol
+			std::vector<Function> m_functions;  // by symbol
+
+			const MapStatement* m_statement = nullptr;
+			const MapArgument* m_arguments = nullptr;
+		};
+	}
+
+	EventTable CompileMap(const MapFile& map)
+	{
+		EventTable table;
+		table.distances.reserve(map.statements.size());
+		table.types.reserve(map.statements.size());
+		table.payloads.reserve(map.statements.size());
+		table.lines.reserve(map.statements.size());
+
+		Compiler(map, table).Run();
+		return table;
+	}
+}
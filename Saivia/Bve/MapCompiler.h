@@ -0,0 +1,183 @@
+//
+// MapCompiler.h - Typed, distance-sorted event table compiled from a route
+//
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "MapParser.h"
+
+namespace Bve
+{
+	enum class EventType : uint8_t
+	{
+		CurveTransition,    // Curve.BeginTransition()
+		Curve,              // Curve.Begin(radius, cant), Curve.End()
+		Gauge,              // Curve.Gauge(gauge), Track.Gauge(gauge)
+		GradientTransition, // Gradient.BeginTransition()
+		Gradient,           // Gradient.Begin(permil), Gradient.End()
+		TrackPosition,      // Track[key].Position(x, y, radiusH, radiusV)
+		TrackCant,          // Track[key].Cant(cant)
+		StructurePut,       // Structure[key].Put(track, x, y, z, rx, ry, rz, tilt, span), .Put0(track, tilt, span)
+		RepeaterBegin,      // Repeater[key].Begin(track, x, ..., span, interval, structures...), .Begin0(...)
+		RepeaterEnd,        // Repeater[key].End()
+		Signal,             // Signal[key].Put(section, track, x, y, z, rx, ry, rz, tilt, span)
+		Section,            // Section.Begin(aspects...)
+		Beacon,             // Beacon.Put(type, section, data)
+		SpeedLimit,         // SpeedLimit.Begin(speed), SpeedLimit.End()
+		Station,            // Station[key].Put(door, backwardMargin, forwardMargin)
+		Count,
+	};
+
+	const size_t EVENT_TYPE_COUNT = size_t(EventType::Count);
+
+	// Where an object stands relative to a track. track is NO_SYMBOL for the
+	// own track ('', 0 or null in the map). tilt: 0 level, 1 with the
+	// gradient, 2 with the cant, 3 with both; span is the chord length used
+	// to find the gradient / curve direction at the object.
+	struct Placement
+	{
+		Symbol track = NO_SYMBOL;
+		float x = 0.0f, y = 0.0f, z = 0.0f;
+		float rx = 0.0f, ry = 0.0f, rz = 0.0f;    // degrees
+		float span = 0.0f;
+		uint8_t tilt = 0;
+	};
+
+	struct CurveEvent
+	{
+		double radius;                  // signed, negative turns left; 0 straight
+		double cant;                    // m
+	};
+
+	// Curve.Gauge and Track.Gauge without a key set the own track's gauge
+	// (track NO_SYMBOL); Track[key].Gauge that of a named track.
+	struct GaugeEvent
+	{
+		Symbol track;
+		double gauge;                   // m
+	};
+
+	struct GradientEvent
+	{
+		double gradient;                // permil
+	};
+
+	struct TrackPositionEvent
+	{
+		Symbol track;
+		double x, y;                    // offset from the own track
+		double radiusH, radiusV;        // of the curve towards the next position; 0 linear
+	};
+
+	struct TrackCantEvent
+	{
+		Symbol track;
+		double cant;
+	};
+
+	struct StructureEvent
+	{
+		Symbol structure;
+		Placement placement;
+	};
+
+	struct RepeaterBeginEvent
+	{
+		Symbol repeater;
+		Placement placement;
+		float interval;
+		uint32_t firstStructure;        // into EventTable::structureKeys, used in turn
+		uint32_t structureCount;
+	};
+
+	struct RepeaterEndEvent
+	{
+		Symbol repeater;
+	};
+
+	struct SignalEvent
+	{
+		Symbol signal;
+		int32_t section;                // relative: 0 the section the signal starts
+		Placement placement;
+	};
+
+	struct SectionEvent
+	{
+		uint32_t firstAspect;           // into EventTable::aspects
+		uint32_t aspectCount;
+	};
+
+	struct BeaconEvent
+	{
+		int32_t type;
+		int32_t section;
+		int32_t data;
+	};
+
+	struct SpeedLimitEvent
+	{
+		double speed;                   // km/h, infinity after End()
+	};
+
+	struct StationEvent
+	{
+		Symbol station;
+		int32_t door;                   // -1 left, 1 right, 0 both
+		float backwardMargin, forwardMargin;
+	};
+
+	// The statements that matter for building and running a route, typed
+	// and with their arguments checked, in distance order (file order where
+	// equal). Rows are kept as parallel columns so a pass over distances or
+	// types touches nothing else; payload(row) is the row's index into the
+	// payload array of its type, which holds the events of that type in the
+	// same order. rows[type] lists the rows of one type, so a consumer that
+	// only cares about curves never looks at structures.
+	//
+	// Symbols are those of the MapFile the table was compiled from.
+	struct EventTable
+	{
+		std::vector<double> distances;
+		std::vector<EventType> types;
+		std::vector<uint32_t> payloads;
+		std::vector<uint32_t> lines;
+		std::array<std::vector<uint32_t>, EVENT_TYPE_COUNT> rows;
+
+		std::vector<CurveEvent> curves;
+		std::vector<GaugeEvent> gauges;
+		std::vector<GradientEvent> gradients;
+		std::vector<TrackPositionEvent> trackPositions;
+		std::vector<TrackCantEvent> trackCants;
+		std::vector<StructureEvent> structures;
+		std::vector<RepeaterBeginEvent> repeaterBegins;
+		std::vector<RepeaterEndEvent> repeaterEnds;
+		std::vector<SignalEvent> signals;
+		std::vector<SectionEvent> sections;
+		std::vector<BeaconEvent> beacons;
+		std::vector<SpeedLimitEvent> speedLimits;
+		std::vector<StationEvent> stations;
+
+		std::vector<Symbol> structureKeys;
+		std::vector<int32_t> aspects;
+
+		// Statements of the elements above that could not be compiled
+		// ("line 12: ..."); they are left out. Statements of other elements
+		// (sound, light, trains...) are ignored without a note.
+		std::vector<std::string> errors;
+
+		size_t Size() const { return distances.size(); }
+
+		// Distance of the n-th event of a type
+		double Distance(EventType type, size_t n) const { return distances[rows[size_t(type)][n]]; }
+	};
+
+	// One linear pass over the statements, which ParseMap has already
+	// sorted by distance.
+	EventTable CompileMap(const MapFile& map);
+}
@@ -0,0 +1,610 @@
+//
+// MapParser.cpp
+//
+
+#include "MapParser.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <unordered_map>
+
+#include "../Track/NumberParser.h"
+
+namespace Bve
+{
+	namespace
+	{
+		enum class TokenType : uint8_t
+		{
+			End,
+			Number,
+			String,
+			Identifier,
+			Variable,           // $name, text without the $
+			Punctuation,
+			Invalid,            // a stray character or an unterminated string
+		};
+
+		struct Token
+		{
+			TokenType type = TokenType::End;
+			char punctuation = 0;
+			uint32_t line = 0;
+			std::string_view text;
+			double number = 0.0;
+		};
+
+		struct ParseError
+		{
+			std::string message;
+		};
+
+		// Character classes, looked up instead of compared in the scanner
+		enum : uint8_t
+		{
+			BLANK = 1,          // space, tab, CR
+			DIGIT = 2,
+			NAME = 4,           // letters and _
+			PUNCTUATION = 8,
+		};
+
+		struct CharacterClasses
+		{
+			uint8_t table[256] = {};
+
+			CharacterClasses()
+			{
+				table[uint8_t(' ')] = table[uint8_t('\t')] = table[uint8_t('\r')] = BLANK;
+				for (int c = '0'; c <= '9'; c++)
+				{
+					table[c] = DIGIT;
+				}
+				for (int c = 'a'; c <= 'z'; c++)
+				{
+					table[c] = table[c - 'a' + 'A'] = NAME;
+				}
+				table[uint8_t('_')] = NAME;
+				for (const char* c = ".[](),;=+-*/%"; *c; c++)
+				{
+					table[uint8_t(*c)] = PUNCTUATION;
+				}
+			}
+		};
+
+		const CharacterClasses CLASSES;
+
+		uint8_t ClassOf(char c)
+		{
+			return CLASSES.table[uint8_t(c)];
+		}
+
+		bool IsNameStart(char c)
+		{
+			return ClassOf(c) == NAME;
+		}
+
+		bool IsNameChar(char c)
+		{
+			return (ClassOf(c) & (NAME | DIGIT)) != 0;
+		}
+
+		std::string FormatNumber(double value)
+		{
+			char text[32];
+			snprintf(text, sizeof(text), "%.15g", value);
+			return text;
+		}
+
+		class Parser
+		{
+		public:
+			Parser(std::string_view text, MapFile& map) :
+				m_p(text.data()),
+				m_end(text.data() + text.size()),
+				m_map(map)
+			{
+			}
+
+			void Run()
+			{
+				ParseHeader();
+				for (;;)
+				{
+					const Token& first = Peek();
+					if (first.type == TokenType::End)
+					{
+						break;
+					}
+					uint32_t line = first.line;
+					size_t arguments = m_map.arguments.size();
+					m_ended = false;
+					try
+					{
+						ParseStatement();
+					}
+					catch (const ParseError& e)
+					{
+						m_map.errors.push_back("line " + std::to_string(line) + ": " + e.message);
+						m_map.arguments.resize(arguments);
+						// The ; may be the token that failed: then the next
+						// statement has already begun
+						if (!m_ended)
+						{
+							SkipStatement();
+						}
+					}
+				}
+				m_map.lines = m_line;
+			}
+
+		private:
+			// "BveTs Map 2.02" with an optional ":encoding", after a BOM
+			void ParseHeader()
+			{
+				if (m_end - m_p >= 3 && !memcmp(m_p, "\xEF\xBB\xBF", 3))
+				{
+					m_p += 3;
+				}
+				const char* lineEnd = m_p;
+				while (lineEnd < m_end && *lineEnd != '\n')
+				{
+					lineEnd++;
+				}
+				std::string_view header(m_p, lineEnd - m_p);
+				std::string_view prefix = "BveTs Map ";
+				if (header.size() < prefix.size() || !SymbolTable::Equal(header.substr(0, prefix.size()), prefix))
+				{
+					throw std::runtime_error("BVE: not a BveTs Map file");
+				}
+				auto version = header.substr(prefix.size());
+				version = version.substr(0, std::min(version.find(':'), version.find_first_of(" \t\r")));
+				if (version.size() < 2 || version.substr(0, 2) != "2.")
+				{
+					throw std::runtime_error("BVE: unsupported map version " + std::string(version));
+				}
+				m_map.version = std::string(version);
+				m_p = lineEnd;
+			}
+
+			// Whitespace and comments: # and // to the end of the line
+			void SkipBlank()
+			{
+				for (; m_p < m_end; m_p++)
+				{
+					char c = *m_p;
+					if (ClassOf(c) == BLANK)
+					{
+						continue;
+					}
+					if (c == '\n')
+					{
+						m_line++;
+					}
+					else if (c == '#' || (c == '/' && m_p + 1 < m_end && m_p[1] == '/'))
+					{
+						while (m_p < m_end && *m_p != '\n')
+						{
+							m_p++;
+						}
+						m_p--;
+					}
+					else
+					{
+						break;
+					}
+				}
+			}
+
+			Token Lex()
+			{
+				SkipBlank();
+				Token token;
+				token.line = m_line;
+				if (m_p == m_end)
+				{
+					return token;
+				}
+
+				const char* start = m_p;
+				char c = *m_p;
+				if (IsNameStart(c) || (c == '$' && m_p + 1 < m_end && IsNameStart(m_p[1])))
+				{
+					token.type = c == '$' ? TokenType::Variable : TokenType::Identifier;
+					if (c == '$')
+					{
+						start = ++m_p;
+					}
+					while (m_p < m_end && IsNameChar(*m_p))
+					{
+						m_p++;
+					}
+					token.text = std::string_view(start, m_p - start);
+				}
+				else if (Track::IsDecimalDigit(c) || (c == '.' && m_p + 1 < m_end && Track::IsDecimalDigit(m_p[1])))
+				{
+					token.type = TokenType::Number;
+					Track::ParseDecimal(m_p, m_end, token.number);
+				}
+				else if (c == '\'')
+				{
+					start = ++m_p;
+					while (m_p < m_end && *m_p != '\'' && *m_p != '\n')
+					{
+						m_p++;
+					}
+					if (m_p == m_end || *m_p != '\'')
+					{
+						token.type = TokenType::Invalid;
+						token.text = "unterminated string";
+						return token;
+					}
+					token.type = TokenType::String;
+					token.text = std::string_view(start, m_p - start);
+					m_p++;
+				}
+				else if (ClassOf(c) == PUNCTUATION)
+				{
+					token.type = TokenType::Punctuation;
+					token.punctuation = c;
+					m_p++;
+				}
+				else
+				{
+					token.type = TokenType::Invalid;
+					token.text = "unexpected character";
+					m_p++;
+				}
+				return token;
+			}
+
+			// ahead: 0 or 1
+			const Token& Peek(size_t ahead = 0)
+			{
+				while (m_ahead <= ahead)
+				{
+					m_tokens[m_ahead++] = Lex();
+				}
+				return m_tokens[ahead];
+			}
+
+			Token Next()
+			{
+				Peek();
+				Token token = m_tokens[0];
+				m_tokens[0] = m_tokens[1];
+				m_ahead--;
+				m_ended = IsPunctuation(token, ';');
+				return token;
+			}
+
+			bool IsPunctuation(const Token& token, char c) const
+			{
+				return token.type == TokenType::Punctuation && token.punctuation == c;
+			}
+
+			bool IsEndOfExpression(const Token& token) const
+			{
+				return token.type == TokenType::Punctuation &&
+					(token.punctuation == ',' || token.punctuation == ')' || token.punctuation == ']' || token.punctuation == ';');
+			}
+
+			bool Accept(char c)
+			{
+				if (IsPunctuation(Peek(), c))
+				{
+					Next();
+					return true;
+				}
+				return false;
+			}
+
+			[[noreturn]] void Fail(const Token& token, const std::string& message)
+			{
+				throw ParseError{ token.type == TokenType::Invalid ? std::string(token.text) : message };
+			}
+
+			void Expect(char c)
+			{
+				Token token = Next();
+				if (!IsPunctuation(token, c))
+				{
+					Fail(token, std::string("'") + c + "' expected");
+				}
+			}
+
+			void SkipStatement()
+			{
+				for (;;)
+				{
+					Token token = Next();
+					if (token.type == TokenType::End || IsPunctuation(token, ';'))
+					{
+						return;
+					}
+				}
+			}
+
+			void ParseStatement()
+			{
+				Token first = Peek();
+				if (first.type == TokenType::Identifier && (IsPunctuation(Peek(1), '.') || IsPunctuation(Peek(1), '[')))
+				{
+					ParseElement();
+				}
+				else if (first.type == TokenType::Variable && IsPunctuation(Peek(1), '='))
+				{
+					Symbol name = m_map.symbols.Intern(Next().text);
+					Next();
+					m_variables[name] = ParseExpression();
+					Expect(';');
+				}
+				else if (first.type == TokenType::Identifier && SymbolTable::Equal(first.text, "include"))
+				{
+					Fail(first, "include is not supported");
+				}
+				else
+				{
+					Token start = Peek();
+					auto distance = ParseExpression();
+					if (distance.type != ArgumentType::Number)
+					{
+						Fail(start, "distance must be a number");
+					}
+					Expect(';');
+					m_distance = distance.number;
+				}
+			}
+
+			// Element[key].SubElement.Function(arguments);
+			void ParseElement()
+			{
+				MapStatement statement;
+				statement.distance = m_distance;
+				statement.line = Peek().line;
+				statement.element = m_map.symbols.Intern(Next().text);
+				statement.key = NO_SYMBOL;
+				statement.subElement = NO_SYMBOL;
+				if (Accept('['))
+				{
+					Token start = Peek();
+					auto key = ParseExpression();
+					Expect(']');
+					if (key.type == ArgumentType::String)
+					{
+						statement.key = key.string;
+					}
+					else if (key.type == ArgumentType::Number)
+					{
+						statement.key = m_map.symbols.InternCopy(FormatNumber(key.number));
+					}
+					else
+					{
+						Fail(start, "key must be a string");
+					}
+				}
+
+				Expect('.');
+				Token name = Next();
+				if (name.type != TokenType::Identifier)
+				{
+					Fail(name, "function name expected");
+				}
+				if (Accept('.'))
+				{
+					statement.subElement = m_map.symbols.Intern(name.text);
+					name = Next();
+					if (name.type != TokenType::Identifier)
+					{
+						Fail(name, "function name expected");
+					}
+				}
+				statement.function = m_map.symbols.Intern(name.text);
+
+				Expect('(');
+				statement.firstArgument = static_cast<uint32_t>(m_map.arguments.size());
+				if (!Accept(')'))
+				{
+					do
+					{
+						// An argument left out is null: Put(, 1, 2)
+						bool omitted = IsPunctuation(Peek(), ',') || IsPunctuation(Peek(), ')');
+						m_map.arguments.push_back(omitted ? MapArgument() : ParseExpression());
+					} while (Accept(','));
+					Expect(')');
+				}
+				statement.argumentCount = static_cast<uint32_t>(m_map.arguments.size() - statement.firstArgument);
+				Expect(';');
+				m_map.statements.push_back(statement);
+			}
+
+			MapArgument Number(double value)
+			{
+				MapArgument argument;
+				argument.type = ArgumentType::Number;
+				argument.number = value;
+				return argument;
+			}
+
+			std::string Text(const MapArgument& value)
+			{
+				if (value.type == ArgumentType::String)
+				{
+					return std::string(m_map.symbols.Name(value.string));
+				}
+				return value.type == ArgumentType::Number ? FormatNumber(value.number) : std::string();
+			}
+
+			// Sums and differences of terms; + joins strings
+			MapArgument ParseExpression()
+			{
+				// Almost every argument is a plain literal
+				const Token& token = Peek();
+				if ((token.type == TokenType::Number || token.type == TokenType::String) && IsEndOfExpression(Peek(1)))
+				{
+					return ParsePrimary();
+				}
+
+				auto value = ParseTerm();
+				for (;;)
+				{
+					const Token& token = Peek();
+					if (!IsPunctuation(token, '+') && !IsPunctuation(token, '-'))
+					{
+						return value;
+					}
+					Token op = Next();
+					auto right = ParseTerm();
+					if (op.punctuation == '+' && (value.type == ArgumentType::String || right.type == ArgumentType::String))
+					{
+						value.type = ArgumentType::String;
+						value.string = m_map.symbols.InternCopy(Text(value) + Text(right));
+						continue;
+					}
+					if (value.type != ArgumentType::Number || right.type != ArgumentType::Number)
+					{
+						Fail(op, "numbers expected");
+					}
+					value.number = op.punctuation == '+' ? value.number + right.number : value.number - right.number;
+				}
+			}
+
+			MapArgument ParseTerm()
+			{
+				auto value = ParseUnary();
+				for (;;)
+				{
+					const Token& token = Peek();
+					if (!IsPunctuation(token, '*') && !IsPunctuation(token, '/') && !IsPunctuation(token, '%'))
+					{
+						return value;
+					}
+					Token op = Next();
+					auto right = ParseUnary();
+					if (value.type != ArgumentType::Number || right.type != ArgumentType::Number)
+					{
+						Fail(op, "numbers expected");
+					}
+					if (op.punctuation != '*' && right.number == 0.0)
+					{
+						Fail(op, "division by zero");
+					}
+					value.number = op.punctuation == '*' ? value.number * right.number :
+						op.punctuation == '/' ? value.number / right.number : std::fmod(value.number, right.number);
+				}
+			}
+
+			MapArgument ParseUnary()
+			{
+				if (IsPunctuation(Peek(), '-') || IsPunctuation(Peek(), '+'))
+				{
+					Token op = Next();
+					auto value = ParseUnary();
+					if (value.type != ArgumentType::Number)
+					{
+						Fail(op, "number expected");
+					}
+					if (op.punctuation == '-')
+					{
+						value.number = -value.number;
+					}
+					return value;
+				}
+				return ParsePrimary();
+			}
+
+			MapArgument ParsePrimary()
+			{
+				Token token = Next();
+				switch (token.type)
+				{
+				case TokenType::Number:
+					return Number(token.number);
+
+				case TokenType::String:
+				{
+					MapArgument value;
+					value.type = ArgumentType::String;
+					value.string = m_map.symbols.Intern(token.text);
+					return value;
+				}
+
+				case TokenType::Variable:
+				{
+					auto found = m_variables.find(m_map.symbols.Intern(token.text));
+					if (found == m_variables.end())
+					{
+						Fail(token, "undefined variable $" + std::string(token.text));
+					}
+					return found->second;
+				}
+
+				case TokenType::Identifier:
+					if (SymbolTable::Equal(token.text, "null"))
+					{
+						return MapArgument();
+					}
+					if (SymbolTable::Equal(token.text, "distance"))
+					{
+						return Number(m_distance);
+					}
+					Fail(token, "unknown name " + std::string(token.text));
+
+				default:
+					if (IsPunctuation(token, '('))
+					{
+						auto value = ParseExpression();
+						Expect(')');
+						return value;
+					}
+					Fail(token, token.type == TokenType::End ? "unexpected end of file" : "value expected");
+				}
+			}
+
+			const char* m_p;
+			const char* m_end;
+			uint32_t m_line = 1;
+			Token m_tokens[2];                  // looked ahead
+			size_t m_ahead = 0;
+			bool m_ended = false;               // the last token taken was ;
+			MapFile& m_map;
+			double m_distance = 0.0;
+			std::unordered_map<Symbol, MapArgument> m_variables;
+		};
+	}
+
+	void ParseMap(std::string_view text, MapFile& map)
+	{
+		// Every statement ends with ; and arguments are separated by commas:
+		// counting them first spares growing the tables while parsing
+		size_t semicolons = 0, commas = 0;
+		for (char c : text)
+		{
+			semicolons += c == ';';
+			commas += c == ',';
+		}
+		map.statements.reserve(map.statements.size() + semicolons);
+		map.arguments.reserve(map.arguments.size() + semicolons + commas);
+
+		Parser(text, map).Run();
+
+		// Most of a route is written in order: only sort when it is not
+		if (!std::is_sorted(map.statements.begin(), map.statements.end(),
+			[](const MapStatement& a, const MapStatement& b) { return a.distance < b.distance; }))
+		{
+			std::stable_sort(map.statements.begin(), map.statements.end(),
+				[](const MapStatement& a, const MapStatement& b) { return a.distance < b.distance; });
+		}
+	}
+
+	MapFile LoadMap(const std::filesystem::path& path)
+	{
+		MapFile map;
+		auto source = std::make_shared<MappedFile>(path);
+		ParseMap(std::string_view(source->Data(), source->Size()), map);
+		map.source = std::move(source);
+		return map;
+	}
+}
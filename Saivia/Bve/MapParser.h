@@ -0,0 +1,80 @@
+//
+// MapParser.h - BveTs Map 2.0x route files as a distance-sorted statement table
+//
+
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "MappedFile.h"
+#include "SymbolTable.h"
+
+namespace Bve
+{
+	enum class ArgumentType : uint8_t
+	{
+		Null,
+		Number,
+		String,
+	};
+
+	// Evaluated argument of a statement: a number, an interned string or null
+	struct MapArgument
+	{
+		double number = 0.0;
+		Symbol string = NO_SYMBOL;
+		ArgumentType type = ArgumentType::Null;
+	};
+
+	// Element[key].SubElement.Function(arguments) at distance, e.g.
+	//   Track['Opp'].Position(3.4, 0)   element Track, key Opp, function Position
+	//   Track['Opp'].Cant.SetGauge(1)   ... sub-element Cant, function SetGauge
+	//   Curve.Begin(600, 0.105)         no key
+	// Names are symbols of MapFile::symbols, missing parts are NO_SYMBOL.
+	struct MapStatement
+	{
+		double distance;
+		Symbol element;
+		Symbol key;
+		Symbol subElement;
+		Symbol function;
+		uint32_t firstArgument;             // into MapFile::arguments
+		uint32_t argumentCount;
+		uint32_t line;                      // one based
+	};
+
+	struct MapFile
+	{
+		std::string version;                // "2.02"
+		std::vector<MapStatement> statements;   // by distance, in file order where equal
+		std::vector<MapArgument> arguments;
+		SymbolTable symbols;
+		size_t lines = 0;
+
+		// Statements that could not be understood ("line 12: ..."); they are
+		// skipped, not fatal.
+		std::vector<std::string> errors;
+
+		// The text the symbols point into, when the map was loaded from a file
+		std::shared_ptr<const MappedFile> source;
+
+		const MapArgument* Arguments(const MapStatement& statement) const { return arguments.data() + statement.firstArgument; }
+	};
+
+	// Parses text in one pass without copying it: tokens are views of the
+	// text and names are interned as they are met, so text must outlive map.
+	// Distances and arguments may be expressions of numbers, strings,
+	// variables ($name = ...;) and `distance`. Statements end up stable
+	// sorted by distance: routes are not written in distance order.
+	// Throws std::runtime_error when text does not start with the
+	// "BveTs Map 2.xx" header.
+	void ParseMap(std::string_view text, MapFile& map);
+
+	// Maps the file at path and parses it; the mapping stays with the map.
+	MapFile LoadMap(const std::filesystem::path& path);
+}
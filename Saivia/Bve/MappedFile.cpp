@@ -0,0 +1,117 @@
+//
+// MappedFile.cpp
+//
+
+#include "MappedFile.h"
+
+#include <stdexcept>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace Bve
+{
+#ifdef _WIN32
+	MappedFile::MappedFile(const std::filesystem::path& path)
+	{
+		m_file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+			FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (m_file == INVALID_HANDLE_VALUE)
+		{
+			m_file = nullptr;
+			throw std::runtime_error("Cannot open " + path.u8string());
+		}
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(m_file, &size))
+		{
+			CloseHandle(m_file);
+			throw std::runtime_error("Cannot read " + path.u8string());
+		}
+		if (size.QuadPart == 0)
+		{
+			return;
+		}
+
+		m_mapping = CreateFileMappingW(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		void* view = m_mapping ? MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+		if (!view)
+		{
+			if (m_mapping)
+			{
+				CloseHandle(m_mapping);
+			}
+			CloseHandle(m_file);
+			throw std::runtime_error("Cannot map " + path.u8string());
+		}
+		m_data = static_cast<const char*>(view);
+		m_size = static_cast<size_t>(size.QuadPart);
+	}
+
+	MappedFile::~MappedFile()
+	{
+		if (m_size > 0)
+		{
+			UnmapViewOfFile(m_data);
+		}
+		if (m_mapping)
+		{
+			CloseHandle(m_mapping);
+		}
+		if (m_file)
+		{
+			CloseHandle(m_file);
+		}
+	}
+#else
+	MappedFile::MappedFile(const std::filesystem::path& path)
+	{
+		int file = open(path.c_str(), O_RDONLY);
+		if (file < 0)
+		{
+			throw std::runtime_error("Cannot open " + path.u8string());
+		}
+		struct stat status;
+		if (fstat(file, &status) != 0)
+		{
+			close(file);
+			throw std::runtime_error("Cannot read " + path.u8string());
+		}
+		if (status.st_size == 0)
+		{
+			close(file);
+			return;
+		}
+
+		// The mapping keeps its own reference to the file
+		void* view = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+		close(file);
+		if (view == MAP_FAILED)
+		{
+			throw std::runtime_error("Cannot map " + path.u8string());
+		}
+		madvise(view, static_cast<size_t>(status.st_size), MADV_SEQUENTIAL);
+		m_data = static_cast<const char*>(view);
+		m_size = static_cast<size_t>(status.st_size);
+	}
+
+	MappedFile::~MappedFile()
+	{
+		if (m_size > 0)
+		{
+			munmap(const_cast<char*>(m_data), m_size);
+		}
+	}
+#endif
+}
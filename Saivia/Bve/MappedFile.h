@@ -0,0 +1,34 @@
+//
+// MappedFile.h - Read-only memory mapping of a whole file
+//
+
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+
+namespace Bve
+{
+	// The file's bytes without copying them; valid while the object lives.
+	// Throws std::runtime_error when the file cannot be opened or mapped.
+	class MappedFile
+	{
+	public:
+		explicit MappedFile(const std::filesystem::path& path);
+		~MappedFile();
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		const char* Data() const { return m_data; }
+		size_t Size() const { return m_size; }
+
+	private:
+		const char* m_data = "";
+		size_t m_size = 0;
+#ifdef _WIN32
+		void* m_file = nullptr;
+		void* m_mapping = nullptr;
+#endif
+	};
+}
@@ -0,0 +1,238 @@
+//
+// Repeaters.cpp
+//
+
+#include "Repeaters.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <unordered_map>
+
+namespace Bve
+{
+	namespace
+	{
+		const long long NO_CHUNK = std::numeric_limits<long long>::min();
+
+		double BuildMaxEnd(const std::vector<RepeaterSpan>& spans, std::vector<double>& maxEnd, size_t first, size_t last)
+		{
+			if (first >= last)
+			{
+				return -std::numeric_limits<double>::infinity();
+			}
+			size_t middle = first + (last - first) / 2;
+			maxEnd[middle] = std::max({ spans[middle].end,
+				BuildMaxEnd(spans, maxEnd, first, middle),
+				BuildMaxEnd(spans, maxEnd, middle + 1, last) });
+			return maxEnd[middle];
+		}
+	}
+
+	void RepeaterIndex::Build(const EventTable& table, double end)
+	{
+		m_spans.clear();
+		m_structures.clear();
+		m_instanceCount = 0;
+
+		auto& rows = table.rows[size_t(EventType::RepeaterBegin)];
+		m_spans.reserve(rows.size());
+		m_structures.reserve(table.structureKeys.size());
+
+		// Open span of each repeater key
+		std::unordered_map<Symbol, size_t> open;
+		auto close = [this, &open](Symbol repeater, double distance)
+		{
+			auto found = open.find(repeater);
+			if (found != open.end())
+			{
+				m_spans[found->second].end = distance;
+				open.erase(found);
+			}
+		};
+
+		for (size_t row = 0; row < table.Size(); row++)
+		{
+			EventType type = table.types[row];
+			if (type == EventType::RepeaterEnd)
+			{
+				close(table.repeaterEnds[table.payloads[row]].repeater, table.distances[row]);
+			}
+			else if (type == EventType::RepeaterBegin)
+			{
+				auto& begin = table.repeaterBegins[table.payloads[row]];
+				close(begin.repeater, table.distances[row]);
+				if (begin.interval <= 0.0f)
+				{
+					continue;
+				}
+
+				RepeaterSpan span;
+				span.begin = table.distances[row];
+				span.end = end;
+				span.interval = begin.interval;
+				span.firstStructure = uint32_t(m_structures.size());
+				span.structureCount = begin.structureCount;
+				span.event = table.payloads[row];
+				m_structures.insert(m_structures.end(), table.structureKeys.begin() + begin.firstStructure,
+					table.structureKeys.begin() + begin.firstStructure + begin.structureCount);
+				open[begin.repeater] = m_spans.size();
+				m_spans.push_back(span);
+			}
+		}
+
+		// Rows come by distance, so the spans are sorted by begin already
+		for (auto& span : m_spans)
+		{
+			if (span.end > span.begin)
+			{
+				m_instanceCount += size_t(std::ceil((span.end - span.begin) / span.interval));
+			}
+		}
+		m_maxEnd.resize(m_spans.size());
+		BuildMaxEnd(m_spans, m_maxEnd, 0, m_spans.size());
+	}
+
+	void RepeaterIndex::Overlapping(size_t first, size_t last, double from, double to, std::vector<uint32_t>& spans) const
+	{
+		while (first < last)
+		{
+			size_t middle = first + (last - first) / 2;
+			if (m_maxEnd[middle] <= from)
+			{
+				return;
+			}
+			Overlapping(first, middle, from, to, spans);
+			if (m_spans[middle].begin >= to)
+			{
+				return;
+			}
+			if (m_spans[middle].end > from)
+			{
+				spans.push_back(uint32_t(middle));
+			}
+			first = middle + 1;
+		}
+	}
+
+	void RepeaterIndex::Expand(double from, double to, std::vector<RepeaterInstance>& out) const
+	{
+		std::vector<uint32_t> spans;
+		Overlapping(0, m_spans.size(), from, to, spans);
+
+		size_t first = out.size();
+		for (uint32_t n : spans)
+		{
+			auto& span = m_spans[n];
+			double stop = std::min(span.end, to);
+
+			// First multiple of the interval at or after from
+			long long k = std::max(0LL, static_cast<long long>(std::ceil((from - span.begin) / span.interval)));
+			for (;; k++)
+			{
+				double distance = span.begin + k * span.interval;
+				if (distance >= stop)
+				{
+					break;
+				}
+				if (distance < from)
+				{
+					continue;
+				}
+				out.push_back({ distance, m_structures[span.firstStructure + k % span.structureCount], span.event });
+			}
+		}
+		std::stable_sort(out.begin() + first, out.end(),
+			[](const RepeaterInstance& a, const RepeaterInstance& b) { return a.distance < b.distance; });
+	}
+
+	RepeaterWindow::RepeaterWindow(const RepeaterIndex& index, double chunkLength) :
+		m_index(&index),
+		m_chunkLength(chunkLength)
+	{
+	}
+
+	size_t RepeaterWindow::SlotOf(long long chunk) const
+	{
+		long long size = static_cast<long long>(m_slots.size());
+		return static_cast<size_t>(((chunk % size) + size) % size);
+	}
+
+	void RepeaterWindow::Grow(size_t chunks)
+	{
+		// Cached chunks move to their slot in the larger ring; its size is a
+		// multiple of the old one, so no two of them meet in one slot
+		std::vector<Slot> old;
+		old.swap(m_slots);
+		size_t size = std::max<size_t>(old.size(), 8);
+		while (size < chunks)
+		{
+			size *= 2;
+		}
+		m_slots.resize(size);
+		for (auto& slot : m_slots)
+		{
+			slot.chunk = NO_CHUNK;
+		}
+		for (auto& slot : old)
+		{
+			if (slot.chunk != NO_CHUNK)
+			{
+				m_slots[SlotOf(slot.chunk)] = std::move(slot);
+			}
+		}
+	}
+
+	size_t RepeaterWindow::Update(double from, double to)
+	{
+		m_first = static_cast<long long>(std::floor(from / m_chunkLength));
+		m_last = std::max(m_first, static_cast<long long>(std::floor(to / m_chunkLength)));
+
+		size_t chunks = static_cast<size_t>(m_last - m_first + 1);
+		if (chunks > m_slots.size())
+		{
+			Grow(chunks);
+		}
+
+		size_t expanded = 0;
+		for (long long chunk = m_first; chunk <= m_last; chunk++)
+		{
+			Slot& slot = m_slots[SlotOf(chunk)];
+			if (slot.chunk == chunk)
+			{
+				continue;
+			}
+			// Keeps the capacity of the chunk that left
+			slot.instances.clear();
+			m_index->Expand(chunk * m_chunkLength, (chunk + 1) * m_chunkLength, slot.instances);
+			slot.chunk = chunk;
+			expanded++;
+		}
+		return expanded;
+	}
+
+	const std::vector<RepeaterInstance>& RepeaterWindow::Chunk(long long chunk) const
+	{
+		return m_slots[SlotOf(chunk)].instances;
+	}
+
+	size_t RepeaterWindow::InstanceCount() const
+	{
+		size_t count = 0;
+		for (long long chunk = m_first; chunk <= m_last; chunk++)
+		{
+			count += Chunk(chunk).size();
+		}
+		return count;
+	}
+
+	size_t RepeaterWindow::MemoryUsage() const
+	{
+		size_t bytes = m_slots.capacity() * sizeof(Slot);
+		for (auto& slot : m_slots)
+		{
+			bytes += slot.instances.capacity() * sizeof(RepeaterInstance);
+		}
+		return bytes;
+	}
+}
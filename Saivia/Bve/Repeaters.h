@@ -0,0 +1,108 @@
+//
+// Repeaters.h - Repeater spans of a route, expanded chunk by chunk near the view
+//
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "MapCompiler.h"
+
+namespace Bve
+{
+	// Length of the chunks the window expands; the same as Gfx::CHUNK_LENGTH
+	const double REPEATER_CHUNK_LENGTH = 100.0;
+
+	// Repeater[key].Begin(...) up to the End() of the same key, or to the
+	// next Begin of it, which starts over: structures every interval from
+	// begin, taking the structure list in turn.
+	struct RepeaterSpan
+	{
+		double begin;
+		double end;                     // exclusive
+		double interval;
+		uint32_t firstStructure;        // into RepeaterIndex::Structures()
+		uint32_t structureCount;
+		uint32_t event;                 // into EventTable::repeaterBegins, for the placement
+	};
+
+	// One structure put by a repeater
+	struct RepeaterInstance
+	{
+		double distance;
+		Symbol structure;
+		uint32_t event;                 // into EventTable::repeaterBegins
+	};
+
+	// The spans of a whole route, kept symbolic: a long route repeats
+	// hundreds of thousands of structures, only those near the view are
+	// ever expanded. Spans are sorted by begin with an implicit interval
+	// tree over them (each node the middle of its range, holding the
+	// largest end below it), so the spans overlapping a stretch are found
+	// in O(log n + k).
+	class RepeaterIndex
+	{
+	public:
+		// Spans still open at end (the end of the route) stop there.
+		void Build(const EventTable& table, double end);
+
+		// Appends the instances with distance in [from, to) to out, by distance.
+		void Expand(double from, double to, std::vector<RepeaterInstance>& out) const;
+
+		const std::vector<RepeaterSpan>& Spans() const { return m_spans; }
+		const std::vector<Symbol>& Structures() const { return m_structures; }
+
+		// Instances of the whole route, were it expanded at once
+		size_t InstanceCount() const { return m_instanceCount; }
+
+	private:
+		void Overlapping(size_t first, size_t last, double from, double to, std::vector<uint32_t>& spans) const;
+
+		std::vector<RepeaterSpan> m_spans;
+		std::vector<double> m_maxEnd;       // of the implicit subtree of each span
+		std::vector<Symbol> m_structures;
+		size_t m_instanceCount = 0;
+	};
+
+	// Expanded instances of the chunks in a distance window, cached in a
+	// ring keyed by chunk: chunk c lives in slot c mod the ring size, so as
+	// the window moves only chunks entering it are expanded, into the slot
+	// (and the memory) of one that left. The ring grows to the widest
+	// window asked for, never with the route.
+	class RepeaterWindow
+	{
+	public:
+		explicit RepeaterWindow(const RepeaterIndex& index, double chunkLength = REPEATER_CHUNK_LENGTH);
+
+		// Expands the chunks overlapping [from, to] that are not cached.
+		// Returns the number of chunks expanded.
+		size_t Update(double from, double to);
+
+		long long FirstChunk() const { return m_first; }
+		long long LastChunk() const { return m_last; }
+		double ChunkLength() const { return m_chunkLength; }
+
+		// Instances of a chunk in [FirstChunk(), LastChunk()], by distance
+		const std::vector<RepeaterInstance>& Chunk(long long chunk) const;
+
+		size_t InstanceCount() const;       // in the window
+		size_t MemoryUsage() const;         // bytes held by the ring
+
+	private:
+		struct Slot
+		{
+			long long chunk;
+			std::vector<RepeaterInstance> instances;
+		};
+
+		size_t SlotOf(long long chunk) const;
+		void Grow(size_t chunks);
+
+		const RepeaterIndex* m_index;
+		double m_chunkLength;
+		std::vector<Slot> m_slots;
+		long long m_first = 0;
+		long long m_last = -1;
+	};
+}
@@ -0,0 +1,243 @@
+//
+// RouteAlignment.cpp
+//
+
+#include "RouteAlignment.h"
+
+#include <algorithm>
+#include <cmath>
+#include <exception>
+
+namespace Bve
+{
+	namespace
+	{
+		// Horizontal stretch [from, to] whose curvature and bank change
+		// linearly from the start to the end values
+		struct Piece
+		{
+			double from, to;
+			double curvature0, curvature1;
+			double bank0, bank1;
+		};
+
+		// Grade change to gradient (per mille) starting at chainage at
+		struct GradeChange
+		{
+			double at;
+			double gradient;
+			double length;
+		};
+
+		double Bank(double cant, double gauge)
+		{
+			return std::asin(std::clamp(-cant / gauge, -1.0, 1.0));
+		}
+
+		// Alignment banks by sin(command.cant) towards the turn
+		double CommandCant(double bank, double sign)
+		{
+			return std::asin(std::clamp(sign * bank, -1.0, 1.0));
+		}
+
+		void AddPiece(std::vector<Piece>& pieces, double from, double to, double curvature0, double curvature1, double bank0, double bank1)
+		{
+			if (to > from)
+			{
+				pieces.push_back({ from, to, curvature0, curvature1, bank0, bank1 });
+			}
+		}
+
+		// Ends at curvature1 / bank1; starts from the end of the previous
+		// command, which is curvature0 / bank0
+		void AddCommand(std::vector<Track::Command>& commands, double length, double curvature0, double curvature1, double bank0, double bank1)
+		{
+			Track::Command command;
+			command.length = length;
+			if (curvature0 != curvature1 || bank0 != bank1)
+			{
+				command.type = Track::CommandType::TransitionCurve;
+			}
+			else
+			{
+				command.type = curvature1 == 0.0 ? Track::CommandType::Straight : Track::CommandType::Curve;
+			}
+			if (curvature1 != 0.0)
+			{
+				double sign = curvature1 > 0.0 ? 1.0 : -1.0;
+				command.turn = curvature1 > 0.0 ? Track::Turn::Left : Track::Turn::Right;
+				command.radius = 1.0 / std::abs(curvature1);
+				command.cant = CommandCant(bank1, sign);
+			}
+			commands.push_back(command);
+		}
+
+		void AddGradient(std::vector<Track::Command>& commands, const GradeChange& change)
+		{
+			Track::Command command;
+			command.type = Track::CommandType::Gradient;
+			command.gradient = change.gradient;
+			command.length = change.length;
+			commands.push_back(command);
+		}
+	}
+
+	RouteAlignment ConvertAlignment(const EventTable& table)
+	{
+		RouteAlignment route;
+		if (table.Size() == 0)
+		{
+			return route;
+		}
+		route.origin = std::min(0.0, table.distances.front());
+		double end = std::max(route.origin, table.distances.back());
+		route.length = end - route.origin;
+
+		std::vector<Piece> pieces;
+		std::vector<GradeChange> changes;
+		pieces.reserve(table.rows[size_t(EventType::Curve)].size() * 2 + 1);
+		changes.reserve(table.rows[size_t(EventType::Gradient)].size());
+
+		double gauge = DEFAULT_GAUGE;
+		double done = route.origin;         // pieces are added up to here
+		double curvature = 0.0;
+		double bank = 0.0;
+		bool transition = false;
+		double transitionStart = 0.0;
+		bool gradeTransition = false;
+		double gradeTransitionStart = 0.0;
+
+		for (size_t row = 0; row < table.Size(); row++)
+		{
+			double distance = table.distances[row];
+			uint32_t payload = table.payloads[row];
+			switch (table.types[row])
+			{
+			case EventType::Gauge:
+				// Gauges of the named tracks do not bank the own track
+				if (table.gauges[payload].track == NO_SYMBOL)
+				{
+					gauge = table.gauges[payload].gauge;
+				}
+				break;
+
+			case EventType::CurveTransition:
+				transition = true;
+				transitionStart = distance;
+				break;
+
+			case EventType::Curve:
+			{
+				auto& curve = table.curves[payload];
+				double nextCurvature = curve.radius == 0.0 ? 0.0 : -1.0 / curve.radius;
+				double nextBank = curve.radius == 0.0 ? 0.0 : Bank(curve.cant, gauge);
+				if (transition)
+				{
+					double start = std::clamp(transitionStart, done, distance);
+					AddPiece(pieces, done, start, curvature, curvature, bank, bank);
+					AddPiece(pieces, start, distance, curvature, nextCurvature, bank, nextBank);
+				}
+				else
+				{
+					AddPiece(pieces, done, distance, curvature, curvature, bank, bank);
+				}
+				done = distance;
+				curvature = nextCurvature;
+				bank = nextBank;
+				transition = false;
+				break;
+			}
+
+			case EventType::GradientTransition:
+				gradeTransition = true;
+				gradeTransitionStart = distance;
+				break;
+
+			case EventType::Gradient:
+			{
+				double start = gradeTransition ? gradeTransitionStart : distance;
+				changes.push_back({ start - route.origin, table.gradients[payload].gradient, distance - start });
+				gradeTransition = false;
+				break;
+			}
+
+			default:
+				break;
+			}
+		}
+		AddPiece(pieces, done, end, curvature, curvature, bank, bank);
+
+		// Gradient commands take no length: they go between the horizontal
+		// commands, splitting a piece where a grade change starts inside it
+		route.commands.reserve(pieces.size() + changes.size() * 2);
+		size_t change = 0;
+		for (auto& piece : pieces)
+		{
+			double from = piece.from - route.origin;
+			double to = piece.to - route.origin;
+			double length = to - from;
+			double curvatureRate = (piece.curvature1 - piece.curvature0) / length;
+			double bankRate = (piece.bank1 - piece.bank0) / length;
+
+			double at = from;
+			double atCurvature = piece.curvature0;
+			double atBank = piece.bank0;
+			for (; change < changes.size() && changes[change].at < to; change++)
+			{
+				double split = std::max(changes[change].at, at);
+				if (split > at)
+				{
+					// Within a transition the curvature and bank at the split
+					// continue on the same straight lines
+					double splitCurvature = piece.curvature0 + curvatureRate * (split - from);
+					double splitBank = piece.bank0 + bankRate * (split - from);
+					AddCommand(route.commands, split - at, atCurvature, splitCurvature, atBank, splitBank);
+					at = split;
+					atCurvature = splitCurvature;
+					atBank = splitBank;
+				}
+
+				AddGradient(route.commands, changes[change]);
+			}
+			AddCommand(route.commands, to - at, atCurvature, piece.curvature1, atBank, piece.bank1);
+		}
+
+		// Grade changes at or past the end of the route
+		for (; change < changes.size(); change++)
+		{
+			AddGradient(route.commands, changes[change]);
+		}
+		return route;
+	}
+
+	void LoadRoutes(Track::World& world, const std::filesystem::path& directory)
+	{
+		for (auto& railway : world.railways)
+		{
+			if (railway.route.empty())
+			{
+				continue;
+			}
+			try
+			{
+				MapFile map = LoadMap(directory / std::filesystem::u8path(railway.route));
+				EventTable events = CompileMap(map);
+				railway.data = ConvertAlignment(events).commands;
+
+				// One line per map: a route can have hundreds of statements
+				// this program does not know
+				size_t skipped = map.errors.size() + events.errors.size();
+				if (skipped > 0)
+				{
+					const std::string& first = map.errors.empty() ? events.errors.front() : map.errors.front();
+					world.errors.push_back(railway.name + ": " + railway.route + " " + first +
+						(skipped > 1 ? " (and " + std::to_string(skipped - 1) + " more)" : std::string()));
+				}
+			}
+			catch (const std::exception& e)
+			{
+				world.errors.push_back(railway.name + ": " + railway.route + ": " + e.what());
+			}
+		}
+	}
+}
@@ -0,0 +1,44 @@
+//
+// RouteAlignment.h - The own track of a BVE route as railway commands
+//
+
+#pragma once
+
+#include <filesystem>
+#include <vector>
+
+#include "../Track/Railway.h"
+#include "MapCompiler.h"
+
+namespace Bve
+{
+	// Gauge until the map sets one (Curve.Gauge)
+	const double DEFAULT_GAUGE = 1.067;
+
+	// Chainage 0 of the commands is distance origin of the route, so an
+	// event at distance d sits at chainage d - origin.
+	struct RouteAlignment
+	{
+		std::vector<Track::Command> commands;
+		double origin = 0.0;
+		double length = 0.0;
+	};
+
+	// Curve and Gradient events become Straight, Curve, TransitionCurve and
+	// Gradient commands, so a route is generated, rendered and edited like
+	// a World.json railway:
+	//   Curve.Begin(radius, cant)       arc (or straight for radius 0) from here
+	//   Curve.BeginTransition()         clothoid from here to the next Begin / End,
+	//                                   curvature and cant changing linearly
+	//   Gradient.Begin(permil)          sharp change of grade, or a vertical curve
+	//                                   from the last Gradient.BeginTransition()
+	// BVE radii are positive to the right, Saivia turns left for positive
+	// curvature; cant (m, signed like the radius) becomes a bank angle over
+	// the gauge. One pass over the table.
+	RouteAlignment ConvertAlignment(const EventTable& table);
+
+	// Fills Data of every railway of world that names a Route, the map file
+	// relative to directory. Maps that cannot be read or compiled are
+	// reported in world.errors.
+	void LoadRoutes(Track::World& world, const std::filesystem::path& directory);
+}
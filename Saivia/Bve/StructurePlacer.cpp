@@ -0,0 +1,123 @@
+//
+// StructurePlacer.cpp
+//
+
+#include "StructurePlacer.h"
+
+#include <cmath>
+
+namespace Bve
+{
+	namespace
+	{
+		const double DEGREES = 3.14159265358979323846 / 180.0;
+
+		// Rotation of the structure as BVE applies it: z, then x, then y,
+		// left-handed (rows: DirectX XMMatrixRotationZ * X * Y)
+		void Rotation(const Placement& placement, double m[3][3])
+		{
+			double cx = std::cos(placement.rx * DEGREES), sx = std::sin(placement.rx * DEGREES);
+			double cy = std::cos(placement.ry * DEGREES), sy = std::sin(placement.ry * DEGREES);
+			double cz = std::cos(placement.rz * DEGREES), sz = std::sin(placement.rz * DEGREES);
+			double z[3][3] = { { cz, sz, 0.0 }, { -sz, cz, 0.0 }, { 0.0, 0.0, 1.0 } };
+			double x[3][3] = { { 1.0, 0.0, 0.0 }, { 0.0, cx, sx }, { 0.0, -sx, cx } };
+			double y[3][3] = { { cy, 0.0, -sy }, { 0.0, 1.0, 0.0 }, { sy, 0.0, cy } };
+
+			double zx[3][3];
+			for (int r = 0; r < 3; r++)
+			{
+				for (int c = 0; c < 3; c++)
+				{
+					zx[r][c] = z[r][0] * x[0][c] + z[r][1] * x[1][c] + z[r][2] * x[2][c];
+				}
+			}
+			for (int r = 0; r < 3; r++)
+			{
+				for (int c = 0; c < 3; c++)
+				{
+					m[r][c] = zx[r][0] * y[0][c] + zx[r][1] * y[1][c] + zx[r][2] * y[2][c];
+				}
+			}
+		}
+	}
+
+	StructurePlacer::StructurePlacer(const EventTable& table, const Track::Alignment& alignment, const TrackOffsets& offsets, double origin) :
+		m_table(table),
+		m_offsets(offsets),
+		m_origin(origin),
+		m_alignment(alignment)
+	{
+		m_tracks.reserve(offsets.TrackCount());
+		for (uint32_t track = 0; track < offsets.TrackCount(); track++)
+		{
+			m_tracks.emplace_back(offsets.Curve(track));
+		}
+	}
+
+	Track::Frame StructurePlacer::Place(double distance, const Placement& placement)
+	{
+		Track::Pose pose = m_alignment.At(distance - m_origin);
+
+		TrackOffset offset;
+		uint32_t track = m_offsets.TrackIndex(placement.track);
+		if (track != NO_TRACK)
+		{
+			offset = m_tracks[track].At(distance);
+		}
+
+		// The named track: moved across the own track (level, so a track
+		// offset stays horizontal on a cant) and turned by its slope
+		double sinHeading = std::sin(pose.heading);
+		double cosHeading = std::cos(pose.heading);
+		Track::Vec3 across(-cosHeading, 0.0, sinHeading);
+		Track::Vec3 position = pose.Pos + across * offset.x;
+		position.y += offset.y;
+
+		double heading = pose.heading - std::atan(offset.dx);
+		double grade = (placement.tilt & 1) ? pose.grade + offset.dy : 0.0;
+		double bank = (placement.tilt & 2) ? pose.bank : 0.0;
+		Track::Frame frame = Track::MakeFrame(position, std::sin(heading), std::cos(heading), grade, std::sin(bank), std::cos(bank));
+
+		// Structure axes: right, up, forward
+		Track::Vec3 right = -frame.B;
+		Track::Vec3 up = frame.N;
+		Track::Vec3 forward = frame.T;
+
+		Track::Frame placed;
+		placed.Pos = position + right * placement.x + up * placement.y + forward * placement.z;
+		if (placement.rx == 0.0f && placement.ry == 0.0f && placement.rz == 0.0f)
+		{
+			placed.B = right;
+			placed.N = up;
+			placed.T = forward;
+			return placed;
+		}
+
+		double m[3][3];
+		Rotation(placement, m);
+		placed.B = right * m[0][0] + up * m[0][1] + forward * m[0][2];
+		placed.N = right * m[1][0] + up * m[1][1] + forward * m[1][2];
+		placed.T = right * m[2][0] + up * m[2][1] + forward * m[2][2];
+		return placed;
+	}
+
+	void StructurePlacer::PlaceStructures(std::vector<PlacedStructure>& out)
+	{
+		auto& structures = m_table.structures;
+		out.reserve(out.size() + structures.size());
+		for (size_t n = 0; n < structures.size(); n++)
+		{
+			double distance = m_table.Distance(EventType::StructurePut, n);
+			out.push_back({ structures[n].structure, Place(distance, structures[n].placement) });
+		}
+	}
+
+	void StructurePlacer::PlaceRepeaters(const std::vector<RepeaterInstance>& instances, std::vector<PlacedStructure>& out)
+	{
+		out.reserve(out.size() + instances.size());
+		for (auto& instance : instances)
+		{
+			out.push_back({ instance.structure, Place(instance.distance, m_table.repeaterBegins[instance.event].placement) });
+		}
+	}
+}
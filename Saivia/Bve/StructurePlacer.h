@@ -0,0 +1,57 @@
+//
+// StructurePlacer.h - World frames of the structures a route puts
+//
+
+#pragma once
+
+#include <vector>
+
+#include "../Track/Alignment.h"
+#include "Repeaters.h"
+#include "TrackOffsets.h"
+
+namespace Bve
+{
+	// A structure resolved to where it stands. The frame's rows take the
+	// structure's own axes as BVE models are written (x right, y up,
+	// z forward) into the world: B is its right, N its up, T its forward.
+	// That is a mirror of a Track frame, where B points left.
+	struct PlacedStructure
+	{
+		Symbol structure;
+		Track::Frame frame;
+	};
+
+	// Resolves placements (track, offsets, rotation, tilt) against the own
+	// track's alignment and the offset curves of the named tracks. Objects
+	// come in distance order, so the alignment and every track offset are
+	// followed with cursors: placing a whole route is one linear pass, not
+	// a search per object. Going back (a chunk behind the last one placed)
+	// costs one search.
+	//
+	// A structure faces along its track (the own track turned by the slope
+	// of the track offset) instead of along a chord of the given span. It
+	// follows the gradient (tilt 1) and cant (tilt 2) of the own track.
+	class StructurePlacer
+	{
+	public:
+		// Distance origin is at chainage 0 of alignment (RouteAlignment::origin).
+		// table, alignment and offsets must outlive the placer.
+		StructurePlacer(const EventTable& table, const Track::Alignment& alignment, const TrackOffsets& offsets, double origin);
+
+		// Every Structure.Put of the route
+		void PlaceStructures(std::vector<PlacedStructure>& out);
+
+		// Instances of repeaters (a chunk of a RepeaterWindow, say), by distance
+		void PlaceRepeaters(const std::vector<RepeaterInstance>& instances, std::vector<PlacedStructure>& out);
+
+		Track::Frame Place(double distance, const Placement& placement);
+
+	private:
+		const EventTable& m_table;
+		const TrackOffsets& m_offsets;
+		double m_origin;
+		Track::Alignment::Cursor m_alignment;
+		std::vector<OffsetCurve::Cursor> m_tracks;  // by TrackOffsets index
+	};
+}
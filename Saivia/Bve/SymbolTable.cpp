@@ -0,0 +1,126 @@
+//
+// SymbolTable.cpp
+//
+
+#include "SymbolTable.h"
+
+namespace Bve
+{
+	namespace
+	{
+		char Fold(char c)
+		{
+			return c >= 'A' && c <= 'Z' ? char(c - 'A' + 'a') : c;
+		}
+	}
+
+	bool SymbolTable::Equal(std::string_view a, std::string_view b)
+	{
+		if (a.size() != b.size())
+		{
+			return false;
+		}
+		for (size_t n = 0; n < a.size(); n++)
+		{
+			if (Fold(a[n]) != Fold(b[n]))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	uint32_t SymbolTable::Hash(std::string_view text)
+	{
+		uint32_t hash = 2166136261u;
+		for (char c : text)
+		{
+			hash = (hash ^ uint8_t(Fold(c))) * 16777619u;
+		}
+		return hash;
+	}
+
+	Symbol SymbolTable::Find(std::string_view text) const
+	{
+		if (m_slots.empty())
+		{
+			return NO_SYMBOL;
+		}
+		uint32_t hash = Hash(text);
+		size_t mask = m_slots.size() - 1;
+		for (size_t slot = hash & mask;; slot = (slot + 1) & mask)
+		{
+			Symbol symbol = m_slots[slot];
+			if (symbol == NO_SYMBOL)
+			{
+				return NO_SYMBOL;
+			}
+			if (m_hashes[symbol] == hash && Equal(m_names[symbol], text))
+			{
+				return symbol;
+			}
+		}
+	}
+
+	Symbol SymbolTable::Intern(std::string_view text)
+	{
+		return Insert(text, false);
+	}
+
+	Symbol SymbolTable::InternCopy(std::string_view text)
+	{
+		return Insert(text, true);
+	}
+
+	Symbol SymbolTable::Insert(std::string_view text, bool copy)
+	{
+		// At most half full
+		if ((m_names.size() + 1) * 2 > m_slots.size())
+		{
+			Grow();
+		}
+
+		uint32_t hash = Hash(text);
+		size_t mask = m_slots.size() - 1;
+		size_t slot = hash & mask;
+		for (;; slot = (slot + 1) & mask)
+		{
+			Symbol symbol = m_slots[slot];
+			if (symbol == NO_SYMBOL)
+			{
+				break;
+			}
+			if (m_hashes[symbol] == hash && Equal(m_names[symbol], text))
+			{
+				return symbol;
+			}
+		}
+
+		if (copy)
+		{
+			m_copies.emplace_back(text);
+			text = m_copies.back();
+		}
+		Symbol symbol = static_cast<Symbol>(m_names.size());
+		m_names.push_back(text);
+		m_hashes.push_back(hash);
+		m_slots[slot] = symbol;
+		return symbol;
+	}
+
+	void SymbolTable::Grow()
+	{
+		std::vector<Symbol> slots(m_slots.empty() ? 64 : m_slots.size() * 2, NO_SYMBOL);
+		size_t mask = slots.size() - 1;
+		for (Symbol symbol = 0; symbol < m_names.size(); symbol++)
+		{
+			size_t slot = m_hashes[symbol] & mask;
+			while (slots[slot] != NO_SYMBOL)
+			{
+				slot = (slot + 1) & mask;
+			}
+			slots[slot] = symbol;
+		}
+		m_slots.swap(slots);
+	}
+}
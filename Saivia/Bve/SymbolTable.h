@@ -0,0 +1,49 @@
+//
+// SymbolTable.h - Interned, case-insensitive names
+//
+
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Bve
+{
+	using Symbol = uint32_t;
+	const Symbol NO_SYMBOL = 0xffffffffu;
+
+	// Maps names to small dense numbers, so statements compare and index
+	// by number instead of by string. BVE names and keys ignore ASCII case:
+	// 'Opp' and 'OPP' are one symbol, spelled as it was seen first.
+	//
+	// Intern does not copy the text, it points into it: the text must
+	// outlive the table (a map file's own mapping, say). InternCopy is for
+	// names built while parsing.
+	class SymbolTable
+	{
+	public:
+		Symbol Intern(std::string_view text);
+		Symbol InternCopy(std::string_view text);
+
+		// NO_SYMBOL when text was never interned
+		Symbol Find(std::string_view text) const;
+
+		std::string_view Name(Symbol symbol) const { return m_names[symbol]; }
+		size_t Size() const { return m_names.size(); }
+
+		static bool Equal(std::string_view a, std::string_view b);
+
+	private:
+		static uint32_t Hash(std::string_view text);
+		Symbol Insert(std::string_view text, bool copy);
+		void Grow();
+
+		std::vector<std::string_view> m_names;
+		std::vector<uint32_t> m_hashes;
+		std::vector<Symbol> m_slots;        // open addressing, NO_SYMBOL when free
+		std::deque<std::string> m_copies;   // a deque does not move its strings
+	};
+}
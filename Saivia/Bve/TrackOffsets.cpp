@@ -0,0 +1,135 @@
+//
+// TrackOffsets.cpp
+//
+
+#include "TrackOffsets.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace Bve
+{
+	void OffsetCurve::Solve(Axis& axis, double distance0, double distance1, double value1, double radius)
+	{
+		double run = distance1 - distance0;
+		double rise = value1 - axis.value;
+		axis.slope = run > 0.0 ? rise / run : 0.0;
+		axis.radius = 0.0;
+
+		// The centre lies on the perpendicular bisector of the chord, on the
+		// side the track bends to; a radius shorter than half the chord
+		// cannot reach and the piece stays straight.
+		double chord = std::sqrt(run * run + rise * rise);
+		if (radius == 0.0 || run <= 0.0 || std::abs(radius) < 0.5 * chord)
+		{
+			return;
+		}
+		double height = std::sqrt(radius * radius - 0.25 * chord * chord);
+		double sign = radius > 0.0 ? 1.0 : -1.0;
+		axis.radius = radius;
+		axis.centerDistance = distance0 + 0.5 * run - sign * height * rise / chord;
+		axis.centerValue = axis.value + 0.5 * rise + sign * height * run / chord;
+	}
+
+	void OffsetCurve::EvaluateAxis(const Axis& axis, double start, double distance, double& value, double& derivative)
+	{
+		if (axis.radius == 0.0)
+		{
+			value = axis.value + axis.slope * (distance - start);
+			derivative = axis.slope;
+			return;
+		}
+		// The near side of the circle: value = centre -+ sqrt(r^2 - u^2)
+		double sign = axis.radius > 0.0 ? 1.0 : -1.0;
+		double u = distance - axis.centerDistance;
+		double root = std::sqrt(std::max(axis.radius * axis.radius - u * u, 1e-12));
+		value = axis.centerValue - sign * root;
+		derivative = sign * u / root;
+	}
+
+	void OffsetCurve::Add(double distance, double x, double y, double radiusH, double radiusV)
+	{
+		if (!m_pieces.empty())
+		{
+			Piece& last = m_pieces.back();
+			Solve(last.x, last.distance, distance, x, last.radiusH);
+			Solve(last.y, last.distance, distance, y, last.radiusV);
+		}
+
+		// Until the next statement the offset holds
+		Piece piece;
+		piece.distance = distance;
+		piece.x = { x, 0.0, 0.0, 0.0, 0.0 };
+		piece.y = { y, 0.0, 0.0, 0.0, 0.0 };
+		piece.radiusH = radiusH;
+		piece.radiusV = radiusV;
+		m_pieces.push_back(piece);
+	}
+
+	size_t OffsetCurve::Find(double distance) const
+	{
+		auto found = std::upper_bound(m_pieces.begin(), m_pieces.end(), distance,
+			[](double s, const Piece& piece) { return s < piece.distance; });
+		return found == m_pieces.begin() ? 0 : size_t(found - m_pieces.begin()) - 1;
+	}
+
+	TrackOffset OffsetCurve::Evaluate(size_t index, double distance) const
+	{
+		TrackOffset offset;
+		if (m_pieces.empty())
+		{
+			return offset;
+		}
+		// Before the first statement the track holds its first offset; from
+		// a statement on (including at it) the piece's line or arc applies
+		const Piece& piece = m_pieces[index];
+		if (index == 0 && distance < piece.distance)
+		{
+			offset.x = piece.x.value;
+			offset.y = piece.y.value;
+			return offset;
+		}
+		EvaluateAxis(piece.x, piece.distance, distance, offset.x, offset.dx);
+		EvaluateAxis(piece.y, piece.distance, distance, offset.y, offset.dy);
+		return offset;
+	}
+
+	TrackOffset OffsetCurve::Cursor::At(double distance)
+	{
+		auto& pieces = m_curve->m_pieces;
+		if (!pieces.empty())
+		{
+			if (m_piece >= pieces.size() || distance < pieces[m_piece].distance)
+			{
+				m_piece = m_curve->Find(distance);
+			}
+			while (m_piece + 1 < pieces.size() && pieces[m_piece + 1].distance <= distance)
+			{
+				m_piece++;
+			}
+		}
+		return m_curve->Evaluate(m_piece, distance);
+	}
+
+	void TrackOffsets::Build(const EventTable& table)
+	{
+		m_trackIndex.clear();
+		m_curves.clear();
+
+		for (uint32_t row : table.rows[size_t(EventType::TrackPosition)])
+		{
+			auto& position = table.trackPositions[table.payloads[row]];
+			if (position.track >= m_trackIndex.size())
+			{
+				m_trackIndex.resize(position.track + 1, NO_TRACK);
+			}
+			uint32_t& index = m_trackIndex[position.track];
+			if (index == NO_TRACK)
+			{
+				index = uint32_t(m_curves.size());
+				m_curves.emplace_back();
+			}
+			m_curves[index].Add(table.distances[row], position.x, position.y, position.radiusH, position.radiusV);
+		}
+	}
+}
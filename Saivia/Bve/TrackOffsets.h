@@ -0,0 +1,103 @@
+//
+// TrackOffsets.h - Offsets of the named tracks of a route from its own track
+//
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "MapCompiler.h"
+
+namespace Bve
+{
+	// Offset of a track at one distance: x to the right, y up (m), and how
+	// fast they change along the own track (dx/ds, dy/ds).
+	struct TrackOffset
+	{
+		double x = 0.0, y = 0.0;
+		double dx = 0.0, dy = 0.0;
+	};
+
+	// Track[key].Position(x, y, radiusH, radiusV) statements of one track.
+	// From each one to the next, x and y follow a straight line, or a
+	// circular arc of the radius (relative to the own track, positive
+	// bending right / up) when it is given. Past the last one they stay.
+	// The lines and arcs are solved when the curve is built; evaluating is a
+	// search for the piece, or O(1) with a cursor.
+	class OffsetCurve
+	{
+	public:
+		void Add(double distance, double x, double y, double radiusH, double radiusV);
+
+		// Piece starting at or before distance (the first one before them all)
+		size_t Find(double distance) const;
+		TrackOffset Evaluate(size_t piece, double distance) const;
+		TrackOffset At(double distance) const { return Evaluate(Find(distance), distance); }
+
+		bool Empty() const { return m_pieces.empty(); }
+
+		// Amortized O(1) evaluation for increasing distances; falls back to
+		// the search when distance moves backwards.
+		class Cursor
+		{
+		public:
+			Cursor() : m_curve(nullptr), m_piece(0) {}
+			explicit Cursor(const OffsetCurve& curve) : m_curve(&curve), m_piece(0) {}
+
+			TrackOffset At(double distance);
+
+		private:
+			const OffsetCurve* m_curve;
+			size_t m_piece;
+		};
+
+	private:
+		// One coordinate from a statement to the next
+		struct Axis
+		{
+			double value;               // at the start of the piece
+			double slope;               // straight: value + slope * (s - start)
+			double radius;              // arc when not 0, centred at
+			double centerDistance;
+			double centerValue;
+		};
+
+		struct Piece
+		{
+			double distance;
+			Axis x, y;
+			double radiusH, radiusV;    // as given, solved when the next point comes
+		};
+
+		static void Solve(Axis& axis, double distance0, double distance1, double value1, double radius);
+		static void EvaluateAxis(const Axis& axis, double start, double distance, double& value, double& derivative);
+
+		std::vector<Piece> m_pieces;
+	};
+
+	const uint32_t NO_TRACK = 0xffffffffu;
+
+	// The offset curves of every named track of a route, looked up by the
+	// track's symbol. The own track (NO_SYMBOL) and tracks that were never
+	// positioned are at offset 0.
+	class TrackOffsets
+	{
+	public:
+		// Takes the TrackPosition events in table order, i.e. by distance.
+		void Build(const EventTable& table);
+
+		// Index of a track's curve, NO_TRACK for the own track
+		uint32_t TrackIndex(Symbol track) const
+		{
+			return track < m_trackIndex.size() ? m_trackIndex[track] : NO_TRACK;
+		}
+
+		const OffsetCurve& Curve(uint32_t index) const { return m_curves[index]; }
+		size_t TrackCount() const { return m_curves.size(); }
+
+	private:
+		std::vector<uint32_t> m_trackIndex;     // by symbol
+		std::vector<OffsetCurve> m_curves;
+	};
+}
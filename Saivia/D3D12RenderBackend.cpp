@@ -0,0 +1,651 @@
+//
+// D3D12RenderBackend.cpp
+//
+
+#include "pch.h"
+#include "D3D12RenderBackend.h"
+
+#include <d3dcompiler.h>
+#pragma comment( lib, "d3dcompiler.lib" )
+
+using namespace DirectX;
+
+using Microsoft::WRL::ComPtr;
+
+namespace
+{
+	// Textured, one directional light. VSMain draws instances: the world
+	// matrix arrives transposed as three float4 rows (Gfx::InstanceTransform).
+	// VSMesh draws Gfx::MeshVertex with the world matrix from the constants
+	// and the vertex color as tint.
+	const char INSTANCED_SHADER[] = R"(
+cbuffer Frame : register(b0)
+{
+	float4x4 ViewProjection;
+	float4 LightDirection;
+	float4x4 World;
+};
+
+Texture2D Diffuse : register(t0);
+SamplerState Sampler : register(s0);
+
+struct VSInput
+{
+	float4 Position : SV_Position;
+	float3 Normal : NORMAL;
+	float2 TexCoord : TEXCOORD0;
+	float4 World0 : InstMatrix0;
+	float4 World1 : InstMatrix1;
+	float4 World2 : InstMatrix2;
+};
+
+struct VSMeshInput
+{
+	float4 Position : SV_Position;
+	float3 Normal : NORMAL;
+	float4 Color : COLOR0;
+	float2 TexCoord : TEXCOORD0;
+};
+
+struct PSInput
+{
+	float4 Position : SV_Position;
+	float3 Normal : NORMAL;
+	float4 Color : COLOR0;
+	float2 TexCoord : TEXCOORD0;
+};
+
+PSInput VSMain(VSInput input)
+{
+	float4 position = float4(input.Position.xyz, 1);
+	float3 world = float3(dot(input.World0, position), dot(input.World1, position), dot(input.World2, position));
+
+	PSInput output;
+	output.Position = mul(float4(world, 1), ViewProjection);
+	output.Normal = float3(dot(input.World0.xyz, input.Normal), dot(input.World1.xyz, input.Normal), dot(input.World2.xyz, input.Normal));
+	output.Color = float4(1, 1, 1, 1);
+	output.TexCoord = input.TexCoord;
+	return output;
+}
+
+PSInput VSMesh(VSMeshInput input)
+{
+	PSInput output;
+	output.Position = mul(mul(float4(input.Position.xyz, 1), World), ViewProjection);
+	output.Normal = mul(input.Normal, (float3x3)World);
+	output.Color = input.Color;
+	output.TexCoord = input.TexCoord;
+	return output;
+}
+
+float4 PSMain(PSInput input) : SV_Target
+{
+	float diffuse = saturate(dot(normalize(input.Normal), -LightDirection.xyz));
+	return Diffuse.Sample(Sampler, input.TexCoord) * input.Color * (0.35 + 0.65 * diffuse);
+}
+)";
+
+	struct FrameConstants
+	{
+		XMFLOAT4X4 viewProjection;
+		XMFLOAT4 lightDirection;
+		XMFLOAT4X4 world;
+	};
+
+	const D3D12_INPUT_ELEMENT_DESC MESH_VERTEX_LAYOUT[] =
+	{
+		{ "SV_Position", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+		{ "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+		{ "COLOR", 0, DXGI_FORMAT_R8G8B8A8_UNORM, 0, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+		{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+	};
+	static_assert(sizeof(Gfx::MeshVertex) == 36, "MESH_VERTEX_LAYOUT must match Gfx::MeshVertex");
+
+	// Instanced pipelines are looked up by vertex declaration
+	const std::vector<D3D12_INPUT_ELEMENT_DESC> MESH_VERTEX_DECL(std::begin(MESH_VERTEX_LAYOUT), std::end(MESH_VERTEX_LAYOUT));
+
+	std::string LayoutKey(const std::vector<D3D12_INPUT_ELEMENT_DESC>& vertexLayout)
+	{
+		std::string key;
+		for (auto& element : vertexLayout)
+		{
+			key += element.SemanticName;
+			key += ':' + std::to_string(element.SemanticIndex) + ':' + std::to_string(element.Format) + ':' +
+				std::to_string(element.InputSlot) + ':' + std::to_string(element.AlignedByteOffset) + ':' +
+				std::to_string(element.InputSlotClass) + ';';
+		}
+		return key;
+	}
+
+	ComPtr<ID3DBlob> CompileShader(const char* entryPoint, const char* target)
+	{
+		ComPtr<ID3DBlob> code;
+		ComPtr<ID3DBlob> errors;
+		HRESULT hr = D3DCompile(INSTANCED_SHADER, sizeof(INSTANCED_SHADER) - 1, "InstancedModel", nullptr, nullptr,
+			entryPoint, target, D3DCOMPILE_OPTIMIZATION_LEVEL3, 0, code.GetAddressOf(), errors.GetAddressOf());
+		if (FAILED(hr))
+		{
+			if (errors)
+			{
+				OutputDebugStringA(static_cast<const char*>(errors->GetBufferPointer()));
+			}
+			throw DX::com_exception(hr);
+		}
+		return code;
+	}
+}
+
+D3D12RenderBackend::D3D12RenderBackend(ID3D12Device* device, const RenderTargetState& renderTarget) :
+	m_device(device),
+	m_renderTarget(renderTarget)
+{
+	m_vertexShader = CompileShader("VSMain", "vs_5_1");
+	m_meshVertexShader = CompileShader("VSMesh", "vs_5_1");
+	m_pixelShader = CompileShader("PSMain", "ps_5_1");
+
+	// b0: frame constants, t0: diffuse texture, s0: static linear wrap sampler
+	CD3DX12_DESCRIPTOR_RANGE textureRange(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0);
+	CD3DX12_ROOT_PARAMETER parameters[2];
+	parameters[0].InitAsConstantBufferView(0, 0, D3D12_SHADER_VISIBILITY_ALL);
+	parameters[1].InitAsDescriptorTable(1, &textureRange, D3D12_SHADER_VISIBILITY_PIXEL);
+
+	CD3DX12_STATIC_SAMPLER_DESC sampler(0, D3D12_FILTER_ANISOTROPIC);
+
+	CD3DX12_ROOT_SIGNATURE_DESC rootSignature(_countof(parameters), parameters, 1, &sampler,
+		D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
+	DX::ThrowIfFailed(CreateRootSignature(device, &rootSignature, m_rootSignature.ReleaseAndGetAddressOf()));
+}
+
+ID3D12PipelineState* D3D12RenderBackend::GetPipeline(const std::vector<D3D12_INPUT_ELEMENT_DESC>& vertexLayout)
+{
+	std::string key = LayoutKey(vertexLayout);
+	auto found = m_pipelines.find(key);
+	if (found != m_pipelines.end())
+	{
+		return found->second.Get();
+	}
+
+	// Mesh vertex stream in slot 0, instance transforms in slot 1
+	std::vector<D3D12_INPUT_ELEMENT_DESC> elements(vertexLayout);
+	for (UINT row = 0; row < 3; row++)
+	{
+		elements.push_back({ "InstMatrix", row, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, D3D12_APPEND_ALIGNED_ELEMENT,
+			D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, 1 });
+	}
+	D3D12_INPUT_LAYOUT_DESC inputLayout = { elements.data(), static_cast<UINT>(elements.size()) };
+
+	EffectPipelineStateDescription description(
+		&inputLayout,
+		CommonStates::Opaque,
+		CommonStates::DepthDefault,
+		CommonStates::CullClockwise,
+		m_renderTarget);
+
+	ComPtr<ID3D12PipelineState> pipeline;
+	description.CreatePipelineState(m_device, m_rootSignature.Get(),
+		{ m_vertexShader->GetBufferPointer(), m_vertexShader->GetBufferSize() },
+		{ m_pixelShader->GetBufferPointer(), m_pixelShader->GetBufferSize() },
+		pipeline.GetAddressOf());
+
+	m_pipelines[key] = pipeline;
+	return pipeline.Get();
+}
+
+uint32_t D3D12RenderBackend::AddModel(RegisteredModel&& registered)
+{
+	if (!m_freeModels.empty())
+	{
+		uint32_t id = m_freeModels.back();
+		m_freeModels.pop_back();
+		m_models[id] = std::move(registered);
+		return id;
+	}
+	m_models.push_back(std::move(registered));
+	return static_cast<uint32_t>(m_models.size() - 1);
+}
+
+uint32_t D3D12RenderBackend::RegisterModel(const Model& model, ID3D12DescriptorHeap* textures)
+{
+	RegisteredModel registered;
+	registered.heap = textures;
+
+	UINT increment = m_device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+	D3D12_GPU_DESCRIPTOR_HANDLE heapStart = registered.heap->GetGPUDescriptorHandleForHeapStart();
+
+	auto addParts = [&](const ModelMeshPart::Collection& parts)
+	{
+		for (auto& part : parts)
+		{
+			Part entry;
+			entry.part = part.get();
+			entry.mesh = 0;
+			entry.pipeline = GetPipeline(*part->vbDecl);
+
+			int textureIndex = (part->materialIndex < model.materials.size()) ?
+				model.materials[part->materialIndex].diffuseTextureIndex : -1;
+			entry.texture.ptr = heapStart.ptr + UINT64(std::max(textureIndex, 0)) * increment;
+			registered.parts.push_back(entry);
+		}
+	};
+
+	for (auto& mesh : model.meshes)
+	{
+		// Ballast and other track models are opaque; alpha parts are drawn the same way
+		addParts(mesh->opaqueMeshParts);
+		addParts(mesh->alphaMeshParts);
+	}
+
+	return AddModel(std::move(registered));
+}
+
+uint32_t D3D12RenderBackend::RegisterPrimitive(const GeometricPrimitive& primitive, BasicEffect& effect)
+{
+	RegisteredModel registered;
+	registered.primitive = &primitive;
+	registered.effect = &effect;
+
+	return AddModel(std::move(registered));
+}
+
+void D3D12RenderBackend::LoadWhiteTexture(ResourceUploadBatch& upload)
+{
+	CD3DX12_HEAP_PROPERTIES heapProperties(D3D12_HEAP_TYPE_DEFAULT);
+	auto description = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R8G8B8A8_UNORM, 1, 1, 1, 1);
+	DX::ThrowIfFailed(m_device->CreateCommittedResource(&heapProperties, D3D12_HEAP_FLAG_NONE, &description,
+		D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(m_whiteTexture.ReleaseAndGetAddressOf())));
+
+	const uint32_t white = 0xffffffff;
+	D3D12_SUBRESOURCE_DATA data = { &white, sizeof(white), sizeof(white) };
+	upload.Upload(m_whiteTexture.Get(), 0, &data, 1);
+	upload.Transition(m_whiteTexture.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+
+	m_whiteHeap = std::make_unique<DescriptorHeap>(m_device, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV,
+		D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE, 1);
+	CreateShaderResourceView(m_device, m_whiteTexture.Get(), m_whiteHeap->GetCpuHandle(0));
+}
+
+uint32_t D3D12RenderBackend::RegisterMeshModel(const Gfx::MeshData& mesh)
+{
+	Part entry;
+	entry.part = nullptr;
+	entry.mesh = CreateMesh(mesh);
+	entry.pipeline = GetPipeline(MESH_VERTEX_DECL);
+	entry.texture = m_whiteHeap->GetGpuHandle(0);
+
+	RegisteredModel registered;
+	registered.heap = m_whiteHeap->Heap();
+	registered.parts.push_back(entry);
+
+	return AddModel(std::move(registered));
+}
+
+std::vector<Gfx::MeshData> D3D12RenderBackend::ExtractMeshes(const Model& model)
+{
+	auto formatSize = [](DXGI_FORMAT format) -> UINT
+	{
+		switch (format)
+		{
+		case DXGI_FORMAT_R32G32B32A32_FLOAT: return 16;
+		case DXGI_FORMAT_R32G32B32_FLOAT: return 12;
+		case DXGI_FORMAT_R32G32_FLOAT:
+		case DXGI_FORMAT_R16G16B16A16_FLOAT: return 8;
+		case DXGI_FORMAT_R8G8B8A8_UNORM:
+		case DXGI_FORMAT_B8G8R8A8_UNORM:
+		case DXGI_FORMAT_R8G8B8A8_SNORM:
+		case DXGI_FORMAT_R10G10B10A2_UNORM:
+		case DXGI_FORMAT_R11G11B10_FLOAT:
+		case DXGI_FORMAT_R16G16_FLOAT: return 4;
+		default: throw std::runtime_error("ExtractMeshes: unsupported vertex format");
+		}
+	};
+
+	std::vector<Gfx::MeshData> meshes;
+	auto addParts = [&](const ModelMeshPart::Collection& parts)
+	{
+		for (auto& part : parts)
+		{
+			if (!part->vertexBuffer.Memory() || !part->indexBuffer.Memory() || part->primitiveType != D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST)
+			{
+				throw std::runtime_error("ExtractMeshes: part without CPU buffers or not a triangle list");
+			}
+
+			// Attribute offsets; the SDKMESH loader appends them in order
+			int position = -1, normal = -1, texcoord = -1;
+			UINT offset = 0;
+			for (auto& element : *part->vbDecl)
+			{
+				if (element.InputSlot != 0)
+				{
+					continue;
+				}
+				if (element.AlignedByteOffset != D3D12_APPEND_ALIGNED_ELEMENT)
+				{
+					offset = element.AlignedByteOffset;
+				}
+				if (!strcmp(element.SemanticName, "SV_Position") && element.Format == DXGI_FORMAT_R32G32B32_FLOAT)
+					position = int(offset);
+				else if (!strcmp(element.SemanticName, "NORMAL") && element.Format == DXGI_FORMAT_R32G32B32_FLOAT)
+					normal = int(offset);
+				else if (!strcmp(element.SemanticName, "TEXCOORD") && element.SemanticIndex == 0 && element.Format == DXGI_FORMAT_R32G32_FLOAT)
+					texcoord = int(offset);
+				offset += formatSize(element.Format);
+			}
+			if (position < 0)
+			{
+				throw std::runtime_error("ExtractMeshes: part without float3 position");
+			}
+
+			// Indices of the part, then the vertex range they use
+			Gfx::MeshData mesh;
+			mesh.indices.resize(part->indexCount);
+			auto indexData = static_cast<const uint8_t*>(part->indexBuffer.Memory());
+			for (uint32_t i = 0; i < part->indexCount; i++)
+			{
+				mesh.indices[i] = part->indexFormat == DXGI_FORMAT_R16_UINT ?
+					reinterpret_cast<const uint16_t*>(indexData)[part->startIndex + i] :
+					reinterpret_cast<const uint32_t*>(indexData)[part->startIndex + i];
+			}
+			if (mesh.indices.empty())
+			{
+				meshes.push_back(std::move(mesh));
+				continue;
+			}
+			uint32_t first = *std::min_element(mesh.indices.begin(), mesh.indices.end());
+			uint32_t last = *std::max_element(mesh.indices.begin(), mesh.indices.end());
+			for (auto& index : mesh.indices)
+			{
+				index -= first;
+			}
+
+			auto vertexData = static_cast<const uint8_t*>(part->vertexBuffer.Memory());
+			for (uint32_t v = first; v <= last; v++)
+			{
+				const uint8_t* vertex = vertexData + size_t(part->vertexOffset + v) * part->vertexStride;
+				Gfx::MeshVertex out = {};
+				memcpy(&out.position, vertex + position, sizeof(out.position));
+				if (normal >= 0)
+					memcpy(&out.normal, vertex + normal, sizeof(out.normal));
+				if (texcoord >= 0)
+					memcpy(&out.u, vertex + texcoord, sizeof(float) * 2);
+				out.color = 0xffffffff;
+				mesh.vertices.push_back(out);
+			}
+			meshes.push_back(std::move(mesh));
+		}
+	};
+
+	for (auto& mesh : model.meshes)
+	{
+		addParts(mesh->opaqueMeshParts);
+		addParts(mesh->alphaMeshParts);
+	}
+	return meshes;
+}
+
+void D3D12RenderBackend::ReleaseModel(uint32_t model)
+{
+	if (model >= m_models.size() || (m_models[model].parts.empty() && !m_models[model].primitive))
+	{
+		return;
+	}
+	for (auto& part : m_models[model].parts)
+	{
+		if (!part.part)
+		{
+			ReleaseMesh(part.mesh);
+		}
+	}
+	m_models[model] = RegisteredModel();
+	m_freeModels.push_back(model);
+}
+
+void D3D12RenderBackend::ClearModels()
+{
+	for (auto& model : m_models)
+	{
+		for (auto& part : model.parts)
+		{
+			if (!part.part)
+			{
+				ReleaseMesh(part.mesh);
+			}
+		}
+	}
+	m_models.clear();
+	m_freeModels.clear();
+	m_pipelines.clear();
+	m_meshPipeline.Reset();
+	m_pipeline = nullptr;
+}
+
+void D3D12RenderBackend::BeginFrame()
+{
+	m_resources = nullptr;
+	m_samplers = nullptr;
+	m_pipeline = nullptr;
+	m_instancedStateBound = false;
+}
+
+void D3D12RenderBackend::BindHeaps(Heap resources, Heap samplers)
+{
+	if (resources == m_resources && samplers == m_samplers)
+	{
+		return;
+	}
+	m_resources = resources;
+	m_samplers = samplers;
+
+	ID3D12DescriptorHeap* heaps[2];
+	UINT count = 0;
+	for (Heap heap : { resources, samplers })
+	{
+		if (heap)
+		{
+			heaps[count++] = const_cast<ID3D12DescriptorHeap*>(static_cast<const ID3D12DescriptorHeap*>(heap));
+		}
+	}
+	m_commandList->SetDescriptorHeaps(count, heaps);
+}
+
+void D3D12RenderBackend::SetMatrices(const Gfx::Float4x4& world, const Gfx::Float4x4& view, const Gfx::Float4x4& projection)
+{
+	static_assert(sizeof(Gfx::Float4x4) == sizeof(XMFLOAT4X4), "Gfx::Float4x4 must match XMFLOAT4X4");
+
+	m_world = reinterpret_cast<const XMFLOAT4X4&>(world);
+	m_view = reinterpret_cast<const XMFLOAT4X4&>(view);
+	m_projection = reinterpret_cast<const XMFLOAT4X4&>(projection);
+	m_constantsDirty = true;
+}
+
+void D3D12RenderBackend::Draw(uint32_t model)
+{
+	if (model >= m_models.size() || !m_models[model].primitive)
+	{
+		return;
+	}
+
+	// The effect sets its own root signature and pipeline
+	auto& registered = m_models[model];
+	registered.effect->SetMatrices(XMLoadFloat4x4(&m_world), XMLoadFloat4x4(&m_view), XMLoadFloat4x4(&m_projection));
+	registered.effect->Apply(m_commandList);
+	registered.primitive->Draw(m_commandList);
+	m_pipeline = nullptr;
+	m_instancedStateBound = false;
+}
+
+void D3D12RenderBackend::UploadInstances(const Gfx::InstanceTransform* instances, size_t count)
+{
+	size_t bytes = count * sizeof(Gfx::InstanceTransform);
+	if (bytes == 0)
+	{
+		m_instances.Reset();
+		m_instanceView = {};
+		m_instancedStateBound = false;
+		return;
+	}
+
+	m_instances = GraphicsMemory::Get(m_device).Allocate(bytes, 16);
+	memcpy(m_instances.Memory(), instances, bytes);
+
+	m_instanceView.BufferLocation = m_instances.GpuAddress();
+	m_instanceView.SizeInBytes = static_cast<UINT>(bytes);
+	m_instanceView.StrideInBytes = sizeof(Gfx::InstanceTransform);
+	m_instancedStateBound = false;
+}
+
+void D3D12RenderBackend::UpdateConstants()
+{
+	XMMATRIX viewProjection = XMMatrixMultiply(XMLoadFloat4x4(&m_view), XMLoadFloat4x4(&m_projection));
+
+	// HLSL reads the matrices column major
+	auto constants = GraphicsMemory::Get(m_device).AllocateConstant<FrameConstants>();
+	auto data = static_cast<FrameConstants*>(constants.Memory());
+	XMStoreFloat4x4(&data->viewProjection, XMMatrixTranspose(viewProjection));
+	XMStoreFloat4(&data->lightDirection, XMVector3Normalize(XMVectorSet(-0.5f, -1.f, 0.3f, 0.f)));
+	XMStoreFloat4x4(&data->world, XMMatrixTranspose(XMLoadFloat4x4(&m_world)));
+	m_frameConstants = constants.GpuAddress();
+	m_constantsDirty = false;
+	m_instancedStateBound = false;
+}
+
+void D3D12RenderBackend::DrawInstanced(uint32_t model, uint32_t firstInstance, uint32_t count)
+{
+	if (model >= m_models.size() || count == 0 || m_instanceView.SizeInBytes == 0)
+	{
+		return;
+	}
+
+	if (m_constantsDirty)
+	{
+		UpdateConstants();
+	}
+
+	auto& registered = m_models[model];
+	if (registered.parts.empty())
+	{
+		return;
+	}
+	BindHeaps(registered.heap, nullptr);
+	if (!m_instancedStateBound)
+	{
+		m_commandList->SetGraphicsRootSignature(m_rootSignature.Get());
+		m_commandList->SetGraphicsRootConstantBufferView(0, m_frameConstants);
+		m_commandList->IASetVertexBuffers(1, 1, &m_instanceView);
+		m_instancedStateBound = true;
+	}
+
+	for (auto& part : registered.parts)
+	{
+		if (part.pipeline != m_pipeline)
+		{
+			m_commandList->SetPipelineState(part.pipeline);
+			m_pipeline = part.pipeline;
+		}
+		m_commandList->SetGraphicsRootDescriptorTable(1, part.texture);
+		if (part.part)
+		{
+			part.part->DrawInstanced(m_commandList, count, firstInstance);
+			continue;
+		}
+
+		auto& mesh = m_meshes[part.mesh];
+		m_commandList->IASetVertexBuffers(0, 1, &mesh.vertexView);
+		m_commandList->IASetIndexBuffer(&mesh.indexView);
+		m_commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+		m_commandList->DrawIndexedInstanced(mesh.indexCount, count, 0, 0, firstInstance);
+	}
+}
+
+uint32_t D3D12RenderBackend::CreateMesh(const Gfx::MeshData& mesh)
+{
+	// Upload heap memory held until ReleaseMesh, like the instance buffer
+	Mesh entry;
+	size_t vertexBytes = mesh.vertices.size() * sizeof(Gfx::MeshVertex);
+	size_t indexBytes = mesh.indices.size() * sizeof(uint32_t);
+	entry.vertices = GraphicsMemory::Get(m_device).Allocate(std::max<size_t>(vertexBytes, 1), 16);
+	entry.indices = GraphicsMemory::Get(m_device).Allocate(std::max<size_t>(indexBytes, 1), 16);
+	memcpy(entry.vertices.Memory(), mesh.vertices.data(), vertexBytes);
+	memcpy(entry.indices.Memory(), mesh.indices.data(), indexBytes);
+
+	entry.vertexView.BufferLocation = entry.vertices.GpuAddress();
+	entry.vertexView.SizeInBytes = static_cast<UINT>(vertexBytes);
+	entry.vertexView.StrideInBytes = sizeof(Gfx::MeshVertex);
+	entry.indexView.BufferLocation = entry.indices.GpuAddress();
+	entry.indexView.SizeInBytes = static_cast<UINT>(indexBytes);
+	entry.indexView.Format = DXGI_FORMAT_R32_UINT;
+	entry.indexCount = static_cast<UINT>(mesh.indices.size());
+	entry.inUse = true;
+
+	uint32_t id;
+	if (!m_freeMeshes.empty())
+	{
+		id = m_freeMeshes.back();
+		m_freeMeshes.pop_back();
+		m_meshes[id] = std::move(entry);
+	}
+	else
+	{
+		id = static_cast<uint32_t>(m_meshes.size());
+		m_meshes.push_back(std::move(entry));
+	}
+	return id;
+}
+
+void D3D12RenderBackend::ReleaseMesh(uint32_t mesh)
+{
+	if (mesh >= m_meshes.size() || !m_meshes[mesh].inUse)
+	{
+		return;
+	}
+
+	// GraphicsMemory keeps the memory until the GPU is done with the frame
+	m_meshes[mesh] = Mesh();
+	m_freeMeshes.push_back(mesh);
+}
+
+void D3D12RenderBackend::DrawMesh(uint32_t mesh, uint32_t model, uint32_t part)
+{
+	if (mesh >= m_meshes.size() || !m_meshes[mesh].inUse || model >= m_models.size() || part >= m_models[model].parts.size())
+	{
+		return;
+	}
+
+	const auto& entry = m_meshes[mesh];
+	if (entry.indexCount == 0)
+	{
+		return;
+	}
+
+	if (!m_meshPipeline)
+	{
+		D3D12_INPUT_LAYOUT_DESC inputLayout = { MESH_VERTEX_LAYOUT, _countof(MESH_VERTEX_LAYOUT) };
+		EffectPipelineStateDescription description(
+			&inputLayout,
+			CommonStates::Opaque,
+			CommonStates::DepthDefault,
+			CommonStates::CullNone,
+			m_renderTarget);
+		description.CreatePipelineState(m_device, m_rootSignature.Get(),
+			{ m_meshVertexShader->GetBufferPointer(), m_meshVertexShader->GetBufferSize() },
+			{ m_pixelShader->GetBufferPointer(), m_pixelShader->GetBufferSize() },
+			m_meshPipeline.ReleaseAndGetAddressOf());
+	}
+
+	// Every mesh has its own world matrix
+	UpdateConstants();
+
+	auto& registered = m_models[model];
+	BindHeaps(registered.heap, nullptr);
+	m_commandList->SetGraphicsRootSignature(m_rootSignature.Get());
+	m_commandList->SetGraphicsRootConstantBufferView(0, m_frameConstants);
+	if (m_pipeline != m_meshPipeline.Get())
+	{
+		m_commandList->SetPipelineState(m_meshPipeline.Get());
+		m_pipeline = m_meshPipeline.Get();
+	}
+	m_commandList->SetGraphicsRootDescriptorTable(1, registered.parts[part].texture);
+	m_commandList->IASetVertexBuffers(0, 1, &entry.vertexView);
+	m_commandList->IASetIndexBuffer(&entry.indexView);
+	m_commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	m_commandList->DrawIndexedInstanced(entry.indexCount, 1, 0, 0, 0);
+}
\ No newline at end of file
@@ -0,0 +1,126 @@
+//
+// D3D12RenderBackend.h - Gfx::RenderBackend on Direct3D 12 / DirectX Tool Kit
+//
+
+#pragma once
+
+#include <map>
+#include <vector>
+
+#include "Gfx/RenderBackend.h"
+
+class D3D12RenderBackend : public Gfx::RenderBackend
+{
+public:
+	D3D12RenderBackend(ID3D12Device* device, const DirectX::RenderTargetState& renderTarget);
+
+	// Creates the instanced pipelines for the parts of a model, drawn with
+	// DrawInstanced. The material texture indices of the model are slots in
+	// the textures heap.
+	uint32_t RegisterModel(const DirectX::Model& model, ID3D12DescriptorHeap* textures);
+
+	// The parts of a model as plain meshes, in the order RegisterModel takes
+	// them (for static batching). Needs the model loaded with
+	// LoadStaticBuffers(..., keepMemory = true); throws if a part has no
+	// float3 position or is not a triangle list.
+	static std::vector<Gfx::MeshData> ExtractMeshes(const DirectX::Model& model);
+
+	// A primitive drawn with its own effect by Draw. Both must outlive the
+	// registration (until ClearModels).
+	uint32_t RegisterPrimitive(const DirectX::GeometricPrimitive& primitive, DirectX::BasicEffect& effect);
+
+	// A model of one CPU mesh with a plain white texture, drawn like a model
+	// part by DrawInstanced and DrawMesh: the placeholder for models still
+	// loading. The texture is recorded into upload by LoadWhiteTexture,
+	// once before the first mesh model.
+	void LoadWhiteTexture(DirectX::ResourceUploadBatch& upload);
+	uint32_t RegisterMeshModel(const Gfx::MeshData& mesh);
+
+	// Ids of released models are handed out again. The model itself may go
+	// once the GPU is done with the frames that drew it.
+	void ReleaseModel(uint32_t model);
+	void ClearModels();
+
+	// Command list of the frame being recorded
+	void SetCommandList(ID3D12GraphicsCommandList* commandList) { m_commandList = commandList; }
+
+	void BeginFrame() override;
+	void BindHeaps(Heap resources, Heap samplers) override;
+	void SetMatrices(const Gfx::Float4x4& world, const Gfx::Float4x4& view, const Gfx::Float4x4& projection) override;
+	void Draw(uint32_t model) override;
+	void UploadInstances(const Gfx::InstanceTransform* instances, size_t count) override;
+	void DrawInstanced(uint32_t model, uint32_t firstInstance, uint32_t count) override;
+	uint32_t CreateMesh(const Gfx::MeshData& mesh) override;
+	void ReleaseMesh(uint32_t mesh) override;
+	void DrawMesh(uint32_t mesh, uint32_t model, uint32_t part) override;
+
+private:
+	struct Part
+	{
+		const DirectX::ModelMeshPart* part;     // null for a mesh model
+		uint32_t mesh;                          // backend mesh of a mesh model
+		ID3D12PipelineState* pipeline;
+		D3D12_GPU_DESCRIPTOR_HANDLE texture;
+	};
+
+	struct RegisteredModel
+	{
+		ID3D12DescriptorHeap* heap = nullptr;
+		std::vector<Part> parts;
+
+		// Primitive models instead of parts
+		const DirectX::GeometricPrimitive* primitive = nullptr;
+		DirectX::BasicEffect* effect = nullptr;
+	};
+
+	struct Mesh
+	{
+		DirectX::GraphicsResource vertices;
+		DirectX::GraphicsResource indices;
+		D3D12_VERTEX_BUFFER_VIEW vertexView = {};
+		D3D12_INDEX_BUFFER_VIEW indexView = {};
+		UINT indexCount = 0;
+		bool inUse = false;         // a released slot waits in m_freeMeshes
+	};
+
+	ID3D12PipelineState* GetPipeline(const std::vector<D3D12_INPUT_ELEMENT_DESC>& vertexLayout);
+	uint32_t AddModel(RegisteredModel&& registered);
+	void UpdateConstants();
+
+	ID3D12Device* m_device;
+	ID3D12GraphicsCommandList* m_commandList = nullptr;
+	DirectX::RenderTargetState m_renderTarget;
+
+	Microsoft::WRL::ComPtr<ID3D12RootSignature> m_rootSignature;
+	Microsoft::WRL::ComPtr<ID3DBlob> m_vertexShader;
+	Microsoft::WRL::ComPtr<ID3DBlob> m_meshVertexShader;
+	Microsoft::WRL::ComPtr<ID3DBlob> m_pixelShader;
+	Microsoft::WRL::ComPtr<ID3D12PipelineState> m_meshPipeline;
+	// By vertex layout, so models with the same layout share a pipeline
+	std::map<std::string, Microsoft::WRL::ComPtr<ID3D12PipelineState>> m_pipelines;
+
+	std::vector<RegisteredModel> m_models;
+	std::vector<uint32_t> m_freeModels;
+
+	// White texture of the mesh models
+	std::unique_ptr<DirectX::DescriptorHeap> m_whiteHeap;
+	Microsoft::WRL::ComPtr<ID3D12Resource> m_whiteTexture;
+	std::vector<Mesh> m_meshes;
+	std::vector<uint32_t> m_freeMeshes;
+
+	// Kept until the next upload; GraphicsMemory frees it once the GPU is done
+	DirectX::GraphicsResource m_instances;
+	D3D12_VERTEX_BUFFER_VIEW m_instanceView = {};
+	D3D12_GPU_VIRTUAL_ADDRESS m_frameConstants = 0;
+
+	DirectX::XMFLOAT4X4 m_world;
+	DirectX::XMFLOAT4X4 m_view;
+	DirectX::XMFLOAT4X4 m_projection;
+	bool m_constantsDirty = true;
+
+	// State last set on the command list, to skip redundant changes
+	Heap m_resources = nullptr;
+	Heap m_samplers = nullptr;
+	ID3D12PipelineState* m_pipeline = nullptr;
+	bool m_instancedStateBound = false;
+};
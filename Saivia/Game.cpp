@@ -5,6 +5,9 @@
 #include "pch.h"
 #include "Game.h"
 
+#include "Bve/RouteAlignment.h"
+#include "Gfx/SdkMesh.h"
+
 extern void ExitGame();
 
 using namespace DirectX;
@@ -17,6 +20,10 @@ namespace
 	const XMVECTORF32 START_POSITION = { 0.f, 1.f, -4.f, 0.f };
 	const float ROTATION_GAIN = 0.004f;
 	const float MOVEMENT_GAIN = 0.07f;
+
+	const double LOCK_SPEED = 0.5;        // meters per tick along the track
+	const double REBASE_DISTANCE = 500.0; // camera distance from the render origin before instances are repacked
+	const double LOCK_EYE_HEIGHT = 2.5;   // above the rail frame, along N
 }
 
 static HWND hWnd;
@@ -45,6 +52,50 @@ static int avgCpp(lua_State *L)
 	return 2;
 }
 
+static Track::Vec3 StartPosition()
+{
+	return { START_POSITION.f[0], START_POSITION.f[1], START_POSITION.f[2] };
+}
+
+// Sleeper-sized box in the instance frame (x across, y up, z along the
+// track), drawn while the sleeper model loads. Both windings, so it shows
+// whichever faces the pipeline culls.
+static Gfx::MeshData PlaceholderSleeper()
+{
+	const float HALF[3] = { 1.3f, 0.1f, 0.15f };
+	const float CENTRE_Y = 0.1f;
+
+	Gfx::MeshData mesh;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		for (float side : { -1.f, 1.f })
+		{
+			int u = (axis + 1) % 3, v = (axis + 2) % 3;
+			uint32_t base = static_cast<uint32_t>(mesh.vertices.size());
+			for (int corner = 0; corner < 4; corner++)
+			{
+				float p[3], n[3] = { 0.f, 0.f, 0.f };
+				p[axis] = side * HALF[axis];
+				p[u] = (corner & 1 ? 1.f : -1.f) * HALF[u];
+				p[v] = (corner & 2 ? 1.f : -1.f) * HALF[v];
+				n[axis] = side;
+
+				Gfx::MeshVertex vertex;
+				vertex.position = { p[0], p[1] + CENTRE_Y, p[2] };
+				vertex.normal = { n[0], n[1], n[2] };
+				vertex.color = 0xff808080;
+				vertex.u = corner & 1 ? 1.f : 0.f;
+				vertex.v = corner & 2 ? 1.f : 0.f;
+				mesh.vertices.push_back(vertex);
+			}
+			mesh.indices.insert(mesh.indices.end(), {
+				base, base + 1, base + 2, base + 2, base + 1, base + 3,
+				base, base + 2, base + 1, base + 1, base + 2, base + 3 });
+		}
+	}
+	return mesh;
+}
+
 Game::Game() noexcept(false) :
 	m_pitch(0),
 	m_yaw(0)
@@ -52,18 +103,7 @@ Game::Game() noexcept(false) :
 	m_deviceResources = std::make_unique<DX::DeviceResources>();
 	m_deviceResources->RegisterDeviceNotify(this);
 
-	m_cameraPos = START_POSITION.v;
-
-	currentPos = { 0.f, 0.f, 0.f };
-	currentT = { 0.f, 0.f, 1.f };
-	currentB = { 1.f, 0.f, 0.f };
-	currentN = { 0.f, 1.f, 0.f };
-
-	// Identity
-	// 1 0 0 0
-	// 0 1 0 0 
-	// 0 0 1 0
-	// => B N T
+	m_cameraPos = StartPosition();
 }
 
 Game::~Game()
@@ -103,30 +143,11 @@ void Game::Initialize(HWND window, int width, int height)
 		m_deviceResources->GetImGuiSRV()->GetGPUDescriptorHandleForHeapStart());
 	ImGui::StyleColorsLight();
 
-	// GraphicsMemory(for Model)
-	m_graphicsMemory = std::make_unique<GraphicsMemory>(m_deviceResources->GetD3DDevice());
-	
 	// Controller
 	m_keyboard = std::make_unique<Keyboard>();
 	m_mouse = std::make_unique<Mouse>();
 	m_mouse->SetWindow(window);
 
-
-	// ref position geometirc
-	RenderTargetState rtState(DXGI_FORMAT_R8G8B8A8_UNORM, DXGI_FORMAT_D32_FLOAT);
-
-	EffectPipelineStateDescription pd(
-		&GeometricPrimitive::VertexType::InputLayout,
-		CommonStates::Opaque,
-		CommonStates::DepthDefault,
-		CommonStates::CullNone,
-		rtState);
-
-	m_effect = std::make_unique<BasicEffect>(m_deviceResources->GetD3DDevice(), EffectFlags::Lighting, pd);
-	m_effect->EnableDefaultLighting();
-
-	m_shape = GeometricPrimitive::CreateCube(0.5f);	
-
 	// Test Lua Her
 	lua_State* ls; //luaA
 	ls = luaL_newstate();
@@ -188,33 +209,40 @@ void Game::Update(DX::StepTimer const& timer)
 
 	if (kb.Home)
 	{
-		m_cameraPos = START_POSITION.v;
+		m_cameraPos = StartPosition();
 		m_pitch = m_yaw = 0;
 	}
 
-	if (kb.F5)
-	{
-		// Reload Scene
+	// Models that finished loading replace their placeholders
+	m_assetLoader->Update(m_timer.GetFrameCount());
 
+	if (m_loadScene)
+	{
+		m_loadScene = false;
 		m_deviceResources->WaitForGpu();
-		// ModelList Reset!!
-		RailwayDataList.clear();
-		RailwayPosList.clear();
-		jsonEngine.clear();
-
-		currentPos = { 0.f, 0.f, 0.f };
-		currentT = { 0.f, 0.f, 1.f };
-		currentB = { 1.f, 0.f, 0.f };
-		currentN = { 0.f, 1.f, 0.f };
-
-		std::ifstream jsonData("Assets\\World.json");
-		jsonData >> jsonEngine;
 		SceneParser();
 	}
 
-	if (kb.L)
+	if (kb.F5)
+	{
+		// Reload Scene
+		if (!m_sceneLoaded)
+		{
+			m_deviceResources->WaitForGpu();
+			SceneParser();
+		}
+		else
+		{
+			// Only the edited part of the railways is regenerated
+			ReloadRailway();
+		}
+	}
+
+	if (kb.L && !isCameraLock && !m_trackGraph.Edges().empty())
 	{
 		isCameraLock = true;
+		m_lockCursor = Track::Alignment::Cursor(m_trackGraph.Alignments()[m_trackGraph.Edges()[m_lockEdge].railway]);
+		m_lockHeading = m_yaw;
 	}
 
 	if (kb.F)
@@ -223,11 +251,12 @@ void Game::Update(DX::StepTimer const& timer)
 	}
 
 	Vector3 move = Vector3::Zero;
+	double alongTrack = 0.0;
 
 	if (kb.Up || kb.W) {
 		if (isCameraLock)
 		{
-
+			alongTrack += LOCK_SPEED;
 		}
 		else
 		{
@@ -238,7 +267,7 @@ void Game::Update(DX::StepTimer const& timer)
 	if (kb.Down || kb.S) {
 		if (isCameraLock)
 		{
-
+			alongTrack -= LOCK_SPEED;
 		}
 		else
 		{
@@ -264,7 +293,14 @@ void Game::Update(DX::StepTimer const& timer)
 
 	move *= MOVEMENT_GAIN;
 
-	m_cameraPos += move;
+	if (isCameraLock)
+	{
+		MoveCameraAlongTrack(alongTrack);
+	}
+	else
+	{
+		m_cameraPos += Track::Vec3{ move.x, move.y, move.z };
+	}
 
 	auto mouse = m_mouse->GetState();
 	if (mouse.positionMode == Mouse::MODE_RELATIVE)
@@ -323,36 +359,40 @@ void Game::Render()
 	float z = r * cosf(m_yaw);
 	float x = r * sinf(m_yaw);
 
-	Vector3 lookAt = m_cameraPos + Vector3(x, y, z);
+	Track::Vec3 lookAt = m_cameraPos + Track::Vec3{ x, y, z };
+
+	// Rendering is relative to a render origin that follows the camera in
+	// steps, see Gfx::TrackRenderer
+	m_trackRenderer.FollowCamera(m_cameraPos, REBASE_DISTANCE);
+	auto& origin = m_trackRenderer.Origin();
+	auto eyeOffset = m_cameraPos - origin;
+	Vector3 eye(float(eyeOffset.x), float(eyeOffset.y), float(eyeOffset.z));
+	m_view = XMMatrixLookAtRH(eye, eye + Vector3(x, y, z), Vector3::Up);
 
-	m_view = XMMatrixLookAtRH(m_cameraPos, lookAt, Vector3::Up);
+	auto& view = reinterpret_cast<const Gfx::Float4x4&>(m_view);
+	auto& proj = reinterpret_cast<const Gfx::Float4x4&>(m_proj);
+	m_renderBackend->SetCommandList(commandList);
+	m_renderBackend->BeginFrame();
 
 	/* Render Cube for ref position*/
-	auto cubeWorld = Matrix::Identity;
-	m_effect->SetMatrices(cubeWorld, m_view, m_proj);
-	m_effect->Apply(commandList);
-	m_shape->Draw(commandList);
+	Matrix cubeWorld = Matrix::CreateTranslation(float(-origin.x), float(-origin.y), float(-origin.z));
+	m_renderBackend->SetMatrices(reinterpret_cast<const Gfx::Float4x4&>(cubeWorld), view, proj);
+	m_renderBackend->Draw(m_cubeModel);
 
 	// Draw Model
-	if (m_model != nullptr)
+	if (m_sceneLoaded)
 	{
-		ID3D12DescriptorHeap* heaps[] = { m_modelResources->Heap(), m_states->Heap() };
-		commandList->SetDescriptorHeaps(_countof(heaps), heaps);
 		/*
 		m_world = Matrix(currentB, currentN, currentT);
 		m_world *= DirectX::SimpleMath::Matrix::CreateTranslation(
 			DirectX::SimpleMath::Vector3{ 0.f, 0.f, 0.f });
-		Model::UpdateEffectMatrices(m_modelNormal, m_world, m_view, m_proj);
-		m_model->Draw(commandList, m_modelNormal.cbegin());	
+		auto& asset = m_assetLoader->GetModel(m_model);
+		Model::UpdateEffectMatrices(asset.effects, m_world, m_view, m_proj);
+		asset.model->Draw(commandList, asset.effects.cbegin());	
 		*/
 		
-		for (auto Data_World : RailwayDataList)
-		{
-			m_world = Matrix::Identity;
-			Model::UpdateEffectMatrices(m_modelNormal, Data_World, m_view, m_proj);
-			m_model->Draw(commandList, m_modelNormal.cbegin());
-		}
-		
+		// Packed and uploaded only after an edit or a move of the render origin
+		m_trackRenderer.Render(*m_renderBackend, m_railwayInstances, m_rails, m_showCatenary ? &m_catenary : nullptr, view, proj);
 	}
 
 	// ImGui
@@ -364,16 +404,30 @@ void Game::Render()
 	ImGui::Text("FPS: %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
 	ImGui::Text("Camera Position: x: %.3f y: %.3f z: %.3f ", m_cameraPos.x, m_cameraPos.y, m_cameraPos.z);
 	ImGui::Text("Look At: x: %.3f y: %.3f z: %.3f ", lookAt.x, lookAt.y, lookAt.z);
+	bool staticBatching = m_trackRenderer.StaticBatching();
+	if (ImGui::Checkbox("Static batching", &staticBatching))
+	{
+		m_trackRenderer.SetStaticBatching(staticBatching);
+	}
+	ImGui::Checkbox("Catenary", &m_showCatenary);
+	ImGui::Text("Assets: %zu models, %zu textures", m_assetLoader->ModelCount(), m_assetLoader->TextureCount());
+	if (m_assetLoader->Pending() > 0)
+	{
+		ImGui::Text("Loading models: %zu", m_assetLoader->Pending());
+	}
 	ImGui::End();
 
 	if (RWItemUI) {
 		ImGui::Begin("Railway Items");
 		ImGui::BeginChild("Scrolling");
-		for (int n = 0; n < RailwayPosList.size(); n++) {			
-			ImGui::Text("Item %d : x: %.3f y: %.3f z: %.3f ", n+1,
-				RailwayPosList[n].x,
-				RailwayPosList[n].y,
-				RailwayPosList[n].z);
+		int n = 0;
+		for (uint32_t edge = 0; edge < m_trackGraph.Edges().size(); edge++) {
+			for (auto& chunk : m_railwayInstances.EdgeChunks(edge)) {
+				for (size_t f = 0; f < chunk.Count(); f++) {
+					auto pos = Gfx::SleeperChunks::Position(chunk, f);
+					ImGui::Text("Item %d : x: %.3f y: %.3f z: %.3f ", ++n, pos.x, pos.y, pos.z);
+				}
+			}
 		}
 		ImGui::EndChild();
 		ImGui::End();
@@ -399,6 +453,7 @@ void Game::Render()
 				// ModelUI = true; 
 				// Load Model Here!
 
+				std::wstring inputFile;
 				std::wstring outputFile;
 				std::wstring outputFile_path;
 
@@ -431,15 +486,7 @@ void Game::Render()
 									L".sdkmesh";
 
 								outputFile_path = std::wstring(file_path);
-
-								std::wstring cmd =
-									std::wstring(std::filesystem::current_path()) +
-									L"/tool/meshconvert " +
-									std::wstring(pszFilePath) +
-									L" -sdkmesh -nodds -y -flipv -o " +
-									outputFile;
-
-								_wsystem(cmd.c_str());
+								inputFile = pszFilePath;
 							}
 							psiResult->Release();
 						}
@@ -447,57 +494,11 @@ void Game::Render()
 				}
 				pfd->Release();
 				if (outputFile != L"") {
-					m_states = std::make_unique<CommonStates>(m_deviceResources->GetD3DDevice());
-
-					m_model = Model::CreateFromSDKMESH(outputFile.c_str());
-
-					ResourceUploadBatch resourceUpload(m_deviceResources->GetD3DDevice());
-
-					resourceUpload.Begin();
-
-					m_model->LoadStaticBuffers(m_deviceResources->GetD3DDevice(), resourceUpload);
-
-					if (!m_model->textureNames.empty())
-					{
-						for (auto &texName : m_model->textureNames)
-						{
-							texName = outputFile_path + texName;
-						}
-						// m_model->textureNames[0] = outputFile_path + m_model->textureNames[0];
-						m_modelResources = m_model->LoadTextures(m_deviceResources->GetD3DDevice(), resourceUpload);
-
-						m_fxFactory = std::make_unique<EffectFactory>(m_modelResources->Heap(), m_states->Heap());
-
-						auto uploadResourcesFinished = resourceUpload.End(m_deviceResources->GetCommandQueue());
-
-						uploadResourcesFinished.wait();
-
-						// RenderTargetState rtState(DXGI_FORMAT_B8G8R8A8_UNORM, DXGI_FORMAT_D32_FLOAT);
-						RenderTargetState rtState(DXGI_FORMAT_R8G8B8A8_UNORM, DXGI_FORMAT_D32_FLOAT);
-
-						EffectPipelineStateDescription pd(
-							nullptr,
-							CommonStates::Opaque,
-							CommonStates::DepthDefault,
-							CommonStates::CullClockwise,
-							rtState);
-
-						EffectPipelineStateDescription pdAlpha(
-							nullptr,
-							CommonStates::AlphaBlend,
-							CommonStates::DepthDefault,
-							CommonStates::CullClockwise,
-							rtState);
-
-						m_modelNormal = m_model->CreateEffects(*m_fxFactory, pd, pdAlpha);
-
-						m_world = Matrix::Identity;
-					}
-					else
-					{
-						m_model.reset();
-						MessageBox(hWnd, L"Model NO Texture!!", L"Error", NULL);
-					}
+					// Converted and loaded on a worker, the current model
+					// stays until the new one is ready
+					m_assetLoader->Load(outputFile, outputFile_path,
+						[this](AssetLoader::Handle model, const std::string& error) { SetSleeperModel(model, error); },
+						[inputFile, outputFile]() { Gfx::ConvertObjToSdkMesh(inputFile, outputFile); });
 				}
 			}
 			if (ImGui::MenuItem("Import")) {}
@@ -507,10 +508,8 @@ void Game::Render()
 		if (ImGui::BeginMenu("Scene")) 
 		{
 			if (ImGui::MenuItem("Load Scene")) { 
-				// ӦҼ{winrt/c++ hstring
-				std::ifstream jsonData("Assets\\World.json");				
-				jsonData >> jsonEngine;
-				SceneParser();
+				// Not while this frame's commands are being recorded
+				m_loadScene = true;
 			}
 			ImGui::EndMenu();
 		}
@@ -623,8 +622,51 @@ void Game::CreateDeviceDependentResources()
 {
 	auto device = m_deviceResources->GetD3DDevice();
 
-	// TODO: Initialize device dependent objects here (independent of window size).
-	device;
+	// GraphicsMemory(for Model)
+	m_graphicsMemory = std::make_unique<GraphicsMemory>(device);
+
+	// ref position geometirc
+	RenderTargetState rtState(DXGI_FORMAT_R8G8B8A8_UNORM, DXGI_FORMAT_D32_FLOAT);
+
+	EffectPipelineStateDescription pd(
+		&GeometricPrimitive::VertexType::InputLayout,
+		CommonStates::Opaque,
+		CommonStates::DepthDefault,
+		CommonStates::CullNone,
+		rtState);
+
+	m_effect = std::make_unique<BasicEffect>(device, EffectFlags::Lighting, pd);
+	m_effect->EnableDefaultLighting();
+
+	// Instanced track models
+	m_renderBackend = std::make_unique<D3D12RenderBackend>(device, rtState);
+
+	m_shape = GeometricPrimitive::CreateCube(0.5f);
+	m_cubeModel = m_renderBackend->RegisterPrimitive(*m_shape, *m_effect);
+
+	// Models load in the background and are shared (see AssetLoader.h)
+	m_states = std::make_unique<CommonStates>(device);
+	m_assetLoader = std::make_unique<AssetLoader>(device,
+		m_deviceResources->GetCommandQueue(), *m_states, rtState, *m_renderBackend);
+
+	// The track shows with the placeholder until the models are in. Its
+	// texture is a single white texel, uploaded before the first frame.
+	ResourceUploadBatch resourceUpload(device);
+	resourceUpload.Begin();
+	m_renderBackend->LoadWhiteTexture(resourceUpload);
+	resourceUpload.End(m_deviceResources->GetCommandQueue()).wait();
+
+	m_placeholder = PlaceholderSleeper();
+	float placeholderRadius = 0.f;
+	for (auto& vertex : m_placeholder.vertices)
+	{
+		auto& p = vertex.position;
+		placeholderRadius = std::max(placeholderRadius, Vector3(p.x, p.y, p.z).Length());
+	}
+	uint32_t placeholder = m_renderBackend->RegisterMeshModel(m_placeholder);
+	m_trackRenderer.SetSleeperModel(placeholder, placeholderRadius);
+	m_trackRenderer.SetSleeperMeshes({ m_placeholder });
+	m_trackRenderer.SetRailModel(placeholder);
 }
 
 // Allocate all memory resources that change on a window SizeChanged event.
@@ -641,14 +683,19 @@ void Game::CreateWindowSizeDependentResources()
 void Game::OnDeviceLost()
 {
 	// TODO: Add Direct3D resource cleanup here.
+	m_assetLoader.reset();
+	m_model = Gfx::NO_ASSET;
+	m_railModel = Gfx::NO_ASSET;
 	m_states.reset();
-	m_fxFactory.reset();
-	m_modelResources.reset();
-	m_model.reset();
-	m_modelNormal.clear();
 
 	m_shape.reset();
 	m_effect.reset();
+	if (m_renderBackend)
+	{
+		m_trackRenderer.ReleaseMeshes(*m_renderBackend);
+		m_trackRenderer.Invalidate();
+	}
+	m_renderBackend.reset();
 
 	m_graphicsMemory.reset();
 }
@@ -658,186 +705,208 @@ void Game::OnDeviceRestored()
 	CreateDeviceDependentResources();
 
 	CreateWindowSizeDependentResources();
+
+	// The track models went with the old device
+	if (m_sceneLoaded)
+	{
+		LoadTrackModels();
+	}
 }
 #pragma endregion
 
 void Game::SceneParser()
 {
-	auto railwayList = jsonEngine["Railway"];
-	auto mainRW_Data = railwayList[0]["Data"];
-	for (auto data : mainRW_Data)
+	// ӦҼ{winrt/c++ hstring
+	try
 	{
-		if (data["Command"] == "Straight")
-		{
-			int length = data["Parameter"][0];
+		m_trackWorld = Track::LoadWorldFile("Assets\\World.json");
+		Bve::LoadRoutes(m_trackWorld, "Assets");
+	}
+	catch (const std::exception& e)
+	{
+		MessageBoxA(hWnd, e.what(), "ERROR", NULL);
+		return;
+	}
 
-			/* sA */
-			Vector3 Pos;
-			Vector3 T;
-			Vector3 N;
-			Vector3 B;
+	m_trackGraph.Build(m_trackWorld, m_trackWorld.errors);
+	for (auto& error : m_trackWorld.errors)
+	{
+		MessageBoxA(hWnd, ("Railway data have invaild command!!\n" + error).c_str(), "ERROR", NULL);
+	}
 
-			for (int unit = 0; unit < length; unit++)
-			{
-				/* uۤuei쭼WݭnZ */
-				T = currentT;
-				T.Normalize();
-				Pos = currentPos + T;
-
-				T;
-				N = currentN;
-				B = -T.Cross(N);
-
-				/* m */
-				auto world = Matrix(B, N, T);
-				world *= Matrix::CreateTranslation(
-					Vector3{ Pos.x, Pos.y, Pos.z });
-
-				RailwayDataList.push_back(std::move(world));
-				auto tmpPos = Pos;
-				RailwayPosList.push_back(std::move(tmpPos));
-
-				/* ]A */
-				currentPos = Pos;
-				currentT = T;
-				currentN = N;
-				currentB = B;
-			}			
-		}
-		else if (data["Command"] == "Curve")
-		{
-			/* Ѽ */
-			std::string turn = data["Parameter"][0];       // k
-			int radius = data["Parameter"][1];       // vb|
-			int length = data["Parameter"][2];  // Z
-			float cant = static_cast<float>(data["Parameter"][3]);  // W
-			float scale = static_cast<float>(data["Parameter"][4]) / 100.f;  // eiZ use scale
-
-			/* sA */
-			Vector3 Pos = currentPos;
-			Vector3 T;
-			Vector3 N;
-			Vector3 B;
-			if (turn=="Right")
-			{
-				radius = -radius;
-			}
+	// Every railway, branches start from the switch frame of their parent
+	m_trackGraph.Generate();
+	ResetCameraLock();
 
-			// QΥb|줤I
-			// Iy = BWb|R + ثey
-			currentB.Normalize();
-			auto centerPos = (currentB * radius) + currentPos;
+	// ModelList Reset!!
+	m_railwayInstances.Rebuild(m_trackGraph);
+	m_rails.Rebuild(m_trackGraph, m_railwayInstances);
+	m_catenary.Rebuild(m_trackGraph, m_railwayInstances);
+	m_trackRenderer.Invalidate(m_railwayInstances);
 
-			// pn઺						
-			float angle = 1.f / radius;
+	LoadTrackModels();
+
+	m_sceneLoaded = true;
+	RWItemUI = true;
+}
 
-			auto curveStartPos = Pos;
+void Game::LoadTrackModels()
+{
+	// Models already loaded with the same contents are found again, only
+	// changed files are decoded and uploaded
+	m_assetLoader->Load(L"Assets/Ballast/ballast.sdkmesh", L"Assets/Ballast/",
+		[this](AssetLoader::Handle model, const std::string& error) { SetSleeperModel(model, error); });
+
+	// Only the texture of the rail model is used: the rails themselves
+	// are swept along the track (Gfx/RailSweep.h)
+	m_assetLoader->Load(L"Assets/Rail/rail.sdkmesh", L"Assets/Rail/",
+		[this](AssetLoader::Handle model, const std::string& error) { SetRailModel(model, error); });
+}
 
-			for (int unit = 0; unit < length; unit++)
-			{
-				T = currentT;
-				N = currentN;
-				B = - T.Cross(N);
-				
-				// pm
-				auto rotatePos = centerPos - curveStartPos;
-				auto posVector = Vector3::Transform(rotatePos, Matrix::CreateFromAxisAngle(currentN, angle * unit));
-				posVector.Normalize();
-				if (turn == "Right") {
-					Pos = centerPos + (posVector * radius);
-				}
-				else {
-					Pos = centerPos - (posVector * radius);
-				}
+void Game::ResetCameraLock()
+{
+	isCameraLock = false;
+	m_lockEdge = 0;
+	m_lockChainage = 0.0;
+	m_lockCursor = Track::Alignment::Cursor();
+}
 
-				// B V centerPos Vq
-				B = Pos - centerPos;
-				B.Normalize();
-
-				// ouVq
-				T = -N.Cross(B);
-				T.Normalize();
-
-				// ΤuVoW᪺kuVq
-				N = Vector3::Transform(N, Matrix::CreateFromAxisAngle(T, sin(cant)));
-				N.Normalize();
-
-				// ΪkuVqMuVqoTkVq
-				B = N.Cross(T);
-				B.Normalize();				
-				
-				if (turn == "Left") {
-					B = -B;
-					T = -T;
-				}				
-
-				// m
-				auto world = Matrix(-B, N, -T) * Matrix::Identity;
-				world *= Matrix::CreateTranslation(Vector3{ Pos.x, Pos.y, Pos.z });
-				
-				RailwayDataList.push_back(std::move(world));
-				auto tmpPos = Pos;
-				RailwayPosList.push_back(std::move(tmpPos));
-
-				/* ]A */
-				currentPos = Pos;
-				currentT = T;
-				// currentB = B;				
-			}			
-		}
-		else
+void Game::MoveCameraAlongTrack(double distance)
+{
+	using Track::TrackGraph;
+
+	auto& edges = m_trackGraph.Edges();
+	auto& alignments = m_trackGraph.Alignments();
+
+	// Cross switches (set straight) until the chainage lies on the current edge
+	m_lockChainage += distance;
+	for (;;)
+	{
+		auto& edge = edges[m_lockEdge];
+		bool forward = m_lockChainage > edge.s1;
+		if (!forward && m_lockChainage >= edge.s0)
 		{
-			MessageBox(hWnd, L"Railway data have invaild command!!", L"ERROR", NULL);
+			break;
 		}
-	}
 
-	m_states = std::make_unique<CommonStates>(m_deviceResources->GetD3DDevice());
-	m_model = Model::CreateFromSDKMESH(L"Assets/Ballast/ballast.sdkmesh");
-	ResourceUploadBatch resourceUpload(m_deviceResources->GetD3DDevice());
-	resourceUpload.Begin();
-	m_model->LoadStaticBuffers(m_deviceResources->GetD3DDevice(), resourceUpload);
+		uint32_t next = m_trackGraph.Next(m_lockEdge, forward ? TrackGraph::Forward : TrackGraph::Backward, false);
+		if (next == TrackGraph::NONE)
+		{
+			m_lockChainage = forward ? edge.s1 : edge.s0;
+			break;
+		}
 
-	if (!m_model->textureNames.empty())
-	{
-		for (auto &texName : m_model->textureNames)
+		auto& nextEdge = edges[next];
+		m_lockChainage = forward ? nextEdge.s0 + (m_lockChainage - edge.s1) : nextEdge.s1 - (edge.s0 - m_lockChainage);
+		if (nextEdge.railway != edge.railway)
 		{
-			texName = L"Assets/Ballast/" + texName;
+			m_lockCursor = Track::Alignment::Cursor(alignments[nextEdge.railway]);
 		}
-		// m_model->textureNames[0] = outputFile_path + m_model->textureNames[0];
-		m_modelResources = m_model->LoadTextures(m_deviceResources->GetD3DDevice(), resourceUpload);
+		m_lockEdge = next;
+	}
 
-		m_fxFactory = std::make_unique<EffectFactory>(m_modelResources->Heap(), m_states->Heap());
+	auto frame = m_lockCursor.FrameAt(m_lockChainage);
+	m_cameraPos = frame.Pos + frame.N * LOCK_EYE_HEIGHT;
 
-		auto uploadResourcesFinished = resourceUpload.End(m_deviceResources->GetCommandQueue());
+	// Turn the view with the track, mouse look stays relative to it
+	float heading = float(std::atan2(frame.T.x, frame.T.z));
+	m_yaw += heading - m_lockHeading;
+	m_lockHeading = heading;
+	if (m_yaw > XM_PI)
+	{
+		m_yaw -= XM_PI * 2.0f;
+	}
+	else if (m_yaw < -XM_PI)
+	{
+		m_yaw += XM_PI * 2.0f;
+	}
+}
 
-		uploadResourcesFinished.wait();
+void Game::ReloadRailway()
+{
+	Track::World world;
+	try
+	{
+		world = Track::LoadWorldFile("Assets\\World.json");
+		Bve::LoadRoutes(world, "Assets");
+	}
+	catch (const std::exception& e)
+	{
+		MessageBoxA(hWnd, e.what(), "ERROR", NULL);
+		return;
+	}
 
-		// RenderTargetState rtState(DXGI_FORMAT_B8G8R8A8_UNORM, DXGI_FORMAT_D32_FLOAT);
-		RenderTargetState rtState(DXGI_FORMAT_R8G8B8A8_UNORM, DXGI_FORMAT_D32_FLOAT);
+	m_trackGraph.Update(world, world.errors);
+	for (auto& error : world.errors)
+	{
+		MessageBoxA(hWnd, ("Railway data have invaild command!!\n" + error).c_str(), "ERROR", NULL);
+	}
+	m_trackWorld = std::move(world);
 
-		EffectPipelineStateDescription pd(
-			nullptr,
-			CommonStates::Opaque,
-			CommonStates::DepthDefault,
-			CommonStates::CullClockwise,
-			rtState);
+	// Update may have built the graph anew (a railway added, renamed or
+	// branched elsewhere), reallocating the alignments the cursor points
+	// into: the lock starts a new cursor on the edge it is now on
+	auto& edges = m_trackGraph.Edges();
+	if (edges.empty())
+	{
+		ResetCameraLock();
+	}
+	else
+	{
+		m_lockEdge = std::min(m_lockEdge, uint32_t(edges.size() - 1));
+		auto& edge = edges[m_lockEdge];
+		m_lockChainage = std::clamp(m_lockChainage, edge.s0, edge.s1);
+		m_lockCursor = Track::Alignment::Cursor(m_trackGraph.Alignments()[edge.railway]);
+	}
+	UpdateRailwayInstances();
+}
 
-		EffectPipelineStateDescription pdAlpha(
-			nullptr,
-			CommonStates::AlphaBlend,
-			CommonStates::DepthDefault,
-			CommonStates::CullClockwise,
-			rtState);
+void Game::UpdateRailwayInstances()
+{
+	// Only the chunks from the first changed sleeper on are rebuilt; Render
+	// repacks and uploads the instances once
+	m_railwayInstances.Update(m_trackGraph);
+	m_rails.Update(m_trackGraph, m_railwayInstances);
+	m_catenary.Update(m_trackGraph, m_railwayInstances);
+	m_trackRenderer.Invalidate(m_railwayInstances);
+}
+
+void Game::SetSleeperModel(AssetLoader::Handle model, const std::string& error)
+{
+	if (model == Gfx::NO_ASSET)
+	{
+		MessageBoxA(hWnd, error.c_str(), "Error", NULL);
+		return;
+	}
+	if (model == m_model)
+	{
+		// Reloaded unchanged: nothing to rebuild
+		m_assetLoader->Release(model);
+		return;
+	}
 
-		m_modelNormal = m_model->CreateEffects(*m_fxFactory, pd, pdAlpha);
+	auto& asset = m_assetLoader->GetModel(model);
+	m_trackRenderer.SetSleeperModel(asset.backendModel, asset.radius);
+	m_trackRenderer.SetSleeperMeshes(asset.meshes);
+	m_assetLoader->Release(m_model);
+	m_model = model;
+	m_world = Matrix::Identity;
+}
 
-		m_world = Matrix::Identity;
+void Game::SetRailModel(AssetLoader::Handle model, const std::string& error)
+{
+	if (model == Gfx::NO_ASSET)
+	{
+		MessageBoxA(hWnd, error.c_str(), "Error", NULL);
+		return;
 	}
-	else
+	if (model == m_railModel)
 	{
-		m_model.reset();
-		MessageBox(hWnd, L"Model NO Texture!!", L"Error", NULL);
+		m_assetLoader->Release(model);
+		return;
 	}
 
-	RWItemUI = true;
+	m_trackRenderer.SetRailModel(m_assetLoader->GetModel(model).backendModel);
+	m_assetLoader->Release(m_railModel);
+	m_railModel = model;
 }
\ No newline at end of file
@@ -7,6 +7,14 @@
 #include "DeviceResources.h"
 #include "StepTimer.h"
 
+#include "AssetLoader.h"
+#include "D3D12RenderBackend.h"
+#include "Gfx/Catenary.h"
+#include "Gfx/RailSweep.h"
+#include "Gfx/SleeperChunks.h"
+#include "Gfx/TrackRenderer.h"
+#include "Track/TrackGraph.h"
+
 
 // A basic game implementation that creates a D3D12 device and
 // provides a game loop.
@@ -50,6 +58,15 @@ private:
 
 	// Parser
 	void SceneParser();
+	void LoadTrackModels();
+	void ReloadRailway();
+	void UpdateRailwayInstances();
+	void SetSleeperModel(AssetLoader::Handle model, const std::string& error);
+	void SetRailModel(AssetLoader::Handle model, const std::string& error);
+
+	// Camera lock: move along the track graph by distance (meters)
+	void ResetCameraLock();
+	void MoveCameraAlongTrack(double distance);
 
     // Device resources.
     std::unique_ptr<DX::DeviceResources>    m_deviceResources;
@@ -66,16 +83,20 @@ private:
 	// DirectX::SimpleMath::Matrix m_proj;
 
 	std::unique_ptr<DirectX::CommonStates> m_states;
-	std::unique_ptr<DirectX::EffectFactory> m_fxFactory;
-	std::unique_ptr<DirectX::EffectTextureFactory> m_modelResources;
-	std::unique_ptr<DirectX::Model> m_model;
-	std::vector<std::shared_ptr<DirectX::IEffect>> m_modelNormal;
+	std::unique_ptr<AssetLoader> m_assetLoader;
+	AssetLoader::Handle m_model = Gfx::NO_ASSET;
+	AssetLoader::Handle m_railModel = Gfx::NO_ASSET;
+	// Drawn as the sleeper model until m_model has loaded
+	Gfx::MeshData m_placeholder;
+	bool m_sceneLoaded = false;
+	bool m_loadScene = false;   // Load Scene from the menu, done in the next Update
 
 	// ImGui
 	bool ModelUI = false;
 
-	// json
-	nlohmann::json jsonEngine;
+	// World.json
+	Track::World m_trackWorld;
+	Track::TrackGraph m_trackGraph;
 
 	// Controller
 	std::unique_ptr<DirectX::Keyboard> m_keyboard;
@@ -83,20 +104,24 @@ private:
 
 	// Camera
 	DirectX::SimpleMath::Matrix m_proj;
-	DirectX::SimpleMath::Vector3 m_cameraPos;
+	Track::Vec3 m_cameraPos;    // double precision, rendering is relative to it
 	float m_pitch;
 	float m_yaw;
 	bool isCameraLock = false; // Lock on Railway
+	uint32_t m_lockEdge = 0;
+	double m_lockChainage = 0.0;
+	float m_lockHeading = 0.f;
+	Track::Alignment::Cursor m_lockCursor;
 
 	// Railway
 
-	std::vector<DirectX::SimpleMath::Matrix> RailwayDataList;
-	std::vector<DirectX::SimpleMath::Vector3> RailwayPosList;
-
-	DirectX::SimpleMath::Vector3 currentPos;
-	DirectX::SimpleMath::Vector3 currentT;
-	DirectX::SimpleMath::Vector3 currentB;
-	DirectX::SimpleMath::Vector3 currentN;
+	Gfx::SleeperChunks m_railwayInstances;
+	Gfx::RailSweep m_rails;
+	Gfx::Catenary m_catenary;
+	bool m_showCatenary = true;
+	Gfx::TrackRenderer m_trackRenderer;
+	std::unique_ptr<D3D12RenderBackend> m_renderBackend;
+	uint32_t m_cubeModel = 0;
 
 	bool RWItemUI = false;
 
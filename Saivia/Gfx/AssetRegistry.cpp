@@ -0,0 +1,35 @@
+//
+// AssetRegistry.cpp
+//
+
+#include "AssetRegistry.h"
+
+namespace Gfx
+{
+	uint64_t ContentHash(const void* data, size_t size)
+	{
+		auto bytes = static_cast<const uint8_t*>(data);
+		uint64_t hash = 0xcbf29ce484222325ull;
+		for (size_t n = 0; n < size; n++)
+		{
+			hash = (hash ^ bytes[n]) * 0x100000001b3ull;
+		}
+		return hash;
+	}
+
+	std::wstring NormalizeAssetPath(std::wstring path)
+	{
+		for (auto& c : path)
+		{
+			if (c == L'\\')
+			{
+				c = L'/';
+			}
+			else if (c >= L'A' && c <= L'Z')
+			{
+				c = c - L'A' + L'a';
+			}
+		}
+		return path;
+	}
+}
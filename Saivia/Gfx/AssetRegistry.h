@@ -0,0 +1,193 @@
+//
+// AssetRegistry.h - Shared assets keyed by path and content, with handles and reference counts
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Gfx
+{
+	// 64-bit FNV-1a of the bytes of a file
+	uint64_t ContentHash(const void* data, size_t size);
+
+	// Lower case with forward slashes, so that the spellings of one Windows
+	// path share a key
+	std::wstring NormalizeAssetPath(std::wstring path);
+
+	struct AssetKey
+	{
+		std::wstring path;          // normalized
+		uint64_t hash;              // of the contents
+
+		bool operator==(const AssetKey& other) const { return hash == other.hash && path == other.path; }
+	};
+
+	struct AssetKeyHash
+	{
+		size_t operator()(const AssetKey& key) const
+		{
+			return std::hash<std::wstring>()(key.path) ^ static_cast<size_t>(key.hash * 0x9e3779b97f4a7c15ull);
+		}
+	};
+
+	// Index of an asset slot; a slot is only handed out again after its
+	// asset was destroyed.
+	using AssetHandle = uint32_t;
+	const AssetHandle NO_ASSET = 0xffffffffu;
+
+	// Assets of one kind, each loaded once per key: the same path with the
+	// same contents. A changed file gets a new key, so a reload only loads
+	// what changed while everything else is found again.
+	//
+	// Every Acquire is paired with one Release. The first Acquire of a key
+	// creates an empty asset and tells its caller to load it. An asset
+	// whose count drops to zero is retired, not destroyed: it is still found
+	// by its key until Collect destroys it, RETIRE_FRAMES frames later, when
+	// the GPU no longer draws with it.
+	//
+	// Acquire and Release are thread safe. Get needs no lock, the slots are
+	// allocated up front; what T itself shares between threads is up to T.
+	template <typename T>
+	class AssetRegistry
+	{
+	public:
+		static constexpr uint64_t RETIRE_FRAMES = 3;
+
+		explicit AssetRegistry(size_t capacity) :
+			m_slots(capacity)
+		{
+		}
+
+		// The asset with key; created is set when the caller has to load it.
+		// Throws when every slot is taken.
+		AssetHandle Acquire(const AssetKey& key, bool& created)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			auto found = m_index.find(key);
+			if (found != m_index.end())
+			{
+				auto& slot = m_slots[found->second];
+				if (slot.refs++ == 0)
+				{
+					m_retired--;
+				}
+				created = false;
+				return found->second;
+			}
+
+			AssetHandle handle;
+			if (!m_free.empty())
+			{
+				handle = m_free.back();
+				m_free.pop_back();
+			}
+			else if (m_used < m_slots.size())
+			{
+				handle = static_cast<AssetHandle>(m_used++);
+			}
+			else
+			{
+				throw std::runtime_error("AssetRegistry: out of slots");
+			}
+
+			auto& slot = m_slots[handle];
+			slot.key = key;
+			slot.refs = 1;
+			slot.asset = std::make_unique<T>();
+			m_index.emplace(key, handle);
+			created = true;
+			return handle;
+		}
+
+		void AddRef(AssetHandle handle)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (m_slots[handle].refs++ == 0)
+			{
+				m_retired--;
+			}
+		}
+
+		// frame: the frame that last drew with the asset
+		void Release(AssetHandle handle, uint64_t frame)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			auto& slot = m_slots[handle];
+			if (--slot.refs == 0)
+			{
+				slot.retiredAt = frame;
+				m_retired++;
+			}
+		}
+
+		T& Get(AssetHandle handle) { return *m_slots[handle].asset; }
+		const T& Get(AssetHandle handle) const { return *m_slots[handle].asset; }
+
+		// Destroys the assets retired RETIRE_FRAMES or more frames before
+		// frame, calling destroy(handle, asset) first. destroy may release
+		// assets of other registries.
+		template <typename Fn>
+		void Collect(uint64_t frame, Fn&& destroy)
+		{
+			std::vector<AssetHandle> expired;
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				if (m_retired == 0)
+				{
+					return;
+				}
+				for (size_t n = 0; n < m_used; n++)
+				{
+					auto& slot = m_slots[n];
+					if (slot.asset && slot.refs == 0 && frame >= slot.retiredAt + RETIRE_FRAMES)
+					{
+						m_index.erase(slot.key);
+						m_retired--;
+						expired.push_back(static_cast<AssetHandle>(n));
+					}
+				}
+			}
+
+			// No longer found, nobody else can reach them
+			for (auto handle : expired)
+			{
+				destroy(handle, *m_slots[handle].asset);
+				m_slots[handle].asset.reset();
+			}
+
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_free.insert(m_free.end(), expired.begin(), expired.end());
+		}
+
+		// Assets alive, retired ones included
+		size_t Count() const
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			return m_index.size();
+		}
+
+	private:
+		struct Slot
+		{
+			AssetKey key;
+			uint32_t refs = 0;
+			uint64_t retiredAt = 0;
+			std::unique_ptr<T> asset;
+		};
+
+		mutable std::mutex m_mutex;
+		std::vector<Slot> m_slots;
+		size_t m_used = 0;                  // slots ever handed out
+		std::vector<AssetHandle> m_free;
+		std::unordered_map<AssetKey, AssetHandle, AssetKeyHash> m_index;
+		size_t m_retired = 0;
+	};
+}
@@ -0,0 +1,311 @@
+//
+// Catenary.cpp
+//
+
+#include "Catenary.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "../Track/Parallel.h"
+#include "RailSweep.h"
+
+namespace Gfx
+{
+	namespace
+	{
+		const double RAIL_TOP = RAIL_BASE + 0.16;  // above the sleeper frame origin
+		const float MAST_HALF_WIDTH = 0.15f;
+		const float MAST_ABOVE_MESSENGER = 0.3f;
+		const float MAST_FOOT = 0.5f;               // below the sleeper frame origin
+
+		const float CONTACT_WIDTH = 0.02f;
+		const float MESSENGER_WIDTH = 0.02f;
+		const float DROPPER_WIDTH = 0.01f;
+		const float ARM_WIDTH = 0.06f;
+
+		const uint32_t CONTACT_COLOR = 0xff3373b8;  // copper
+		const uint32_t MESSENGER_COLOR = 0xff2b5a86;
+		const uint32_t MAST_COLOR = 0xff808080;
+		const uint32_t ARM_COLOR = 0xffa0a0a0;
+
+		const Float3 UP = { 0.f, 1.f, 0.f };
+
+		Float3 ToFloat(const Track::Vec3& v)
+		{
+			return { float(v.x), float(v.y), float(v.z) };
+		}
+
+		Float3 Add(const Float3& a, const Float3& b) { return { a.x + b.x, a.y + b.y, a.z + b.z }; }
+		Float3 Sub(const Float3& a, const Float3& b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+		Float3 Scale(const Float3& v, float s) { return { v.x * s, v.y * s, v.z * s }; }
+		Float3 Cross(const Float3& a, const Float3& b)
+		{
+			return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+		}
+		Float3 Lerp(const Float3& a, const Float3& b, float t) { return Add(a, Scale(Sub(b, a), t)); }
+
+		bool Normalize(Float3& v)
+		{
+			float length = std::sqrt(v.x * v.x + v.y * v.y + v.z * v.z);
+			if (length < 1e-6f)
+			{
+				return false;
+			}
+			v = Scale(v, 1.f / length);
+			return true;
+		}
+
+		// p0 p1 at one end, p2 p3 at the other
+		void AddQuad(MeshData& mesh, const Float3& p0, const Float3& p1, const Float3& p2, const Float3& p3,
+			const Float3& normal, uint32_t color)
+		{
+			uint32_t i = static_cast<uint32_t>(mesh.vertices.size());
+			for (auto& p : { p0, p1, p2, p3 })
+			{
+				mesh.vertices.push_back({ p, normal, color, 0.5f, 0.5f });
+			}
+			mesh.indices.insert(mesh.indices.end(), { i, i + 2, i + 1, i + 1, i + 2, i + 3 });
+		}
+
+		// A wire from a to b as two crossed quads, seen from any side.
+		// fallback is the first quad's width direction for a vertical wire.
+		void AddRibbon(MeshData& mesh, const Float3& a, const Float3& b, float width, uint32_t color, const Float3& fallback)
+		{
+			Float3 direction = Sub(b, a);
+			Float3 side = Cross(direction, UP);
+			if (!Normalize(side))
+			{
+				side = fallback;
+			}
+			Float3 up = Cross(side, direction);
+			if (!Normalize(up))
+			{
+				return;
+			}
+
+			Float3 w = Scale(side, width * 0.5f);
+			AddQuad(mesh, Sub(a, w), Add(a, w), Sub(b, w), Add(b, w), up, color);
+			Float3 h = Scale(up, width * 0.5f);
+			AddQuad(mesh, Sub(a, h), Add(a, h), Sub(b, h), Add(b, h), side, color);
+		}
+
+		// Vertical box standing on base, one pair of faces towards across
+		void AddMast(MeshData& mesh, const Float3& base, const Float3& across, float height, uint32_t color)
+		{
+			Float3 along = Cross(across, UP);
+			Float3 top = Add(base, Scale(UP, height));
+			for (auto& face : { across, Scale(across, -1.f), along, Scale(along, -1.f) })
+			{
+				Float3 u = Scale(Cross(UP, face), MAST_HALF_WIDTH);
+				Float3 offset = Scale(face, MAST_HALF_WIDTH);
+				Float3 bottom = Add(base, offset);
+				Float3 upper = Add(top, offset);
+				AddQuad(mesh, Sub(bottom, u), Add(bottom, u), Sub(upper, u), Add(upper, u), face, color);
+			}
+		}
+
+		// A wire hanging between two supports with the given sag at the middle
+		void AddSpan(MeshData& mesh, const Float3& a, const Float3& b, float sag, int segments, float width,
+			uint32_t color, const Float3& fallback)
+		{
+			auto at = [&](float t) { return Sub(Lerp(a, b, t), Scale(UP, 4.f * sag * t * (1.f - t))); };
+			Float3 last = a;
+			for (int n = 1; n <= segments; n++)
+			{
+				Float3 next = at(float(n) / float(segments));
+				AddRibbon(mesh, last, next, width, color, fallback);
+				last = next;
+			}
+		}
+	}
+
+	void Catenary::Place(const Track::Alignment& alignment, double s0, double s1, const Track::Vec3& origin,
+		const CatenarySettings& settings, CatenaryChunk& chunk)
+	{
+		chunk.supports.clear();
+		double length = s1 - s0;
+		if (!(length > 0.0))
+		{
+			return;
+		}
+
+		// Longest span allowed at a curvature: the supports are pulled out by
+		// half its versine on top of the stagger, which must stay within
+		// maxOffset
+		double room = std::max(settings.maxOffset - settings.stagger, 0.0);
+		auto longestSpan = [&](double curvature)
+		{
+			curvature = std::abs(curvature);
+			return curvature > 0.0 ? std::min(settings.spacing, std::sqrt(16.0 * room / curvature)) : settings.spacing;
+		};
+
+		// Sharpest curve of the chunk; curvature is linear along a segment
+		double curvature = 0.0;
+		auto& segments = alignment.Segments();
+		for (size_t n = alignment.FindSegment(s0); n < segments.size() && segments[n].s0 < s1; n++)
+		{
+			curvature = std::max({ curvature, std::abs(segments[n].curvature), std::abs(segments[n].endCurvature) });
+		}
+		double span = std::max(longestSpan(curvature), 1.0);
+		size_t spans = std::max<size_t>(2, 2 * static_cast<size_t>(std::ceil(length / (2.0 * span))));
+		span = length / static_cast<double>(spans);
+		chunk.span = float(span);
+
+		chunk.supports.resize(spans + 1);
+		Track::Alignment::Cursor cursor(alignment);
+		for (size_t k = 0; k <= spans; k++)
+		{
+			double s = k == spans ? s1 : s0 + span * static_cast<double>(k);
+			Track::Pose pose = cursor.At(s);
+			Track::Frame frame = Track::MakeFrame(pose);
+
+			// Positive curvature turns towards +B: the supports move to -B,
+			// and the mast stands on the outside of the curve. The pull-out
+			// only depends on the local curvature, so the support shared
+			// with the neighbouring chunk comes out the same from both.
+			Track::Vec3 across = { frame.B.x, 0.0, frame.B.z };
+			across.Normalize();
+			double local = longestSpan(pose.curvature);
+			double x = (k % 2 == 0 ? settings.stagger : -settings.stagger) - pose.curvature * local * local / 16.0;
+			x = std::min(std::max(x, -settings.maxOffset), settings.maxOffset);
+			double side = pose.curvature < 0.0 ? 1.0 : -1.0;
+
+			Track::Vec3 up = { 0.0, 1.0, 0.0 };
+			Track::Vec3 contact = frame.Pos + frame.N * RAIL_TOP + across * x + up * settings.contactHeight;
+			auto& support = chunk.supports[k];
+			support.contact = ToFloat(contact - origin);
+			support.messenger = ToFloat(contact + up * settings.systemHeight - origin);
+			support.mastBase = ToFloat(frame.Pos + across * (side * settings.poleOffset) - up * MAST_FOOT - origin);
+			support.across = ToFloat(across * side);
+		}
+	}
+
+	void Catenary::AppendMesh(const CatenaryChunk& chunk, const CatenarySettings& settings, bool detail, MeshData& mesh)
+	{
+		auto& supports = chunk.supports;
+		if (supports.size() < 2)
+		{
+			return;
+		}
+
+		float span = chunk.span;
+		float messengerSag = float(settings.wireWeight * span * span / (8.0 * settings.messengerTension));
+		float contactSag = float(settings.presag * span);
+		int droppers = std::max(1, static_cast<int>(std::lround(span / settings.dropperSpacing)) - 1);
+
+		for (size_t k = 0; k + 1 < supports.size(); k++)
+		{
+			auto& a = supports[k];
+			auto& b = supports[k + 1];
+			AddSpan(mesh, a.messenger, b.messenger, messengerSag, detail ? 8 : 2, MESSENGER_WIDTH, MESSENGER_COLOR, a.across);
+			AddSpan(mesh, a.contact, b.contact, contactSag, detail ? 4 : 1, CONTACT_WIDTH, CONTACT_COLOR, a.across);
+			if (!detail)
+			{
+				continue;
+			}
+			for (int d = 1; d <= droppers; d++)
+			{
+				float t = float(d) / float(droppers + 1);
+				float shape = 4.f * t * (1.f - t);
+				Float3 top = Sub(Lerp(a.messenger, b.messenger, t), Scale(UP, messengerSag * shape));
+				Float3 bottom = Sub(Lerp(a.contact, b.contact, t), Scale(UP, contactSag * shape));
+				AddRibbon(mesh, top, bottom, DROPPER_WIDTH, MESSENGER_COLOR, a.across);
+			}
+		}
+
+		// Masts with their cantilever: one arm to the messenger, one to the
+		// contact wire
+		size_t first = chunk.firstMast ? 0 : 1;
+		size_t last = chunk.lastMast ? supports.size() : supports.size() - 1;
+		for (size_t k = first; k < last; k++)
+		{
+			auto& support = supports[k];
+			float height = support.messenger.y + MAST_ABOVE_MESSENGER - support.mastBase.y;
+			AddMast(mesh, support.mastBase, support.across, height, MAST_COLOR);
+
+			Float3 face = Sub(support.mastBase, Scale(support.across, MAST_HALF_WIDTH));
+			for (auto& end : { support.messenger, support.contact })
+			{
+				Float3 start = { face.x, end.y, face.z };
+				AddRibbon(mesh, start, end, ARM_WIDTH, ARM_COLOR, support.across);
+			}
+		}
+	}
+
+	void Catenary::PlaceChunks(const Track::TrackGraph& graph, const SleeperChunks& sleepers,
+		const std::vector<SleeperChunks::Change>& changes)
+	{
+		struct Job
+		{
+			uint32_t edge;
+			size_t index;
+		};
+		std::vector<Job> jobs;
+		for (auto& change : changes)
+		{
+			size_t count = sleepers.EdgeChunks(change.edge).size();
+			m_chunks[change.edge].resize(count);
+			for (size_t c = change.firstChunk; c < count; c++)
+			{
+				jobs.push_back({ change.edge, c });
+			}
+		}
+
+		Track::ParallelFor(jobs.size(), [&](size_t j)
+		{
+			auto& job = jobs[j];
+			auto& edge = graph.Edges()[job.edge];
+			auto& sleeperChunk = sleepers.EdgeChunks(job.edge)[job.index];
+			auto& chunk = m_chunks[job.edge][job.index];
+			Place(graph.Alignments()[edge.railway], sleeperChunk.s0, sleeperChunk.s1, sleeperChunk.origin, m_settings, chunk);
+
+			// A branch starts at its turnout, where the parent has a mast; an
+			// open end of the edge has no following chunk to put one up
+			bool diverging = edge.from != Track::TrackGraph::NONE && graph.Turnouts()[edge.from].diverging == job.edge;
+			chunk.firstMast = !(job.index == 0 && diverging);
+			chunk.lastMast = job.index + 1 == m_chunks[job.edge].size() && edge.to == Track::TrackGraph::NONE;
+		});
+	}
+
+	void Catenary::Rebuild(const Track::TrackGraph& graph, const SleeperChunks& sleepers)
+	{
+		m_chunks.assign(sleepers.EdgeCount(), std::vector<CatenaryChunk>());
+		std::vector<SleeperChunks::Change> changes;
+		for (uint32_t e = 0; e < sleepers.EdgeCount(); e++)
+		{
+			changes.push_back({ e, 0 });
+		}
+		PlaceChunks(graph, sleepers, changes);
+	}
+
+	void Catenary::Update(const Track::TrackGraph& graph, const SleeperChunks& sleepers)
+	{
+		if (m_chunks.size() != sleepers.EdgeCount())
+		{
+			Rebuild(graph, sleepers);
+			return;
+		}
+		PlaceChunks(graph, sleepers, sleepers.Changes());
+	}
+
+	size_t Catenary::SupportCount() const
+	{
+		size_t count = 0;
+		for (auto& edge : m_chunks)
+		{
+			for (auto& chunk : edge)
+			{
+				count += chunk.supports.size();
+			}
+		}
+		return count;
+	}
+
+	float Catenary::Reach() const
+	{
+		double across = m_settings.poleOffset + MAST_HALF_WIDTH;
+		double up = RAIL_TOP + m_settings.contactHeight + m_settings.systemHeight + MAST_ABOVE_MESSENGER;
+		return float(std::sqrt(across * across + up * up));
+	}
+}
@@ -0,0 +1,93 @@
+//
+// Catenary.h - Overhead line (masts, messenger and contact wire) along the alignment
+//
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "../Track/TrackGraph.h"
+#include "GfxTypes.h"
+#include "SleeperChunks.h"
+
+namespace Gfx
+{
+	// Lengths in metres, forces in newtons.
+	struct CatenarySettings
+	{
+		double spacing = 50.0;              // longest span, on straight track
+		double contactHeight = 5.3;         // contact wire above the rail top
+		double systemHeight = 1.2;          // messenger above the contact wire at a support
+		double stagger = 0.2;               // zig-zag of the contact wire at the supports
+		double maxOffset = 0.4;             // contact wire off the track centre, anywhere in a span
+		double poleOffset = 3.0;            // mast from the track centre
+		double messengerTension = 15000.0;
+		double wireWeight = 16.0;           // per metre hanging off the messenger: both wires and droppers
+		double presag = 0.001;              // contact wire sag per metre of span
+		double dropperSpacing = 6.0;
+	};
+
+	// One support, positions relative to the chunk origin.
+	struct CatenarySupport
+	{
+		Float3 contact;                     // contact wire
+		Float3 messenger;
+		Float3 mastBase;
+		Float3 across;                      // horizontal, from the track towards the mast
+	};
+
+	// The supports of one sleeper chunk. Masts stand on a grid that shares
+	// the chunk boundaries: every chunk is an even number of equal spans, so
+	// its first and last support are the chunk ends with the same stagger
+	// and neighbouring chunks, built independently, meet at a common support.
+	struct CatenaryChunk
+	{
+		std::vector<CatenarySupport> supports;
+		float span = 0.f;
+		bool firstMast = true;              // false where another edge has a mast already
+		bool lastMast = false;              // the last support is an open end of the edge
+	};
+
+	// Overhead line of every sleeper chunk, indexed like SleeperChunks.
+	//
+	// Spans are shortened on curves until the straight wire between two
+	// supports stays within maxOffset of the track centre: the supports
+	// are pulled outwards by half the versine (L^2 / 8R) on top of the
+	// alternating stagger. Sag is analytic: the messenger hangs as a
+	// parabola with sag w L^2 / (8 H), the contact wire with presag L.
+	class Catenary
+	{
+	public:
+		void SetSettings(const CatenarySettings& settings) { m_settings = settings; }
+		const CatenarySettings& Settings() const { return m_settings; }
+
+		// Places the supports of every chunk, in parallel on the shared pool.
+		void Rebuild(const Track::TrackGraph& graph, const SleeperChunks& sleepers);
+
+		// Places the supports of the chunks sleepers.Changes() reports, to be
+		// called right after sleepers.Update(graph).
+		void Update(const Track::TrackGraph& graph, const SleeperChunks& sleepers);
+
+		const CatenaryChunk& GetChunk(uint32_t edge, size_t index) const { return m_chunks[edge][index]; }
+		size_t SupportCount() const;
+
+		// How far the overhead line reaches from the sleeper frames (for
+		// the culling boxes).
+		float Reach() const;
+
+		static void Place(const Track::Alignment& alignment, double s0, double s1, const Track::Vec3& origin,
+			const CatenarySettings& settings, CatenaryChunk& chunk);
+
+		// Appends a chunk's overhead line to mesh as thin crossed ribbons and
+		// boxes. Without detail (far away) the droppers are left out and the
+		// wires get fewer segments.
+		static void AppendMesh(const CatenaryChunk& chunk, const CatenarySettings& settings, bool detail, MeshData& mesh);
+
+	private:
+		void PlaceChunks(const Track::TrackGraph& graph, const SleeperChunks& sleepers, const std::vector<SleeperChunks::Change>& changes);
+
+		CatenarySettings m_settings;
+		std::vector<std::vector<CatenaryChunk>> m_chunks;   // per edge
+	};
+}
@@ -0,0 +1,100 @@
+//
+// ChunkBaker.cpp
+//
+
+#include "ChunkBaker.h"
+
+#include "../Track/Parallel.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define GFX_BAKE_SSE 1
+#endif
+
+namespace Gfx
+{
+#if GFX_BAKE_SSE
+	namespace
+	{
+		// x and y as one 8 byte store, then z: nothing past the Float3
+		void StoreFloat3(Float3& to, __m128 value)
+		{
+			_mm_storel_pi(reinterpret_cast<__m64*>(&to.x), value);
+			_mm_store_ss(&to.z, _mm_shuffle_ps(value, value, _MM_SHUFFLE(2, 2, 2, 2)));
+		}
+	}
+#endif
+
+	void BakeChunk(const MeshData& part, const SleeperChunk& chunk, MeshData& baked)
+	{
+		size_t vertexCount = part.vertices.size();
+		size_t indexCount = part.indices.size();
+		size_t count = chunk.Count();
+		baked.vertices.resize(vertexCount * count);
+		baked.indices.resize(indexCount * count);
+
+		for (size_t n = 0; n < count; n++)
+		{
+			Float3 B, N, T;
+			UnpackRotation(chunk.rotations[n], B, N, T);
+			auto& p = chunk.positions[n];
+
+			const MeshVertex* in = part.vertices.data();
+			MeshVertex* out = baked.vertices.data() + n * vertexCount;
+#if GFX_BAKE_SSE
+			// Columns of the sleeper's rotation, one vertex per iteration
+			__m128 b = _mm_setr_ps(B.x, B.y, B.z, 0.f);
+			__m128 nn = _mm_setr_ps(N.x, N.y, N.z, 0.f);
+			__m128 t = _mm_setr_ps(T.x, T.y, T.z, 0.f);
+			__m128 origin = _mm_setr_ps(p.x, p.y, p.z, 0.f);
+			for (size_t v = 0; v < vertexCount; v++, in++, out++)
+			{
+				__m128 position = _mm_add_ps(
+					_mm_add_ps(_mm_mul_ps(b, _mm_set1_ps(in->position.x)), _mm_mul_ps(nn, _mm_set1_ps(in->position.y))),
+					_mm_add_ps(_mm_mul_ps(t, _mm_set1_ps(in->position.z)), origin));
+				__m128 normal = _mm_add_ps(
+					_mm_add_ps(_mm_mul_ps(b, _mm_set1_ps(in->normal.x)), _mm_mul_ps(nn, _mm_set1_ps(in->normal.y))),
+					_mm_mul_ps(t, _mm_set1_ps(in->normal.z)));
+				StoreFloat3(out->position, position);
+				StoreFloat3(out->normal, normal);
+				out->color = in->color;
+				out->u = in->u;
+				out->v = in->v;
+			}
+#else
+			for (size_t v = 0; v < vertexCount; v++, in++, out++)
+			{
+				auto& q = in->position;
+				auto& m = in->normal;
+				out->position = {
+					B.x * q.x + N.x * q.y + T.x * q.z + p.x,
+					B.y * q.x + N.y * q.y + T.y * q.z + p.y,
+					B.z * q.x + N.z * q.y + T.z * q.z + p.z };
+				out->normal = {
+					B.x * m.x + N.x * m.y + T.x * m.z,
+					B.y * m.x + N.y * m.y + T.y * m.z,
+					B.z * m.x + N.z * m.y + T.z * m.z };
+				out->color = in->color;
+				out->u = in->u;
+				out->v = in->v;
+			}
+#endif
+
+			uint32_t base = static_cast<uint32_t>(n * vertexCount);
+			uint32_t* indices = baked.indices.data() + n * indexCount;
+			for (size_t i = 0; i < indexCount; i++)
+			{
+				indices[i] = part.indices[i] + base;
+			}
+		}
+	}
+
+	void BakeChunks(const std::vector<MeshData>& parts, const std::vector<const SleeperChunk*>& chunks, std::vector<MeshData>& baked)
+	{
+		baked.resize(chunks.size() * parts.size());
+		Track::ParallelFor(baked.size(), [&](size_t i)
+		{
+			BakeChunk(parts[i % parts.size()], *chunks[i / parts.size()], baked[i]);
+		});
+	}
+}
@@ -0,0 +1,27 @@
+//
+// ChunkBaker.h - Static batching: the sleeper model baked into one mesh per chunk
+//
+
+#pragma once
+
+#include <vector>
+
+#include "GfxTypes.h"
+#include "SleeperChunks.h"
+
+namespace Gfx
+{
+	// The alternative to instancing for static track: every sleeper of a chunk
+	// transformed into chunk space and concatenated, so a chunk costs one draw
+	// per model part whatever its sleeper count.
+	//
+	// Model parts are in the sleeper's own space, drawn the way the instances
+	// are: x along B, y along N, z along T.
+
+	// One part for every sleeper of chunk, relative to chunk.origin.
+	void BakeChunk(const MeshData& part, const SleeperChunk& chunk, MeshData& baked);
+
+	// Every part for every chunk on the shared thread pool:
+	// baked[c * parts.size() + p] is part p of chunks[c].
+	void BakeChunks(const std::vector<MeshData>& parts, const std::vector<const SleeperChunk*>& chunks, std::vector<MeshData>& baked);
+}
@@ -0,0 +1,326 @@
+//
+// ChunkCuller.cpp
+//
+
+#include "ChunkCuller.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#include "../Track/Parallel.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define GFX_CULL_SSE 1
+#endif
+
+namespace Gfx
+{
+	namespace
+	{
+		// Groups per parallel work item
+		const size_t CULL_BLOCK = 64;
+
+		// Tests the four boxes starting at i against every plane. A bit is set
+		// in outside when the box is behind some plane, in partial when it is
+		// not behind any plane but crosses one.
+		template <typename Boxes>
+		void ClassifyBoxes(const Frustum& frustum, const Boxes& boxes, size_t i, int& outside, int& partial)
+		{
+#if GFX_CULL_SSE
+			__m128 out = _mm_setzero_ps();
+			__m128 crossing = _mm_setzero_ps();
+			__m128 zero = _mm_setzero_ps();
+			for (auto& plane : frustum.planes)
+			{
+				// Nearest and farthest corner along the plane normal
+				const float* px = plane[0] > 0.f ? &boxes.maxX[i] : &boxes.minX[i];
+				const float* nx = plane[0] > 0.f ? &boxes.minX[i] : &boxes.maxX[i];
+				const float* py = plane[1] > 0.f ? &boxes.maxY[i] : &boxes.minY[i];
+				const float* ny = plane[1] > 0.f ? &boxes.minY[i] : &boxes.maxY[i];
+				const float* pz = plane[2] > 0.f ? &boxes.maxZ[i] : &boxes.minZ[i];
+				const float* nz = plane[2] > 0.f ? &boxes.minZ[i] : &boxes.maxZ[i];
+
+				__m128 a = _mm_set1_ps(plane[0]);
+				__m128 b = _mm_set1_ps(plane[1]);
+				__m128 c = _mm_set1_ps(plane[2]);
+				__m128 d = _mm_set1_ps(plane[3]);
+
+				__m128 far = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a, _mm_loadu_ps(px)), _mm_mul_ps(b, _mm_loadu_ps(py))),
+					_mm_add_ps(_mm_mul_ps(c, _mm_loadu_ps(pz)), d));
+				__m128 near = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a, _mm_loadu_ps(nx)), _mm_mul_ps(b, _mm_loadu_ps(ny))),
+					_mm_add_ps(_mm_mul_ps(c, _mm_loadu_ps(nz)), d));
+
+				out = _mm_or_ps(out, _mm_cmplt_ps(far, zero));
+				crossing = _mm_or_ps(crossing, _mm_cmplt_ps(near, zero));
+			}
+			outside = _mm_movemask_ps(out);
+			partial = _mm_movemask_ps(_mm_andnot_ps(out, crossing));
+#else
+			outside = 0;
+			partial = 0;
+			for (size_t lane = 0; lane < 4; lane++)
+			{
+				size_t n = i + lane;
+				bool out = false;
+				bool crossing = false;
+				for (auto& plane : frustum.planes)
+				{
+					float far = plane[0] * (plane[0] > 0.f ? boxes.maxX[n] : boxes.minX[n]) +
+						plane[1] * (plane[1] > 0.f ? boxes.maxY[n] : boxes.minY[n]) +
+						plane[2] * (plane[2] > 0.f ? boxes.maxZ[n] : boxes.minZ[n]) + plane[3];
+					float near = plane[0] * (plane[0] > 0.f ? boxes.minX[n] : boxes.maxX[n]) +
+						plane[1] * (plane[1] > 0.f ? boxes.minY[n] : boxes.maxY[n]) +
+						plane[2] * (plane[2] > 0.f ? boxes.minZ[n] : boxes.maxZ[n]) + plane[3];
+					out = out || far < 0.f;
+					crossing = crossing || near < 0.f;
+				}
+				outside |= int(out) << lane;
+				partial |= int(!out && crossing) << lane;
+			}
+#endif
+		}
+
+		void AppendRange(std::vector<uint32_t>& visible, uint32_t first, size_t count)
+		{
+			size_t base = visible.size();
+			visible.resize(base + count);
+			for (size_t n = 0; n < count; n++)
+			{
+				visible[base + n] = first + static_cast<uint32_t>(n);
+			}
+		}
+	}
+
+	void ChunkCuller::Boxes::Resize(size_t count)
+	{
+		// The padding lanes are classified but never read back
+		size_t padded = (count + 3) & ~size_t(3);
+		for (auto* v : { &minX, &minY, &minZ, &maxX, &maxY, &maxZ })
+		{
+			v->assign(padded, 0.f);
+		}
+	}
+
+	void ChunkCuller::Boxes::Set(size_t i, const Float3& min, const Float3& max)
+	{
+		minX[i] = min.x;
+		minY[i] = min.y;
+		minZ[i] = min.z;
+		maxX[i] = max.x;
+		maxY[i] = max.y;
+		maxZ[i] = max.z;
+	}
+
+	void ChunkCuller::Build(const SleeperChunks& chunks, const Track::Vec3& origin, float radius, float chunkRadius)
+	{
+		m_radius = radius;
+		m_padding = std::max(chunkRadius - radius, 0.f);
+		m_chunks.clear();
+		m_edgeFirst.resize(chunks.EdgeCount());
+		uint32_t instance = 0;
+		for (uint32_t edge = 0; edge < chunks.EdgeCount(); edge++)
+		{
+			m_edgeFirst[edge] = static_cast<uint32_t>(m_chunks.size());
+			for (auto& chunk : chunks.EdgeChunks(edge))
+			{
+				auto offset = chunk.origin - origin;
+				m_chunks.push_back({ &chunk, instance, { float(offset.x), float(offset.y), float(offset.z) } });
+				instance += static_cast<uint32_t>(chunk.Count());
+			}
+		}
+
+		m_groupCount = (m_chunks.size() + GROUP_SIZE - 1) / GROUP_SIZE;
+		m_chunkBoxes.Resize(m_chunks.size());
+		m_groupBoxes.Resize(m_groupCount);
+		for (size_t g = 0; g < m_groupCount; g++)
+		{
+			Float3 groupMin = { FLT_MAX, FLT_MAX, FLT_MAX };
+			Float3 groupMax = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+			size_t end = std::min(m_chunks.size(), (g + 1) * GROUP_SIZE);
+			for (size_t c = g * GROUP_SIZE; c < end; c++)
+			{
+				auto& entry = m_chunks[c];
+				auto& chunk = *entry.chunk;
+				float grow = radius + m_padding;
+				Float3 min = { entry.offset.x + chunk.boundsMin.x - grow, entry.offset.y + chunk.boundsMin.y - grow, entry.offset.z + chunk.boundsMin.z - grow };
+				Float3 max = { entry.offset.x + chunk.boundsMax.x + grow, entry.offset.y + chunk.boundsMax.y + grow, entry.offset.z + chunk.boundsMax.z + grow };
+				m_chunkBoxes.Set(c, min, max);
+
+				groupMin = { std::min(groupMin.x, min.x), std::min(groupMin.y, min.y), std::min(groupMin.z, min.z) };
+				groupMax = { std::max(groupMax.x, max.x), std::max(groupMax.y, max.y), std::max(groupMax.z, max.z) };
+			}
+			m_groupBoxes.Set(g, groupMin, groupMax);
+		}
+	}
+
+	void ChunkCuller::Cull(const Frustum& frustum, std::vector<uint32_t>& visible) const
+	{
+		std::vector<VisibleChunk> chunks;
+		CullChunks(frustum, chunks);
+
+		visible.clear();
+		for (auto& chunk : chunks)
+		{
+			AppendInstances(frustum, chunk, visible);
+		}
+	}
+
+	void ChunkCuller::CullParallel(const Frustum& frustum, std::vector<uint32_t>& visible) const
+	{
+		// Every block collects its own list; concatenated in order the result
+		// is the same as Cull's
+		size_t blocks = (m_groupCount + CULL_BLOCK - 1) / CULL_BLOCK;
+		std::vector<std::vector<uint32_t>> lists(blocks);
+		Track::ParallelFor(blocks, [&](size_t b)
+		{
+			std::vector<VisibleChunk> chunks;
+			CullGroups(frustum, b * CULL_BLOCK, std::min(m_groupCount, (b + 1) * CULL_BLOCK), chunks);
+			for (auto& chunk : chunks)
+			{
+				AppendInstances(frustum, chunk, lists[b]);
+			}
+		});
+
+		visible.clear();
+		for (auto& list : lists)
+		{
+			visible.insert(visible.end(), list.begin(), list.end());
+		}
+	}
+
+	void ChunkCuller::CullChunks(const Frustum& frustum, std::vector<VisibleChunk>& visible) const
+	{
+		visible.clear();
+		CullGroups(frustum, 0, m_groupCount, visible);
+	}
+
+	void ChunkCuller::AppendInstances(const Frustum& frustum, const VisibleChunk& chunk, std::vector<uint32_t>& visible) const
+	{
+		auto& entry = m_chunks[chunk.chunk];
+		if (chunk.partial)
+		{
+			CullInstances(frustum, entry, visible);
+		}
+		else
+		{
+			AppendRange(visible, entry.firstInstance, entry.chunk->Count());
+		}
+	}
+
+	float ChunkCuller::Distance(size_t chunk, const Float3& point) const
+	{
+		float p = m_padding;
+		float dx = std::max({ m_chunkBoxes.minX[chunk] + p - point.x, 0.f, point.x - m_chunkBoxes.maxX[chunk] + p });
+		float dy = std::max({ m_chunkBoxes.minY[chunk] + p - point.y, 0.f, point.y - m_chunkBoxes.maxY[chunk] + p });
+		float dz = std::max({ m_chunkBoxes.minZ[chunk] + p - point.z, 0.f, point.z - m_chunkBoxes.maxZ[chunk] + p });
+		return std::sqrt(dx * dx + dy * dy + dz * dz);
+	}
+
+	void ChunkCuller::CullGroups(const Frustum& frustum, size_t firstGroup, size_t lastGroup, std::vector<VisibleChunk>& visible) const
+	{
+		// Groups are classified four at a time; blocks start at multiples of
+		// CULL_BLOCK, so firstGroup is a multiple of four
+		for (size_t g = firstGroup; g < lastGroup; g += 4)
+		{
+			int groupOutside, groupPartial;
+			ClassifyBoxes(frustum, m_groupBoxes, g, groupOutside, groupPartial);
+
+			for (size_t lane = 0; lane < 4 && g + lane < lastGroup; lane++)
+			{
+				if (groupOutside & (1 << lane))
+				{
+					continue;
+				}
+
+				size_t first = (g + lane) * GROUP_SIZE;
+				size_t end = std::min(m_chunks.size(), first + GROUP_SIZE);
+				if (!(groupPartial & (1 << lane)))
+				{
+					for (size_t c = first; c < end; c++)
+					{
+						visible.push_back({ static_cast<uint32_t>(c), false });
+					}
+					continue;
+				}
+
+				// GROUP_SIZE is a multiple of four, so are the chunk blocks
+				for (size_t c = first; c < end; c += 4)
+				{
+					int outside, partial;
+					ClassifyBoxes(frustum, m_chunkBoxes, c, outside, partial);
+					for (size_t n = c; n < c + 4 && n < end; n++)
+					{
+						int bit = 1 << (n - c);
+						if (!(outside & bit))
+						{
+							visible.push_back({ static_cast<uint32_t>(n), (partial & bit) != 0 });
+						}
+					}
+				}
+			}
+		}
+	}
+
+	void ChunkCuller::CullInstances(const Frustum& frustum, const Chunk& entry, std::vector<uint32_t>& visible) const
+	{
+		// Planes moved into the chunk's frame, so the float positions relative
+		// to the chunk origin are tested as they are
+		auto& chunk = *entry.chunk;
+		float planes[Frustum::PlaneCount][4];
+		for (int p = 0; p < Frustum::PlaneCount; p++)
+		{
+			auto& plane = frustum.planes[p];
+			planes[p][0] = plane[0];
+			planes[p][1] = plane[1];
+			planes[p][2] = plane[2];
+			planes[p][3] = plane[3] + plane[0] * entry.offset.x + plane[1] * entry.offset.y + plane[2] * entry.offset.z + m_radius;
+		}
+
+		size_t count = chunk.Count();
+		size_t n = 0;
+#if GFX_CULL_SSE
+		// Four instances at a time
+		__m128 zero = _mm_setzero_ps();
+		for (; n + 4 <= count; n += 4)
+		{
+			auto* p = &chunk.positions[n];
+			__m128 x = _mm_setr_ps(p[0].x, p[1].x, p[2].x, p[3].x);
+			__m128 y = _mm_setr_ps(p[0].y, p[1].y, p[2].y, p[3].y);
+			__m128 z = _mm_setr_ps(p[0].z, p[1].z, p[2].z, p[3].z);
+
+			__m128 out = _mm_setzero_ps();
+			for (auto& plane : planes)
+			{
+				__m128 distance = _mm_add_ps(
+					_mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane[0]), x), _mm_mul_ps(_mm_set1_ps(plane[1]), y)),
+					_mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane[2]), z), _mm_set1_ps(plane[3])));
+				out = _mm_or_ps(out, _mm_cmplt_ps(distance, zero));
+			}
+
+			int inside = ~_mm_movemask_ps(out) & 0xf;
+			for (int lane = 0; lane < 4; lane++)
+			{
+				if (inside & (1 << lane))
+				{
+					visible.push_back(entry.firstInstance + static_cast<uint32_t>(n + lane));
+				}
+			}
+		}
+#endif
+		for (; n < count; n++)
+		{
+			auto& p = chunk.positions[n];
+			bool inside = true;
+			for (auto& plane : planes)
+			{
+				inside = inside && plane[0] * p.x + plane[1] * p.y + plane[2] * p.z + plane[3] >= 0.f;
+			}
+			if (inside)
+			{
+				visible.push_back(entry.firstInstance + static_cast<uint32_t>(n));
+			}
+		}
+	}
+}
@@ -0,0 +1,88 @@
+//
+// ChunkCuller.h - Frustum culling of sleeper instances through a two-level box hierarchy
+//
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "Frustum.h"
+#include "SleeperChunks.h"
+
+namespace Gfx
+{
+	// Chunks are already boxes along chainage; GROUP_SIZE consecutive chunks
+	// form the upper level. A group or chunk fully outside is skipped, fully
+	// inside is taken whole, and only chunks crossing a plane test their
+	// instances. Boxes are stored as structure of arrays and tested four at
+	// a time with SSE (scalar elsewhere).
+	//
+	// Build takes the chunk bounds that SleeperChunks keeps per chunk (and
+	// only recomputes for chunks an edit touched), so a rebuild is O(chunks).
+	class ChunkCuller
+	{
+	public:
+		static constexpr size_t GROUP_SIZE = 16;
+
+		// Boxes relative to origin (the render origin), grown by the bounding
+		// radius of the instanced model. Instance indices follow the order of
+		// SleeperChunks::PackInstances. chunkRadius grows the chunk and group
+		// boxes further for geometry drawn per chunk that reaches beyond the
+		// instances (catenary); instances are still tested with radius.
+		void Build(const SleeperChunks& chunks, const Track::Vec3& origin, float radius, float chunkRadius = 0.f);
+
+		struct VisibleChunk
+		{
+			uint32_t chunk;
+			bool partial;           // crosses a plane, its instances need testing
+		};
+
+		// Indices of the visible instances, ascending.
+		void Cull(const Frustum& frustum, std::vector<uint32_t>& visible) const;
+
+		// Same result, groups spread over the shared thread pool.
+		void CullParallel(const Frustum& frustum, std::vector<uint32_t>& visible) const;
+
+		// The chunk level alone, for callers that draw some chunks another way
+		// (LOD); AppendInstances then expands the ones drawn as instances.
+		void CullChunks(const Frustum& frustum, std::vector<VisibleChunk>& visible) const;
+		void AppendInstances(const Frustum& frustum, const VisibleChunk& chunk, std::vector<uint32_t>& visible) const;
+
+		size_t ChunkCount() const { return m_chunks.size(); }
+		uint32_t FirstChunk(uint32_t edge) const { return m_edgeFirst[edge]; }
+		const SleeperChunk& GetChunk(size_t chunk) const { return *m_chunks[chunk].chunk; }
+		const Float3& ChunkOffset(size_t chunk) const { return m_chunks[chunk].offset; }
+
+		// Distance from point to the chunk's box (without chunkRadius), 0 inside.
+		float Distance(size_t chunk, const Float3& point) const;
+
+	private:
+		struct Chunk
+		{
+			const SleeperChunk* chunk;
+			uint32_t firstInstance;
+			Float3 offset;          // chunk origin relative to the render origin
+		};
+
+		// Axis aligned boxes, padded to a multiple of four
+		struct Boxes
+		{
+			std::vector<float> minX, minY, minZ, maxX, maxY, maxZ;
+
+			void Resize(size_t count);
+			void Set(size_t i, const Float3& min, const Float3& max);
+		};
+
+		void CullGroups(const Frustum& frustum, size_t firstGroup, size_t lastGroup, std::vector<VisibleChunk>& visible) const;
+		void CullInstances(const Frustum& frustum, const Chunk& chunk, std::vector<uint32_t>& visible) const;
+
+		std::vector<Chunk> m_chunks;
+		std::vector<uint32_t> m_edgeFirst;     // index of each edge's first chunk
+		Boxes m_chunkBoxes;
+		Boxes m_groupBoxes;
+		size_t m_groupCount = 0;
+		float m_radius = 0.f;
+		float m_padding = 0.f;                 // chunkRadius beyond radius
+	};
+}
@@ -0,0 +1,118 @@
+//
+// Frustum.cpp
+//
+
+#include "Frustum.h"
+
+#include <cmath>
+
+namespace Gfx
+{
+	namespace
+	{
+		Float3 Subtract(const Float3& a, const Float3& b)
+		{
+			return { a.x - b.x, a.y - b.y, a.z - b.z };
+		}
+
+		Float3 Cross(const Float3& a, const Float3& b)
+		{
+			return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+		}
+
+		float Dot(const Float3& a, const Float3& b)
+		{
+			return a.x * b.x + a.y * b.y + a.z * b.z;
+		}
+
+		Float3 Normalize(const Float3& v)
+		{
+			float length = std::sqrt(Dot(v, v));
+			return length > 0.f ? Float3{ v.x / length, v.y / length, v.z / length } : v;
+		}
+	}
+
+	Float4x4 Multiply(const Float4x4& a, const Float4x4& b)
+	{
+		Float4x4 result;
+		for (int r = 0; r < 4; r++)
+		{
+			for (int c = 0; c < 4; c++)
+			{
+				result.m[r][c] = a.m[r][0] * b.m[0][c] + a.m[r][1] * b.m[1][c] + a.m[r][2] * b.m[2][c] + a.m[r][3] * b.m[3][c];
+			}
+		}
+		return result;
+	}
+
+	Float4x4 LookAtRH(const Float3& eye, const Float3& target, const Float3& up)
+	{
+		Float3 z = Normalize(Subtract(eye, target));
+		Float3 x = Normalize(Cross(up, z));
+		Float3 y = Cross(z, x);
+		return { {
+			{ x.x, y.x, z.x, 0.f },
+			{ x.y, y.y, z.y, 0.f },
+			{ x.z, y.z, z.z, 0.f },
+			{ -Dot(x, eye), -Dot(y, eye), -Dot(z, eye), 1.f } } };
+	}
+
+	Float4x4 PerspectiveFovRH(float fovY, float aspect, float nearZ, float farZ)
+	{
+		float h = 1.f / std::tan(fovY * 0.5f);
+		float w = h / aspect;
+		float range = farZ / (nearZ - farZ);
+		return { {
+			{ w, 0.f, 0.f, 0.f },
+			{ 0.f, h, 0.f, 0.f },
+			{ 0.f, 0.f, range, -1.f },
+			{ 0.f, 0.f, range * nearZ, 0.f } } };
+	}
+
+	Frustum Frustum::FromViewProjection(const Float4x4& view, const Float4x4& projection)
+	{
+		// clip = p * M, so clip.x is the dot product with column 0 of M and so on;
+		// -w <= x <= w, -w <= y <= w, 0 <= z <= w
+		Float4x4 m = Multiply(view, projection);
+		auto column = [&m](int c, float (&out)[4], float sign, int add)
+		{
+			for (int r = 0; r < 4; r++)
+			{
+				out[r] = m.m[r][3] * float(add) + sign * m.m[r][c];
+			}
+		};
+
+		Frustum frustum;
+		column(0, frustum.planes[Left], 1.f, 1);
+		column(0, frustum.planes[Right], -1.f, 1);
+		column(1, frustum.planes[Bottom], 1.f, 1);
+		column(1, frustum.planes[Top], -1.f, 1);
+		column(2, frustum.planes[Near], 1.f, 0);
+		column(2, frustum.planes[Far], -1.f, 1);
+
+		for (auto& plane : frustum.planes)
+		{
+			float length = std::sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+			if (length > 0.f)
+			{
+				for (auto& v : plane)
+				{
+					v /= length;
+				}
+			}
+		}
+		return frustum;
+	}
+
+	bool Frustum::ContainsSphere(const Float3& center, float radius) const
+	{
+		for (auto& plane : planes)
+		{
+			if (plane[0] * center.x + plane[1] * center.y + plane[2] * center.z + plane[3] < -radius)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+}
@@ -0,0 +1,28 @@
+//
+// Frustum.h - Camera matrices and the view frustum planes taken from them
+//
+
+#pragma once
+
+#include "GfxTypes.h"
+
+namespace Gfx
+{
+	// Same conventions as DirectXMath: row vectors, right handed, clip z in [0, w].
+	Float4x4 Multiply(const Float4x4& a, const Float4x4& b);
+	Float4x4 LookAtRH(const Float3& eye, const Float3& target, const Float3& up);
+	Float4x4 PerspectiveFovRH(float fovY, float aspect, float nearZ, float farZ);
+
+	// Six planes (a, b, c, d), normalized and facing inwards: a point p is
+	// inside a plane when a * p.x + b * p.y + c * p.z + d >= 0.
+	struct Frustum
+	{
+		enum Plane { Left, Right, Bottom, Top, Near, Far, PlaneCount };
+
+		float planes[PlaneCount][4];
+
+		static Frustum FromViewProjection(const Float4x4& view, const Float4x4& projection);
+
+		bool ContainsSphere(const Float3& center, float radius) const;
+	};
+}
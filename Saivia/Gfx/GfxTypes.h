@@ -0,0 +1,46 @@
+//
+// GfxTypes.h - Plain float types shared by the device-independent render code
+//
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace Gfx
+{
+	struct Float3
+	{
+		float x, y, z;
+	};
+
+	// Row-vector matrix, same layout as DirectX::SimpleMath::Matrix.
+	struct Float4x4
+	{
+		float m[4][4];
+	};
+
+	// Per-instance world transform as the instanced vertex stream reads it:
+	// the 4x3 row-vector world matrix transposed into three float4 rows
+	// (HLSL float3x4), 48 bytes instead of 64.
+	struct InstanceTransform
+	{
+		float m[3][4];
+	};
+
+	// Vertex of the meshes generated on the CPU (track LOD and the like).
+	// color is RGBA8 with red in the lowest byte and tints the texture.
+	struct MeshVertex
+	{
+		Float3 position;
+		Float3 normal;
+		uint32_t color;
+		float u, v;
+	};
+
+	struct MeshData
+	{
+		std::vector<MeshVertex> vertices;
+		std::vector<uint32_t> indices;     // triangle list
+	};
+}
@@ -0,0 +1,81 @@
+//
+// InstanceBatcher.cpp
+//
+
+#include "InstanceBatcher.h"
+
+namespace Gfx
+{
+	void InstanceBatcher::Clear()
+	{
+		// Keep the per-model capacity, edits usually refill about as much
+		for (auto& instances : m_pending)
+		{
+			instances.clear();
+		}
+	}
+
+	InstanceTransform* InstanceBatcher::Append(uint32_t model, size_t count)
+	{
+		if (model >= m_pending.size())
+		{
+			m_pending.resize(model + 1);
+		}
+		auto& instances = m_pending[model];
+		size_t base = instances.size();
+		instances.resize(base + count);
+		return instances.data() + base;
+	}
+
+	void InstanceBatcher::AppendSleepers(uint32_t model, const SleeperChunks& chunks, const Track::Vec3& origin)
+	{
+		chunks.PackInstances(origin, Append(model, chunks.InstanceCount()));
+	}
+
+	void InstanceBatcher::Upload(RenderBackend& backend)
+	{
+		m_batches.clear();
+		size_t total = 0;
+		for (uint32_t model = 0; model < m_pending.size(); model++)
+		{
+			auto& instances = m_pending[model];
+			if (instances.empty())
+			{
+				continue;
+			}
+
+			Batch batch;
+			batch.model = model;
+			batch.firstInstance = static_cast<uint32_t>(total);
+			batch.count = static_cast<uint32_t>(instances.size());
+			m_batches.push_back(batch);
+			total += instances.size();
+		}
+		m_instanceCount = total;
+
+		// A single model (the usual sleeper-only route) is uploaded in place
+		if (m_batches.size() == 1)
+		{
+			auto& instances = m_pending[m_batches[0].model];
+			backend.UploadInstances(instances.data(), instances.size());
+			return;
+		}
+
+		m_packed.clear();
+		m_packed.reserve(total);
+		for (auto& batch : m_batches)
+		{
+			auto& instances = m_pending[batch.model];
+			m_packed.insert(m_packed.end(), instances.begin(), instances.end());
+		}
+		backend.UploadInstances(m_packed.data(), m_packed.size());
+	}
+
+	void InstanceBatcher::Draw(RenderBackend& backend) const
+	{
+		for (auto& batch : m_batches)
+		{
+			backend.DrawInstanced(batch.model, batch.firstInstance, batch.count);
+		}
+	}
+}
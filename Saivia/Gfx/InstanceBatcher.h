@@ -0,0 +1,47 @@
+//
+// InstanceBatcher.h - Packs instances of repeated models into one buffer, one draw per model
+//
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "RenderBackend.h"
+#include "SleeperChunks.h"
+
+namespace Gfx
+{
+	class InstanceBatcher
+	{
+	public:
+		struct Batch
+		{
+			uint32_t model;
+			uint32_t firstInstance;
+			uint32_t count;
+		};
+
+		void Clear();
+
+		// Room for count more instances of model; the caller fills them in.
+		InstanceTransform* Append(uint32_t model, size_t count);
+		void AppendSleepers(uint32_t model, const SleeperChunks& chunks, const Track::Vec3& origin);
+
+		// Groups the instances by model into one buffer and uploads it. Needed
+		// after an edit (or a move of the render origin), not every frame.
+		void Upload(RenderBackend& backend);
+
+		// One instanced draw per model from the last upload.
+		void Draw(RenderBackend& backend) const;
+
+		const std::vector<Batch>& Batches() const { return m_batches; }
+		size_t InstanceCount() const { return m_instanceCount; }
+
+	private:
+		std::vector<std::vector<InstanceTransform>> m_pending;  // per model id
+		std::vector<InstanceTransform> m_packed;                // several models, grouped
+		size_t m_instanceCount = 0;
+		std::vector<Batch> m_batches;
+	};
+}
@@ -0,0 +1,701 @@
+//
+// ObjImport.cpp
+//
+
+#include "ObjImport.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <unordered_map>
+
+#include "../Track/NumberParser.h"
+#include "../Track/Parallel.h"
+
+namespace Gfx
+{
+	namespace
+	{
+		// Smallest piece of text parsed by one work item
+		const size_t PIECE_SIZE = 1 << 20;
+
+		const int32_t NO_INDEX = INT32_MIN;
+		const uint32_t EMPTY = UINT32_MAX;
+
+		struct TexCoord
+		{
+			float u, v;
+		};
+
+		// v/vt/vn of a face corner, zero based; NO_INDEX where left out
+		struct Corner
+		{
+			int32_t v, vt, vn;
+
+			bool operator==(const Corner& other) const { return v == other.v && vt == other.vt && vn == other.vn; }
+		};
+
+		// What one piece of the text defines. Indices are absolute, except
+		// the negative (relative) ones: those are resolved against the
+		// piece's own counts and listed in relative, the counts of the
+		// pieces before are added once they are known.
+		struct Piece
+		{
+			const char* begin;
+			const char* end;
+			std::vector<Float3> positions;
+			std::vector<TexCoord> texcoords;
+			std::vector<Float3> normals;
+			std::vector<Corner> corners;
+			std::vector<uint32_t> faceSizes;                            // corners of each face
+			std::vector<std::pair<uint32_t, std::string>> materials;    // usemtl: first face, name
+			std::vector<std::string> libraries;
+			std::vector<uint32_t> relative;                             // corner * 3 + component
+			std::string error;
+		};
+
+		bool IsSpace(char c)
+		{
+			return c == ' ' || c == '\t' || c == '\r';
+		}
+
+		const char* SkipSpace(const char* p, const char* end)
+		{
+			while (p < end && IsSpace(*p))
+			{
+				p++;
+			}
+			return p;
+		}
+
+		const char* SkipToken(const char* p, const char* end)
+		{
+			while (p < end && !IsSpace(*p))
+			{
+				p++;
+			}
+			return p;
+		}
+
+		// The rest of the line without surrounding blanks
+		std::string RestOfLine(const char* p, const char* end)
+		{
+			p = SkipSpace(p, end);
+			while (end > p && IsSpace(end[-1]))
+			{
+				end--;
+			}
+			return std::string(p, end);
+		}
+
+		// Decimal float with optional sign and exponent
+		bool ParseFloat(const char*& p, const char* end, float& value)
+		{
+			const char* s = p;
+			bool negative = false;
+			if (s < end && (*s == '-' || *s == '+'))
+			{
+				negative = *s++ == '-';
+			}
+			double result;
+			if (!Track::ParseDecimal(s, end, result))
+			{
+				return false;
+			}
+			value = static_cast<float>(negative ? -result : result);
+			p = s;
+			return true;
+		}
+
+		bool ParseInt(const char*& p, const char* end, int64_t& value)
+		{
+			const char* s = p;
+			bool negative = false;
+			if (s < end && (*s == '-' || *s == '+'))
+			{
+				negative = *s++ == '-';
+			}
+			if (s == end || !Track::IsDecimalDigit(*s))
+			{
+				return false;
+			}
+			int64_t result = 0;
+			for (; s < end && Track::IsDecimalDigit(*s); s++)
+			{
+				result = std::min<int64_t>(result * 10 + (*s - '0'), INT32_MAX);
+			}
+			value = negative ? -result : result;
+			p = s;
+			return true;
+		}
+
+		// Up to count floats; the ones left out stay as they are
+		void ParseFloats(const char* p, const char* end, float* values, int count)
+		{
+			for (int n = 0; n < count; n++)
+			{
+				p = SkipSpace(p, end);
+				if (!ParseFloat(p, end, values[n]))
+				{
+					return;
+				}
+			}
+		}
+
+		std::string Excerpt(const char* begin, const char* end)
+		{
+			return std::string(begin, std::min<size_t>(end - begin, 80));
+		}
+
+		// One face corner: v, v/vt, v//vn or v/vt/vn
+		bool ParseCorner(const char*& p, const char* end, Piece& piece, Corner& corner)
+		{
+			size_t counts[3] = { piece.positions.size(), piece.texcoords.size(), piece.normals.size() };
+			int32_t* components[3] = { &corner.v, &corner.vt, &corner.vn };
+			corner = { NO_INDEX, NO_INDEX, NO_INDEX };
+			for (int c = 0; c < 3; c++)
+			{
+				if (c > 0)
+				{
+					if (p == end || *p != '/')
+					{
+						break;
+					}
+					p++;
+				}
+
+				int64_t index;
+				if (!ParseInt(p, end, index))
+				{
+					if (c == 0)
+					{
+						return false;
+					}
+					continue;                   // v//vn
+				}
+				if (index > 0)
+				{
+					*components[c] = static_cast<int32_t>(index - 1);
+				}
+				else if (index < 0)
+				{
+					*components[c] = static_cast<int32_t>(int64_t(counts[c]) + index);
+					piece.relative.push_back(static_cast<uint32_t>(piece.corners.size() * 3 + c));
+				}
+				else
+				{
+					return false;
+				}
+			}
+			return p == end || IsSpace(*p);
+		}
+
+		void ParseLine(const char* p, const char* end, Piece& piece)
+		{
+			const char* line = p = SkipSpace(p, end);
+			if (p == end || *p == '#')
+			{
+				return;
+			}
+			const char* keyword = p;
+			p = SkipToken(p, end);
+			size_t length = p - keyword;
+
+			if (length == 1 && keyword[0] == 'v')
+			{
+				float xyz[3] = { 0.f, 0.f, 0.f };
+				ParseFloats(p, end, xyz, 3);
+				piece.positions.push_back({ xyz[0], xyz[1], xyz[2] });
+			}
+			else if (length == 2 && keyword[0] == 'v' && keyword[1] == 't')
+			{
+				float uv[2] = { 0.f, 0.f };
+				ParseFloats(p, end, uv, 2);
+				piece.texcoords.push_back({ uv[0], uv[1] });
+			}
+			else if (length == 2 && keyword[0] == 'v' && keyword[1] == 'n')
+			{
+				float xyz[3] = { 0.f, 0.f, 0.f };
+				ParseFloats(p, end, xyz, 3);
+				piece.normals.push_back({ xyz[0], xyz[1], xyz[2] });
+			}
+			else if (length == 1 && keyword[0] == 'f')
+			{
+				size_t first = piece.corners.size();
+				for (p = SkipSpace(p, end); p < end; p = SkipSpace(p, end))
+				{
+					Corner corner;
+					if (!ParseCorner(p, end, piece, corner))
+					{
+						piece.error = "malformed face: " + Excerpt(line, end);
+						return;
+					}
+					piece.corners.push_back(corner);
+				}
+				size_t count = piece.corners.size() - first;
+				if (count < 3)
+				{
+					piece.error = "face with fewer than three corners: " + Excerpt(line, end);
+					return;
+				}
+				piece.faceSizes.push_back(static_cast<uint32_t>(count));
+			}
+			else if (length == 6 && !memcmp(keyword, "usemtl", 6))
+			{
+				piece.materials.emplace_back(static_cast<uint32_t>(piece.faceSizes.size()), RestOfLine(p, end));
+			}
+			else if (length == 6 && !memcmp(keyword, "mtllib", 6))
+			{
+				piece.libraries.push_back(RestOfLine(p, end));
+			}
+			// Groups, objects, smoothing groups, lines and points do not
+			// change the triangles
+		}
+
+		void ParsePiece(Piece& piece)
+		{
+			for (const char* p = piece.begin; p < piece.end && piece.error.empty();)
+			{
+				auto lineEnd = static_cast<const char*>(memchr(p, '\n', piece.end - p));
+				if (!lineEnd)
+				{
+					lineEnd = piece.end;
+				}
+				ParseLine(p, lineEnd, piece);
+				p = lineEnd + 1;
+			}
+		}
+
+		// Pieces of about equal size, each ending after a newline
+		std::vector<Piece> SplitText(const char* text, size_t size)
+		{
+			size_t count = std::max<size_t>(1, std::min(size / PIECE_SIZE, Track::ThreadPool::Shared().Size() * 4));
+			std::vector<Piece> pieces;
+			const char* begin = text;
+			const char* end = text + size;
+			for (size_t n = 1; n <= count && begin < end; n++)
+			{
+				const char* split = end;
+				if (n < count)
+				{
+					split = std::max(begin, text + size * n / count);
+					auto newline = static_cast<const char*>(memchr(split, '\n', end - split));
+					split = newline ? newline + 1 : end;
+				}
+				Piece piece;
+				piece.begin = begin;
+				piece.end = split;
+				pieces.push_back(std::move(piece));
+				begin = split;
+			}
+			return pieces;
+		}
+
+		template <typename T>
+		void Append(std::vector<T>& to, std::vector<T>& from)
+		{
+			to.insert(to.end(), from.begin(), from.end());
+			std::vector<T>().swap(from);
+		}
+
+		uint32_t HashCorner(const Corner& corner)
+		{
+			uint64_t h = uint32_t(corner.v) * 0x9e3779b97f4a7c15ull;
+			h ^= uint32_t(corner.vt) * 0xc2b2ae3d27d4eb4full;
+			h ^= uint32_t(corner.vn) * 0x165667b19e3779f9ull;
+			return static_cast<uint32_t>(h >> 32);
+		}
+
+		Float3 Subtract(const Float3& a, const Float3& b)
+		{
+			return { a.x - b.x, a.y - b.y, a.z - b.z };
+		}
+
+		Float3 Cross(const Float3& a, const Float3& b)
+		{
+			return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+		}
+
+		std::vector<char> ReadText(const std::filesystem::path& path)
+		{
+			std::ifstream file(path, std::ios::binary | std::ios::ate);
+			if (!file)
+			{
+				throw std::runtime_error("Cannot open " + path.u8string());
+			}
+			std::vector<char> text(static_cast<size_t>(file.tellg()));
+			file.seekg(0);
+			file.read(text.data(), text.size());
+			if (!file)
+			{
+				throw std::runtime_error("Cannot read " + path.u8string());
+			}
+			return text;
+		}
+
+		// map_Kd options (-s 1 1 1, -clamp on, ...) come before the file name
+		std::string TextureName(const char* p, const char* end)
+		{
+			for (p = SkipSpace(p, end); p < end && *p == '-'; p = SkipSpace(p, end))
+			{
+				p = SkipToken(p, end);
+				for (;;)
+				{
+					const char* argument = SkipSpace(p, end);
+					const char* argumentEnd = SkipToken(argument, end);
+					float number;
+					const char* q = argument;
+					bool isNumber = ParseFloat(q, argumentEnd, number) && q == argumentEnd;
+					std::string word(argument, argumentEnd);
+					if (argument == end || !(isNumber || word == "on" || word == "off"))
+					{
+						break;
+					}
+					p = argumentEnd;
+				}
+			}
+			return RestOfLine(p, end);
+		}
+	}
+
+	ObjModel ParseObj(const char* text, size_t size, std::vector<std::string>& libraries, const ObjOptions& options)
+	{
+		auto pieces = SplitText(text, size);
+		Track::ParallelFor(pieces.size(), [&](size_t n) { ParsePiece(pieces[n]); });
+		for (auto& piece : pieces)
+		{
+			if (!piece.error.empty())
+			{
+				throw std::runtime_error("OBJ: " + piece.error);
+			}
+		}
+
+		// Counts before each piece
+		struct Base
+		{
+			size_t positions, texcoords, normals;
+		};
+		std::vector<Base> bases(pieces.size());
+		Base total = { 0, 0, 0 };
+		for (size_t n = 0; n < pieces.size(); n++)
+		{
+			bases[n] = total;
+			total.positions += pieces[n].positions.size();
+			total.texcoords += pieces[n].texcoords.size();
+			total.normals += pieces[n].normals.size();
+		}
+		if (total.positions > size_t(INT32_MAX) || total.texcoords > size_t(INT32_MAX) || total.normals > size_t(INT32_MAX))
+		{
+			throw std::runtime_error("OBJ: too many vertices");
+		}
+
+		Track::ParallelFor(pieces.size(), [&](size_t n)
+		{
+			auto& piece = pieces[n];
+			int32_t offsets[3] = { int32_t(bases[n].positions), int32_t(bases[n].texcoords), int32_t(bases[n].normals) };
+			for (auto r : piece.relative)
+			{
+				auto& corner = piece.corners[r / 3];
+				int32_t* components[3] = { &corner.v, &corner.vt, &corner.vn };
+				*components[r % 3] += offsets[r % 3];
+			}
+			for (auto& corner : piece.corners)
+			{
+				if (corner.v < 0 || size_t(corner.v) >= total.positions ||
+					(corner.vt != NO_INDEX && (corner.vt < 0 || size_t(corner.vt) >= total.texcoords)) ||
+					(corner.vn != NO_INDEX && (corner.vn < 0 || size_t(corner.vn) >= total.normals)))
+				{
+					piece.error = "face index out of range";
+					return;
+				}
+			}
+		});
+
+		std::vector<Float3> positions, normals;
+		std::vector<TexCoord> texcoords;
+		positions.reserve(total.positions);
+		texcoords.reserve(total.texcoords);
+		normals.reserve(total.normals);
+
+		// Material of each face, by name in order of first use
+		ObjModel model;
+		model.materials.emplace_back();
+		std::unordered_map<std::string, uint32_t> materialIndex;
+		uint32_t material = 0;
+		auto useMaterial = [&](const std::string& name)
+		{
+			auto found = materialIndex.emplace(name, static_cast<uint32_t>(model.materials.size()));
+			if (found.second)
+			{
+				model.materials.emplace_back();
+				model.materials.back().name = name;
+			}
+			material = found.first->second;
+		};
+
+		std::vector<uint32_t> faceSizes, faceMaterials;
+		std::vector<Corner> corners;
+		for (auto& piece : pieces)
+		{
+			if (!piece.error.empty())
+			{
+				throw std::runtime_error("OBJ: " + piece.error);
+			}
+
+			size_t next = 0;
+			for (uint32_t face = 0; face < piece.faceSizes.size(); face++)
+			{
+				for (; next < piece.materials.size() && piece.materials[next].first == face; next++)
+				{
+					useMaterial(piece.materials[next].second);
+				}
+				faceMaterials.push_back(material);
+			}
+			for (; next < piece.materials.size(); next++)
+			{
+				useMaterial(piece.materials[next].second);
+			}
+
+			Append(faceSizes, piece.faceSizes);
+			Append(corners, piece.corners);
+			Append(positions, piece.positions);
+			Append(texcoords, piece.texcoords);
+			Append(normals, piece.normals);
+			libraries.insert(libraries.end(), piece.libraries.begin(), piece.libraries.end());
+		}
+
+		// Fans, grouped by material; each index first holds the corner it
+		// is made from
+		std::vector<size_t> cursors(model.materials.size(), 0);
+		for (size_t face = 0; face < faceSizes.size(); face++)
+		{
+			cursors[faceMaterials[face]] += (faceSizes[face] - 2) * 3;
+		}
+		size_t indexCount = 0;
+		for (uint32_t m = 0; m < model.materials.size(); m++)
+		{
+			size_t count = cursors[m];
+			cursors[m] = indexCount;
+			if (count > 0)
+			{
+				model.subsets.push_back({ m, static_cast<uint32_t>(indexCount), static_cast<uint32_t>(count) });
+			}
+			indexCount += count;
+		}
+		if (indexCount > UINT32_MAX)
+		{
+			throw std::runtime_error("OBJ: too many triangles");
+		}
+
+		auto& indices = model.indices;
+		indices.resize(indexCount);
+		uint32_t first = 0;
+		for (size_t face = 0; face < faceSizes.size(); face++)
+		{
+			auto& cursor = cursors[faceMaterials[face]];
+			for (uint32_t k = 1; k + 1 < faceSizes[face]; k++)
+			{
+				indices[cursor++] = first;
+				indices[cursor++] = first + k;
+				indices[cursor++] = first + k + 1;
+			}
+			first += faceSizes[face];
+		}
+
+		// One vertex per distinct corner, numbered in order of first use.
+		// The table holds vertex numbers, the keys are looked up in keys.
+		size_t capacity = 16;
+		while (capacity < std::min(indexCount, corners.size()) * 2)
+		{
+			capacity *= 2;
+		}
+		size_t mask = capacity - 1;
+		std::vector<uint32_t> table(capacity, EMPTY);
+		std::vector<Corner> keys;
+		for (auto& index : indices)
+		{
+			const Corner& corner = corners[index];
+			size_t slot = HashCorner(corner) & mask;
+			while (table[slot] != EMPTY && !(keys[table[slot]] == corner))
+			{
+				slot = (slot + 1) & mask;
+			}
+			if (table[slot] == EMPTY)
+			{
+				table[slot] = static_cast<uint32_t>(keys.size());
+				keys.push_back(corner);
+			}
+			index = table[slot];
+		}
+		std::vector<uint32_t>().swap(table);
+		std::vector<Corner>().swap(corners);
+
+		// Area weighted face normals summed per position, for the corners
+		// that have none
+		std::vector<Float3> smoothed;
+		if (std::any_of(keys.begin(), keys.end(), [](const Corner& key) { return key.vn == NO_INDEX; }))
+		{
+			smoothed.assign(positions.size(), { 0.f, 0.f, 0.f });
+			for (size_t i = 0; i + 2 < indices.size(); i += 3)
+			{
+				int32_t v[3] = { keys[indices[i]].v, keys[indices[i + 1]].v, keys[indices[i + 2]].v };
+				auto normal = Cross(Subtract(positions[v[1]], positions[v[0]]), Subtract(positions[v[2]], positions[v[0]]));
+				for (auto p : v)
+				{
+					smoothed[p].x += normal.x;
+					smoothed[p].y += normal.y;
+					smoothed[p].z += normal.z;
+				}
+			}
+			for (auto& normal : smoothed)
+			{
+				float length = std::sqrt(normal.x * normal.x + normal.y * normal.y + normal.z * normal.z);
+				normal = length > 0.f ? Float3{ normal.x / length, normal.y / length, normal.z / length } : Float3{ 0.f, 1.f, 0.f };
+			}
+		}
+
+		model.vertices.resize(keys.size());
+		for (size_t n = 0; n < keys.size(); n++)
+		{
+			auto& key = keys[n];
+			auto& vertex = model.vertices[n];
+			vertex.position = positions[key.v];
+			vertex.normal = key.vn != NO_INDEX ? normals[key.vn] : smoothed[key.v];
+			TexCoord texcoord = key.vt != NO_INDEX ? texcoords[key.vt] : TexCoord{ 0.f, 0.f };
+			vertex.u = options.flipU ? 1.f - texcoord.u : texcoord.u;
+			vertex.v = options.flipV ? 1.f - texcoord.v : texcoord.v;
+		}
+
+		if (!model.vertices.empty())
+		{
+			model.boundsMin = model.boundsMax = model.vertices[0].position;
+			for (auto& vertex : model.vertices)
+			{
+				auto& p = vertex.position;
+				model.boundsMin = { std::min(model.boundsMin.x, p.x), std::min(model.boundsMin.y, p.y), std::min(model.boundsMin.z, p.z) };
+				model.boundsMax = { std::max(model.boundsMax.x, p.x), std::max(model.boundsMax.y, p.y), std::max(model.boundsMax.z, p.z) };
+			}
+		}
+		return model;
+	}
+
+	void ParseMtl(const char* text, size_t size, std::vector<ObjMaterial>& materials)
+	{
+		ObjMaterial* material = nullptr;
+		const char* end = text + size;
+		for (const char* p = text; p < end;)
+		{
+			auto lineEnd = static_cast<const char*>(memchr(p, '\n', end - p));
+			if (!lineEnd)
+			{
+				lineEnd = end;
+			}
+			const char* keyword = SkipSpace(p, lineEnd);
+			const char* q = SkipToken(keyword, lineEnd);
+			std::string name(keyword, q);
+			p = lineEnd + 1;
+
+			if (name == "newmtl")
+			{
+				materials.emplace_back();
+				material = &materials.back();
+				material->name = RestOfLine(q, lineEnd);
+				continue;
+			}
+			if (!material)
+			{
+				continue;
+			}
+
+			// A single value stands for all three channels
+			auto color = [&](Float3& value)
+			{
+				float rgb[3] = { NAN, NAN, NAN };
+				ParseFloats(q, lineEnd, rgb, 3);
+				if (!std::isnan(rgb[0]))
+				{
+					value = std::isnan(rgb[1]) ? Float3{ rgb[0], rgb[0], rgb[0] } : Float3{ rgb[0], rgb[1], rgb[2] };
+				}
+			};
+			float value = NAN;
+			if (name == "Ka")
+			{
+				color(material->ambient);
+			}
+			else if (name == "Kd")
+			{
+				color(material->diffuse);
+			}
+			else if (name == "Ks")
+			{
+				color(material->specular);
+			}
+			else if (name == "Ke")
+			{
+				color(material->emissive);
+			}
+			else if (name == "Ns")
+			{
+				ParseFloats(q, lineEnd, &material->shininess, 1);
+			}
+			else if (name == "d")
+			{
+				ParseFloats(q, lineEnd, &material->alpha, 1);
+			}
+			else if (name == "Tr")
+			{
+				ParseFloats(q, lineEnd, &value, 1);
+				if (!std::isnan(value))
+				{
+					material->alpha = 1.f - value;
+				}
+			}
+			else if (name == "illum")
+			{
+				ParseFloats(q, lineEnd, &value, 1);
+				material->specularLit = value == 2.f;
+			}
+			else if (name == "map_Kd")
+			{
+				material->diffuseTexture = TextureName(q, lineEnd);
+			}
+		}
+	}
+
+	void ApplyMaterials(ObjModel& model, const std::vector<ObjMaterial>& library)
+	{
+		for (size_t m = 1; m < model.materials.size(); m++)
+		{
+			auto& material = model.materials[m];
+			auto found = std::find_if(library.begin(), library.end(),
+				[&material](const ObjMaterial& defined) { return defined.name == material.name; });
+			if (found != library.end())
+			{
+				material = *found;
+			}
+		}
+	}
+
+	ObjModel LoadObj(const std::filesystem::path& path, const ObjOptions& options)
+	{
+		auto text = ReadText(path);
+		std::vector<std::string> libraries;
+		auto model = ParseObj(text.data(), text.size(), libraries, options);
+
+		std::vector<ObjMaterial> library;
+		for (auto& name : libraries)
+		{
+			auto mtlPath = path.parent_path() / std::filesystem::u8path(name);
+			std::error_code error;
+			if (std::filesystem::exists(mtlPath, error))
+			{
+				auto mtl = ReadText(mtlPath);
+				ParseMtl(mtl.data(), mtl.size(), library);
+			}
+		}
+		ApplyMaterials(model, library);
+		return model;
+	}
+}
@@ -0,0 +1,86 @@
+//
+// ObjImport.h - Wavefront OBJ / MTL reader producing indexed triangle lists
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "GfxTypes.h"
+
+namespace Gfx
+{
+	// Vertex as the converted models store it: the SDKMESH stream
+	// position / normal / texcoord, 32 bytes.
+	struct ObjVertex
+	{
+		Float3 position;
+		Float3 normal;
+		float u, v;
+	};
+
+	struct ObjMaterial
+	{
+		std::string name;
+		Float3 ambient = { 0.2f, 0.2f, 0.2f };
+		Float3 diffuse = { 0.8f, 0.8f, 0.8f };
+		Float3 specular = { 0.f, 0.f, 0.f };
+		Float3 emissive = { 0.f, 0.f, 0.f };
+		float alpha = 1.f;                  // d, or 1 - Tr
+		float shininess = 0.f;              // Ns
+		bool specularLit = false;           // illum 2
+		std::string diffuseTexture;         // map_Kd, relative to the MTL file
+	};
+
+	// Triangles of one material, a range of ObjModel::indices
+	struct ObjSubset
+	{
+		uint32_t material;
+		uint32_t indexStart;
+		uint32_t indexCount;
+	};
+
+	struct ObjModel
+	{
+		std::vector<ObjVertex> vertices;    // one per distinct v/vt/vn triple
+		std::vector<uint32_t> indices;      // triangle list, OBJ winding
+		std::vector<ObjSubset> subsets;     // one per material in use, in material order
+		std::vector<ObjMaterial> materials; // [0] is the default material of faces before any usemtl
+		Float3 boundsMin = { 0.f, 0.f, 0.f };
+		Float3 boundsMax = { 0.f, 0.f, 0.f };
+	};
+
+	// Texture coordinates as the editor's models have always been made:
+	// meshconvert -sdkmesh -nodds -flipv (tool/cmd.txt) stores (1 - u, v),
+	// and tool/cup.sdkmesh is its output for tool/cup._obj.
+	struct ObjOptions
+	{
+		bool flipU = true;
+		bool flipV = false;
+	};
+
+	// Parses OBJ text. The text is split at line boundaries and the pieces
+	// are parsed on the shared thread pool; polygons are triangulated as
+	// fans and corners with the same v/vt/vn triple share a vertex (found
+	// through a hash table). Corners without a normal get the smoothed
+	// normal of their position. Materials only carry their names: the MTL
+	// files named by mtllib are returned in libraries, for the caller to
+	// read with ParseMtl and apply with ApplyMaterials. Throws
+	// std::runtime_error on malformed faces and out of range indices.
+	ObjModel ParseObj(const char* text, size_t size, std::vector<std::string>& libraries, const ObjOptions& options = {});
+
+	// Appends the materials defined in MTL text
+	void ParseMtl(const char* text, size_t size, std::vector<ObjMaterial>& materials);
+
+	// Fills in the materials of model, found by name in library; a material
+	// the library does not define keeps the defaults.
+	void ApplyMaterials(ObjModel& model, const std::vector<ObjMaterial>& library);
+
+	// Reads path and the MTL files next to it. A missing MTL file is not an
+	// error, its materials keep the defaults.
+	ObjModel LoadObj(const std::filesystem::path& path, const ObjOptions& options = {});
+}
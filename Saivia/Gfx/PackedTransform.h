@@ -0,0 +1,89 @@
+//
+// PackedTransform.h - Quantized sleeper rotation (8 bytes instead of a 3x3 float block)
+//
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include "../Track/TrackMath.h"
+#include "GfxTypes.h"
+
+namespace Gfx
+{
+	// Unit quaternion, every component as a 16 bit signed normalized value
+	// (about 3e-5 per component, well under a hundredth of a degree).
+	struct PackedRotation
+	{
+		int16_t x, y, z, w;
+	};
+
+	// Rotation whose matrix rows (row-vector convention) are B, N, T.
+	inline PackedRotation PackRotation(const Track::Vec3& B, const Track::Vec3& N, const Track::Vec3& T)
+	{
+		// m[i][j] with rows B N T; standard branch on the largest diagonal term
+		double m00 = B.x, m01 = B.y, m02 = B.z;
+		double m10 = N.x, m11 = N.y, m12 = N.z;
+		double m20 = T.x, m21 = T.y, m22 = T.z;
+
+		double x, y, z, w;
+		double trace = m00 + m11 + m22;
+		if (trace > 0.0)
+		{
+			double s = 0.5 / std::sqrt(trace + 1.0);
+			w = 0.25 / s;
+			x = (m12 - m21) * s;
+			y = (m20 - m02) * s;
+			z = (m01 - m10) * s;
+		}
+		else if (m00 > m11 && m00 > m22)
+		{
+			double s = 2.0 * std::sqrt(1.0 + m00 - m11 - m22);
+			w = (m12 - m21) / s;
+			x = 0.25 * s;
+			y = (m10 + m01) / s;
+			z = (m20 + m02) / s;
+		}
+		else if (m11 > m22)
+		{
+			double s = 2.0 * std::sqrt(1.0 + m11 - m00 - m22);
+			w = (m20 - m02) / s;
+			x = (m10 + m01) / s;
+			y = 0.25 * s;
+			z = (m21 + m12) / s;
+		}
+		else
+		{
+			double s = 2.0 * std::sqrt(1.0 + m22 - m00 - m11);
+			w = (m01 - m10) / s;
+			x = (m20 + m02) / s;
+			y = (m21 + m12) / s;
+			z = 0.25 * s;
+		}
+
+		double length = std::sqrt(x * x + y * y + z * z + w * w);
+		auto quantize = [length](double v)
+		{
+			return static_cast<int16_t>(std::lround(std::min(std::max(v / length, -1.0), 1.0) * 32767.0));
+		};
+		return { quantize(x), quantize(y), quantize(z), quantize(w) };
+	}
+
+	// Back to the B N T rows. The quaternion is renormalized so the rows stay
+	// orthonormal whatever the rounding.
+	inline void UnpackRotation(const PackedRotation& q, Float3& B, Float3& N, Float3& T)
+	{
+		float x = q.x, y = q.y, z = q.z, w = q.w;
+		float scale = 2.f / (x * x + y * y + z * z + w * w);
+
+		float xx = x * x * scale, yy = y * y * scale, zz = z * z * scale;
+		float xy = x * y * scale, xz = x * z * scale, yz = y * z * scale;
+		float wx = w * x * scale, wy = w * y * scale, wz = w * z * scale;
+
+		B = { 1.f - yy - zz, xy + wz, xz - wy };
+		N = { xy - wz, 1.f - xx - zz, yz + wx };
+		T = { xz + wy, yz - wx, 1.f - xx - yy };
+	}
+}
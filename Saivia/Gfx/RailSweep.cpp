@@ -0,0 +1,302 @@
+//
+// RailSweep.cpp
+//
+
+#include "RailSweep.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "../Track/Parallel.h"
+
+namespace Gfx
+{
+	namespace
+	{
+		const double TEXTURE_LENGTH = 2.0;    // metres along the rail per texture repeat
+
+		// Points checked against the chord: both rail heads
+		const double CHECK_X = RAIL_GAUGE * 0.5 + 0.035;
+		const double CHECK_Y = RAIL_BASE + 0.16;
+
+		Float3 ToFloat(const Track::Vec3& v)
+		{
+			return { float(v.x), float(v.y), float(v.z) };
+		}
+
+		double ChordError(const Track::Frame& a, const Track::Frame& middle, const Track::Frame& b)
+		{
+			double error = 0.0;
+			for (double x : { -CHECK_X, CHECK_X })
+			{
+				auto point = [x](const Track::Frame& f) { return f.Pos + f.B * x + f.N * CHECK_Y; };
+				Track::Vec3 chord = (point(a) + point(b)) * 0.5;
+				error = std::max(error, (point(middle) - chord).Length());
+			}
+			return error;
+		}
+
+		struct Sampler
+		{
+			const Track::Alignment& alignment;
+			const Track::Vec3& origin;
+			double s0;
+			std::vector<RailSection>& sections;
+
+			void Add(double s, const Track::Frame& frame)
+			{
+				RailSection section;
+				section.position = ToFloat(frame.Pos - origin);
+				section.B = ToFloat(frame.B);
+				section.N = ToFloat(frame.N);
+				section.distance = float(s - s0);
+				sections.push_back(section);
+			}
+
+			// Adds the sections in (a, b], halving the step while its midpoint
+			// is off the chord
+			void Refine(double a, const Track::Frame& fa, double b, const Track::Frame& fb)
+			{
+				if (b - a > RailSweep::MIN_STEP)
+				{
+					double middle = 0.5 * (a + b);
+					Track::Frame fm = alignment.FrameAt(middle);
+					if (ChordError(fa, fm, fb) > RailSweep::CHORD_TOLERANCE)
+					{
+						Refine(a, fa, middle, fm);
+						Refine(middle, fm, b, fb);
+						return;
+					}
+				}
+				Add(b, fb);
+			}
+		};
+	}
+
+	RailProfile RailProfile::FlatBottom()
+	{
+		RailProfile profile;
+		profile.outline =
+		{
+			{ -0.070f, 0.f }, { -0.070f, 0.011f }, { -0.008f, 0.030f }, { -0.008f, 0.115f },
+			{ -0.035f, 0.125f }, { -0.035f, 0.150f }, { -0.025f, 0.159f },
+			{ 0.025f, 0.159f }, { 0.035f, 0.150f }, { 0.035f, 0.125f },
+			{ 0.008f, 0.115f }, { 0.008f, 0.030f }, { 0.070f, 0.011f }, { 0.070f, 0.f },
+		};
+		profile.headWidth = 0.07f;
+		profile.color = 0xffa8a8a8;
+		return profile;
+	}
+
+	void RailSweep::Sample(const Track::Alignment& alignment, double s0, double s1, const Track::Vec3& origin, RailChunk& chunk)
+	{
+		chunk.s0 = s0;
+		chunk.sections.clear();
+		if (!(s1 > s0))
+		{
+			return;
+		}
+
+		// Segment and vertical profile piece boundaries are always sampled:
+		// between them curvature, cant and grade change smoothly. A segment
+		// start remembers its segment, the pose may jump there.
+		struct Break
+		{
+			double s;
+			size_t segment;
+			bool operator<(const Break& other) const { return s < other.s; }
+		};
+		const size_t NO_SEGMENT = SIZE_MAX;
+		std::vector<Break> breaks = { { s1, NO_SEGMENT } };
+		auto& segments = alignment.Segments();
+		for (size_t n = alignment.FindSegment(s0) + 1; n < segments.size() && segments[n].s0 < s1; n++)
+		{
+			breaks.push_back({ segments[n].s0, n });
+		}
+		auto& pieces = alignment.Profile().Pieces();
+		for (size_t n = alignment.Profile().Find(s0) + 1; n < pieces.size() && pieces[n].s0 < s1; n++)
+		{
+			breaks.push_back({ pieces[n].s0, NO_SEGMENT });
+		}
+		std::sort(breaks.begin(), breaks.end());
+
+		Sampler sampler = { alignment, origin, s0, chunk.sections };
+		Track::Frame last = alignment.FrameAt(s0);
+		double at = s0;
+		sampler.Add(s0, last);
+		for (auto& b : breaks)
+		{
+			double end = b.s;
+			if (end - at < 1e-6)
+			{
+				continue;
+			}
+
+			// Sampled up to the end of the previous segment; where its end
+			// pose differs from the next start (a cant step without a
+			// transition), both get a section
+			Track::Frame endFrame = alignment.FrameAt(end);
+			Track::Frame before = endFrame;
+			if (b.segment != NO_SEGMENT)
+			{
+				auto& previous = segments[b.segment - 1];
+				Track::Pose pose = Track::Alignment::Evaluate(previous, previous.length);
+				alignment.Profile().Evaluate(end, pose.Pos.y, pose.grade);
+				before = Track::MakeFrame(pose);
+			}
+
+			double steps = std::ceil((end - at) / MAX_STEP);
+			double step = (end - at) / steps;
+			double start = at;
+			for (double n = 1; n <= steps; n++)
+			{
+				double s = n == steps ? end : start + step * n;
+				Track::Frame frame = n == steps ? before : alignment.FrameAt(s);
+				sampler.Refine(at, last, s, frame);
+				at = s;
+				last = frame;
+			}
+			if ((before.N - endFrame.N).Length() + (before.Pos - endFrame.Pos).Length() > 1e-6)
+			{
+				sampler.Add(end, endFrame);
+				last = endFrame;
+			}
+		}
+	}
+
+	void RailSweep::SampleChunks(const Track::TrackGraph& graph, const SleeperChunks& sleepers,
+		const std::vector<SleeperChunks::Change>& changes)
+	{
+		struct Job
+		{
+			uint32_t edge;
+			size_t index;
+		};
+		std::vector<Job> jobs;
+		for (auto& change : changes)
+		{
+			size_t count = sleepers.EdgeChunks(change.edge).size();
+			m_chunks[change.edge].resize(count);
+			for (size_t c = change.firstChunk; c < count; c++)
+			{
+				jobs.push_back({ change.edge, c });
+			}
+		}
+
+		Track::ParallelFor(jobs.size(), [&](size_t j)
+		{
+			auto& job = jobs[j];
+			auto& chunk = sleepers.EdgeChunks(job.edge)[job.index];
+			auto& alignment = graph.Alignments()[graph.Edges()[job.edge].railway];
+			Sample(alignment, chunk.s0, chunk.s1, chunk.origin, m_chunks[job.edge][job.index]);
+		});
+	}
+
+	void RailSweep::Rebuild(const Track::TrackGraph& graph, const SleeperChunks& sleepers)
+	{
+		m_chunks.assign(sleepers.EdgeCount(), std::vector<RailChunk>());
+		std::vector<SleeperChunks::Change> changes;
+		for (uint32_t e = 0; e < sleepers.EdgeCount(); e++)
+		{
+			changes.push_back({ e, 0 });
+		}
+		SampleChunks(graph, sleepers, changes);
+	}
+
+	void RailSweep::Update(const Track::TrackGraph& graph, const SleeperChunks& sleepers)
+	{
+		if (m_chunks.size() != sleepers.EdgeCount())
+		{
+			Rebuild(graph, sleepers);
+			return;
+		}
+		SampleChunks(graph, sleepers, sleepers.Changes());
+	}
+
+	size_t RailSweep::SectionCount() const
+	{
+		size_t count = 0;
+		for (auto& edge : m_chunks)
+		{
+			for (auto& chunk : edge)
+			{
+				count += chunk.sections.size();
+			}
+		}
+		return count;
+	}
+
+	void RailSweep::BuildMesh(const RailChunk& chunk, const RailProfile& profile, int rail, MeshData& mesh)
+	{
+		mesh.vertices.clear();
+		mesh.indices.clear();
+		auto& sections = chunk.sections;
+		auto& outline = profile.outline;
+		if (sections.size() < 2 || outline.size() < 2)
+		{
+			return;
+		}
+
+		float centre = float(RAIL_GAUGE * 0.5) + profile.headWidth * 0.5f;
+		if (rail == 0)
+		{
+			centre = -centre;
+		}
+
+		// u runs around the outline, v follows the chainage so that the
+		// texture continues over chunk boundaries
+		std::vector<float> u(outline.size(), 0.f);
+		for (size_t p = 1; p < outline.size(); p++)
+		{
+			float dx = outline[p].x - outline[p - 1].x, dy = outline[p].y - outline[p - 1].y;
+			u[p] = u[p - 1] + std::sqrt(dx * dx + dy * dy);
+		}
+		for (auto& value : u)
+		{
+			value /= u.back();
+		}
+		float vStart = float(std::fmod(chunk.s0, TEXTURE_LENGTH) / TEXTURE_LENGTH);
+
+		mesh.vertices.reserve(sections.size() * (outline.size() - 1) * 2);
+		mesh.indices.reserve((sections.size() - 1) * (outline.size() - 1) * 6);
+
+		// Every face of the outline is a band of quads with a flat normal
+		for (size_t face = 0; face + 1 < outline.size(); face++)
+		{
+			auto& a = outline[face];
+			auto& b = outline[face + 1];
+			float dx = b.x - a.x, dy = b.y - a.y;
+			float length = std::sqrt(dx * dx + dy * dy);
+			float nx = -dy / length, ny = dx / length;
+
+			uint32_t base = static_cast<uint32_t>(mesh.vertices.size());
+			for (auto& section : sections)
+			{
+				auto& B = section.B;
+				auto& N = section.N;
+				Float3 normal = { B.x * nx + N.x * ny, B.y * nx + N.y * ny, B.z * nx + N.z * ny };
+				float v = vStart + section.distance / float(TEXTURE_LENGTH);
+				for (size_t p = face; p <= face + 1; p++)
+				{
+					float x = centre + outline[p].x;
+					float y = RAIL_BASE + outline[p].y;
+					MeshVertex vertex;
+					vertex.position = {
+						section.position.x + B.x * x + N.x * y,
+						section.position.y + B.y * x + N.y * y,
+						section.position.z + B.z * x + N.z * y };
+					vertex.normal = normal;
+					vertex.color = profile.color;
+					vertex.u = u[p];
+					vertex.v = v;
+					mesh.vertices.push_back(vertex);
+				}
+			}
+			for (uint32_t s = 0; s + 1 < sections.size(); s++)
+			{
+				uint32_t i = base + s * 2;
+				mesh.indices.insert(mesh.indices.end(), { i, i + 2, i + 1, i + 1, i + 2, i + 3 });
+			}
+		}
+	}
+}
@@ -0,0 +1,88 @@
+//
+// RailSweep.h - Continuous rail meshes swept along the alignment
+//
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "../Track/TrackGraph.h"
+#include "GfxTypes.h"
+#include "SleeperChunks.h"
+
+namespace Gfx
+{
+	const double RAIL_GAUGE = 1.435;    // between the inner edges of the rail heads
+	const float RAIL_BASE = 0.2f;       // rail foot above the sleeper frame origin (sleeper top)
+
+	// Cross section of one rail in the sleeper frame, x along B and y along N,
+	// relative to the centre of the rail foot. The outline runs from the
+	// left foot edge over the head to the right foot edge (clockwise, so the
+	// face normals (-dy, dx) point outwards); the underside is left open.
+	struct RailProfile
+	{
+		struct Point
+		{
+			float x, y;
+		};
+
+		std::vector<Point> outline;
+		float headWidth = 0.f;      // the gauge is measured at the head's inner edge
+		uint32_t color = 0xffffffff;
+
+		// Simplified flat-bottom rail, 159 mm high (close to 54E1)
+		static RailProfile FlatBottom();
+	};
+
+	// Centre-line cross section of the sweep, relative to the chunk origin.
+	struct RailSection
+	{
+		Float3 position;
+		Float3 B, N;
+		float distance;             // chainage from the chunk's s0
+	};
+
+	// The sections of one sleeper chunk: its chainage range [s0, s1] sampled
+	// adaptively. Both ends are evaluated at exactly the chunk boundary, so
+	// the meshes of neighbouring chunks meet without a gap or overlap.
+	struct RailChunk
+	{
+		double s0 = 0.0;
+		std::vector<RailSection> sections;
+	};
+
+	// Rail geometry of every sleeper chunk, indexed like SleeperChunks. Only
+	// the sections are kept; meshes are extruded from them on demand.
+	class RailSweep
+	{
+	public:
+		// The midpoint of a sampling step may lie at most CHORD_TOLERANCE off
+		// the straight line between its ends, measured at both rail heads (so
+		// curvature, cant and vertical curves all refine the sampling).
+		static constexpr double CHORD_TOLERANCE = 0.002;
+		static constexpr double MAX_STEP = 25.0;
+		static constexpr double MIN_STEP = 0.25;
+
+		// Samples every chunk, in parallel on the shared pool.
+		void Rebuild(const Track::TrackGraph& graph, const SleeperChunks& sleepers);
+
+		// Resamples the chunks sleepers.Changes() reports, to be called right
+		// after sleepers.Update(graph).
+		void Update(const Track::TrackGraph& graph, const SleeperChunks& sleepers);
+
+		const RailChunk& GetChunk(uint32_t edge, size_t index) const { return m_chunks[edge][index]; }
+		size_t SectionCount() const;
+
+		// Sections of the alignment over [s0, s1], relative to origin.
+		static void Sample(const Track::Alignment& alignment, double s0, double s1, const Track::Vec3& origin, RailChunk& chunk);
+
+		// One rail of a chunk as a mesh: 0 on the -B side, 1 on the +B side.
+		static void BuildMesh(const RailChunk& chunk, const RailProfile& profile, int rail, MeshData& mesh);
+
+	private:
+		void SampleChunks(const Track::TrackGraph& graph, const SleeperChunks& sleepers, const std::vector<SleeperChunks::Change>& changes);
+
+		std::vector<std::vector<RailChunk>> m_chunks;   // per edge
+	};
+}
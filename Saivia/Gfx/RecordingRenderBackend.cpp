@@ -0,0 +1,168 @@
+//
+// RecordingRenderBackend.cpp
+//
+
+#include "RecordingRenderBackend.h"
+
+#include <stdexcept>
+#include <string>
+
+namespace Gfx
+{
+	uint32_t RecordingRenderBackend::RegisterModel(uint32_t parts, Heap heap)
+	{
+		Model model;
+		model.parts = parts;
+		model.heap = heap;
+		model.firstPipeline = m_pipelineCount;
+		m_pipelineCount += parts;
+
+		m_models.push_back(model);
+		return static_cast<uint32_t>(m_models.size() - 1);
+	}
+
+	void RecordingRenderBackend::BeginFrame()
+	{
+		m_resources = nullptr;
+		m_samplers = nullptr;
+		m_pipeline = UINT32_MAX;
+	}
+
+	void RecordingRenderBackend::BindHeaps(Heap resources, Heap samplers)
+	{
+		if (resources == m_resources && samplers == m_samplers)
+		{
+			return;
+		}
+		m_resources = resources;
+		m_samplers = samplers;
+		m_stats.stateChanges++;
+		m_commands.push_back({ CommandType::BindHeaps, 0, 0, 0 });
+	}
+
+	void RecordingRenderBackend::SetMatrices(const Float4x4& /*world*/, const Float4x4& /*view*/, const Float4x4& /*projection*/)
+	{
+		m_commands.push_back({ CommandType::SetMatrices, 0, 0, 0 });
+	}
+
+	void RecordingRenderBackend::DrawParts(const Model& model)
+	{
+		if (model.heap)
+		{
+			BindHeaps(model.heap, nullptr);
+		}
+		for (uint32_t part = 0; part < model.parts; part++)
+		{
+			if (m_pipeline != model.firstPipeline + part)
+			{
+				m_pipeline = model.firstPipeline + part;
+				m_stats.stateChanges++;
+			}
+			m_stats.draws++;
+		}
+	}
+
+	const RecordingRenderBackend::Model& RecordingRenderBackend::GetModel(uint32_t model, const char* call) const
+	{
+		if (model >= m_models.size())
+		{
+			throw std::out_of_range(std::string(call) + " of an unregistered model");
+		}
+		return m_models[model];
+	}
+
+	void RecordingRenderBackend::Draw(uint32_t model)
+	{
+		DrawParts(GetModel(model, "Draw"));
+		m_commands.push_back({ CommandType::Draw, model, 0, 0 });
+	}
+
+	void RecordingRenderBackend::UploadInstances(const InstanceTransform* /*instances*/, size_t count)
+	{
+		size_t bytes = count * sizeof(InstanceTransform);
+		m_uploadedInstances = count;
+		m_stats.uploads++;
+		m_stats.uploadedBytes += bytes;
+		m_commands.push_back({ CommandType::UploadInstances, 0, 0, static_cast<uint32_t>(bytes) });
+	}
+
+	void RecordingRenderBackend::DrawInstanced(uint32_t model, uint32_t firstInstance, uint32_t count)
+	{
+		auto& registered = GetModel(model, "DrawInstanced");
+
+		// Same contract as a real backend: draws stay inside the uploaded buffer
+		if (size_t(firstInstance) + count > m_uploadedInstances)
+		{
+			throw std::out_of_range("DrawInstanced past the uploaded instances");
+		}
+
+		DrawParts(registered);
+		m_stats.instancedDraws++;
+		m_stats.instances += count;
+		m_commands.push_back({ CommandType::DrawInstanced, model, firstInstance, count });
+	}
+
+	uint32_t RecordingRenderBackend::CreateMesh(const MeshData& mesh)
+	{
+		size_t bytes = mesh.vertices.size() * sizeof(MeshVertex) + mesh.indices.size() * sizeof(uint32_t);
+		m_stats.uploads++;
+		m_stats.uploadedBytes += bytes;
+
+		uint32_t id;
+		if (!m_freeMeshes.empty())
+		{
+			id = m_freeMeshes.back();
+			m_freeMeshes.pop_back();
+			m_meshes[id] = true;
+		}
+		else
+		{
+			id = static_cast<uint32_t>(m_meshes.size());
+			m_meshes.push_back(true);
+		}
+		m_commands.push_back({ CommandType::CreateMesh, id, 0, static_cast<uint32_t>(bytes) });
+		return id;
+	}
+
+	void RecordingRenderBackend::ReleaseMesh(uint32_t mesh)
+	{
+		if (mesh >= m_meshes.size() || !m_meshes[mesh])
+		{
+			throw std::out_of_range("ReleaseMesh of a mesh that does not exist");
+		}
+		m_meshes[mesh] = false;
+		m_freeMeshes.push_back(mesh);
+		m_commands.push_back({ CommandType::ReleaseMesh, mesh, 0, 0 });
+	}
+
+	void RecordingRenderBackend::DrawMesh(uint32_t mesh, uint32_t model, uint32_t part)
+	{
+		if (mesh >= m_meshes.size() || !m_meshes[mesh])
+		{
+			throw std::out_of_range("DrawMesh of a mesh that does not exist");
+		}
+		auto& registered = GetModel(model, "DrawMesh");
+		if (part >= registered.parts)
+		{
+			throw std::out_of_range("DrawMesh of a part the model does not have");
+		}
+		if (registered.heap)
+		{
+			BindHeaps(registered.heap, nullptr);
+		}
+		if (m_pipeline != MESH_PIPELINE)
+		{
+			m_pipeline = MESH_PIPELINE;
+			m_stats.stateChanges++;
+		}
+		m_stats.draws++;
+		m_stats.meshDraws++;
+		m_commands.push_back({ CommandType::DrawMesh, model, mesh, 0 });
+	}
+
+	void RecordingRenderBackend::Reset()
+	{
+		m_stats = Stats();
+		m_commands.clear();
+	}
+}
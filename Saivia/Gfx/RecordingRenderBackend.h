@@ -0,0 +1,96 @@
+//
+// RecordingRenderBackend.h - Backend without a device that records and counts submissions
+//
+
+#pragma once
+
+#include <vector>
+
+#include "RenderBackend.h"
+
+namespace Gfx
+{
+	// Stands in for the GPU in headless tests and benchmarks. It checks the
+	// calls like a real backend would (registered models, draws inside the
+	// uploaded instances) and counts what a frame costs.
+	class RecordingRenderBackend : public RenderBackend
+	{
+	public:
+		enum class CommandType
+		{
+			BindHeaps,
+			SetMatrices,
+			Draw,
+			UploadInstances,
+			DrawInstanced,
+			CreateMesh,
+			ReleaseMesh,
+			DrawMesh,
+		};
+
+		struct Command
+		{
+			CommandType type;
+			uint32_t model;
+			uint32_t first;
+			uint32_t count;     // instances, or bytes for UploadInstances / CreateMesh
+		};
+
+		struct Stats
+		{
+			size_t draws = 0;           // API draw calls (one per model part)
+			size_t instancedDraws = 0;
+			size_t instances = 0;
+			size_t meshDraws = 0;
+			size_t uploads = 0;
+			size_t uploadedBytes = 0;
+			size_t stateChanges = 0;    // heap binds and pipeline switches that changed state
+		};
+
+		// A stand-in for a model with `parts` parts, each with its own
+		// pipeline, and its texture heap.
+		uint32_t RegisterModel(uint32_t parts, Heap heap = nullptr);
+
+		void BeginFrame() override;
+		void BindHeaps(Heap resources, Heap samplers) override;
+		void SetMatrices(const Float4x4& world, const Float4x4& view, const Float4x4& projection) override;
+		void Draw(uint32_t model) override;
+		void UploadInstances(const InstanceTransform* instances, size_t count) override;
+		void DrawInstanced(uint32_t model, uint32_t firstInstance, uint32_t count) override;
+		uint32_t CreateMesh(const MeshData& mesh) override;
+		void ReleaseMesh(uint32_t mesh) override;
+		void DrawMesh(uint32_t mesh, uint32_t model, uint32_t part) override;
+
+		size_t MeshCount() const { return m_meshes.size() - m_freeMeshes.size(); }
+
+		const Stats& GetStats() const { return m_stats; }
+		const std::vector<Command>& Commands() const { return m_commands; }
+		void Reset();   // stats and recorded commands
+
+	private:
+		struct Model
+		{
+			uint32_t parts;
+			Heap heap;
+			uint32_t firstPipeline;
+		};
+
+		void DrawParts(const Model& model);
+		const Model& GetModel(uint32_t model, const char* call) const;
+
+		std::vector<Model> m_models;
+		uint32_t m_pipelineCount = 0;
+
+		Stats m_stats;
+		std::vector<Command> m_commands;
+		size_t m_uploadedInstances = 0;
+		std::vector<bool> m_meshes;         // live per id
+		std::vector<uint32_t> m_freeMeshes;
+
+		// Bound state, as a real command list would see it
+		Heap m_resources = nullptr;
+		Heap m_samplers = nullptr;
+		uint32_t m_pipeline = UINT32_MAX;   // MESH_PIPELINE for meshes
+		static constexpr uint32_t MESH_PIPELINE = UINT32_MAX - 1;
+	};
+}
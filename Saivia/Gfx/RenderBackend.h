@@ -0,0 +1,68 @@
+//
+// RenderBackend.h - What the device-independent render code asks of a GPU API
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "GfxTypes.h"
+
+namespace Gfx
+{
+	// Models are registered with the concrete backend and referred to by id;
+	// the backend owns whatever it needs to draw them (buffers, pipelines,
+	// descriptor heaps). Draws bind the heaps of their model themselves, so
+	// BindHeaps is only needed for state the caller manages directly.
+	class RenderBackend
+	{
+	public:
+		// Opaque descriptor heap (ID3D12DescriptorHeap* on D3D12)
+		using Heap = const void*;
+
+		virtual ~RenderBackend() = default;
+
+		// Forgets the bound state; everything is bound again on first use.
+		virtual void BeginFrame() = 0;
+
+		// Binding the same heaps again is not a state change.
+		virtual void BindHeaps(Heap resources, Heap samplers) = 0;
+
+		// World applies to Draw; DrawInstanced takes the world matrix from
+		// every instance and only uses view and projection.
+		virtual void SetMatrices(const Float4x4& world, const Float4x4& view, const Float4x4& projection) = 0;
+
+		// Every part of the model, one draw each
+		virtual void Draw(uint32_t model) = 0;
+
+		// Replaces the instance buffer. It stays bound for DrawInstanced until
+		// the next upload, so unchanged instances are not uploaded again.
+		virtual void UploadInstances(const InstanceTransform* instances, size_t count) = 0;
+
+		// Every part of the model, instances [firstInstance, firstInstance + count)
+		virtual void DrawInstanced(uint32_t model, uint32_t firstInstance, uint32_t count) = 0;
+
+		// Static geometry kept by the backend until ReleaseMesh. Ids of
+		// released meshes are handed out again.
+		virtual uint32_t CreateMesh(const MeshData& mesh) = 0;
+		virtual void ReleaseMesh(uint32_t mesh) = 0;
+
+		// One draw, world from SetMatrices, textured like that part of model
+		virtual void DrawMesh(uint32_t mesh, uint32_t model, uint32_t part) = 0;
+	};
+
+	inline Float4x4 IdentityMatrix()
+	{
+		return { { { 1.f, 0.f, 0.f, 0.f }, { 0.f, 1.f, 0.f, 0.f }, { 0.f, 0.f, 1.f, 0.f }, { 0.f, 0.f, 0.f, 1.f } } };
+	}
+
+	inline Float4x4 TranslationMatrix(float x, float y, float z)
+	{
+		Float4x4 matrix = IdentityMatrix();
+		matrix.m[3][0] = x;
+		matrix.m[3][1] = y;
+		matrix.m[3][2] = z;
+		return matrix;
+	}
+}
@@ -0,0 +1,437 @@
+//
+// SdkMesh.cpp
+//
+
+#include "SdkMesh.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+namespace Gfx
+{
+	namespace
+	{
+		// The DXUT SDKMESH structures, laid out as DirectXTK's loader reads
+		// them (8 byte packing, pointer unions as 64 bit offsets)
+#pragma pack(push, 8)
+		const uint32_t SDKMESH_FILE_VERSION = 101;
+		const uint32_t INVALID = 0xffffffffu;
+
+		struct Header
+		{
+			uint32_t Version;
+			uint8_t IsBigEndian;
+			uint64_t HeaderSize;
+			uint64_t NonBufferDataSize;
+			uint64_t BufferDataSize;
+			uint32_t NumVertexBuffers;
+			uint32_t NumIndexBuffers;
+			uint32_t NumMeshes;
+			uint32_t NumTotalSubsets;
+			uint32_t NumFrames;
+			uint32_t NumMaterials;
+			uint64_t VertexStreamHeadersOffset;
+			uint64_t IndexStreamHeadersOffset;
+			uint64_t MeshDataOffset;
+			uint64_t SubsetDataOffset;
+			uint64_t FrameDataOffset;
+			uint64_t MaterialDataOffset;
+		};
+
+		// D3DVERTEXELEMENT9
+		struct VertexElement
+		{
+			uint16_t Stream;
+			uint16_t Offset;
+			uint8_t Type;
+			uint8_t Method;
+			uint8_t Usage;
+			uint8_t UsageIndex;
+		};
+
+		struct VertexBufferHeader
+		{
+			uint64_t NumVertices;
+			uint64_t SizeBytes;
+			uint64_t StrideBytes;
+			VertexElement Decl[32];
+			uint64_t DataOffset;
+		};
+
+		struct IndexBufferHeader
+		{
+			uint64_t NumIndices;
+			uint64_t SizeBytes;
+			uint32_t IndexType;
+			uint64_t DataOffset;
+		};
+
+		struct Mesh
+		{
+			char Name[100];
+			uint8_t NumVertexBuffers;
+			uint32_t VertexBuffers[16];
+			uint32_t IndexBuffer;
+			uint32_t NumSubsets;
+			uint32_t NumFrameInfluences;
+			Float3 BoundingBoxCenter;
+			Float3 BoundingBoxExtents;
+			uint64_t SubsetOffset;
+			uint64_t FrameInfluenceOffset;
+		};
+
+		struct Subset
+		{
+			char Name[100];
+			uint32_t MaterialID;
+			uint32_t PrimitiveType;
+			uint64_t IndexStart;
+			uint64_t IndexCount;
+			uint64_t VertexStart;
+			uint64_t VertexCount;
+		};
+
+		struct Frame
+		{
+			char Name[100];
+			uint32_t Mesh;
+			uint32_t ParentFrame;
+			uint32_t ChildFrame;
+			uint32_t SiblingFrame;
+			float Matrix[4][4];
+			uint32_t AnimationDataIndex;
+		};
+
+		struct Material
+		{
+			char Name[100];
+			char MaterialInstancePath[260];
+			char DiffuseTexture[260];
+			char NormalTexture[260];
+			char SpecularTexture[260];
+			float Diffuse[4];
+			float Ambient[4];
+			float Specular[4];
+			float Emissive[4];
+			float Power;
+			uint64_t Force64[6];
+		};
+#pragma pack(pop)
+
+		static_assert(sizeof(VertexElement) == 8, "SDKMESH layout");
+		static_assert(sizeof(Header) == 104, "SDKMESH layout");
+		static_assert(sizeof(VertexBufferHeader) == 288, "SDKMESH layout");
+		static_assert(sizeof(IndexBufferHeader) == 32, "SDKMESH layout");
+		static_assert(sizeof(Mesh) == 224, "SDKMESH layout");
+		static_assert(sizeof(Subset) == 144, "SDKMESH layout");
+		static_assert(sizeof(Frame) == 184, "SDKMESH layout");
+		static_assert(sizeof(Material) == 1256, "SDKMESH layout");
+		static_assert(sizeof(ObjVertex) == 32, "SDKMESH vertex stride");
+
+		// D3DDECLTYPE, D3DDECLUSAGE
+		const uint8_t DECLTYPE_FLOAT2 = 1;
+		const uint8_t DECLTYPE_FLOAT3 = 2;
+		const uint8_t DECLTYPE_UNUSED = 17;
+		const uint8_t DECLUSAGE_POSITION = 0;
+		const uint8_t DECLUSAGE_NORMAL = 3;
+		const uint8_t DECLUSAGE_TEXCOORD = 5;
+
+		const uint32_t INDEX_16BIT = 0;
+		const uint32_t INDEX_32BIT = 1;
+		const uint32_t PRIMITIVE_TRIANGLE_LIST = 0;
+
+		// DXUT aligns every buffer to a page
+		const uint64_t BUFFER_ALIGNMENT = 4096;
+
+		uint64_t Align(uint64_t size)
+		{
+			return (size + BUFFER_ALIGNMENT - 1) & ~(BUFFER_ALIGNMENT - 1);
+		}
+
+		// Truncated to fit, always terminated
+		template <size_t N>
+		void CopyName(char (&to)[N], const std::string& from)
+		{
+			size_t length = std::min(from.size(), N - 1);
+			memcpy(to, from.data(), length);
+			to[length] = 0;
+		}
+
+		template <typename T>
+		void Put(std::vector<uint8_t>& file, uint64_t offset, const T& value)
+		{
+			memcpy(file.data() + offset, &value, sizeof(T));
+		}
+
+		bool Fits(const std::vector<uint8_t>& file, uint64_t offset, uint64_t size)
+		{
+			return offset <= file.size() && size <= file.size() - offset;
+		}
+
+		template <typename T>
+		T Get(const std::vector<uint8_t>& file, uint64_t offset)
+		{
+			if (!Fits(file, offset, sizeof(T)))
+			{
+				throw std::runtime_error("SDKMESH: truncated file");
+			}
+			T value;
+			memcpy(&value, file.data() + offset, sizeof(T));
+			return value;
+		}
+	}
+
+	std::vector<uint8_t> WriteSdkMesh(const ObjModel& model)
+	{
+		if (model.vertices.empty() || model.subsets.empty())
+		{
+			throw std::runtime_error("SDKMESH: the model has no triangles");
+		}
+
+		bool shortIndices = model.vertices.size() <= 0xffff;
+		uint64_t indexSize = shortIndices ? 2 : 4;
+		uint32_t subsetCount = static_cast<uint32_t>(model.subsets.size());
+		uint32_t materialCount = static_cast<uint32_t>(model.materials.size());
+
+		// Header and stream headers, the other structures, then the buffers
+		Header header = {};
+		header.Version = SDKMESH_FILE_VERSION;
+		header.NumVertexBuffers = 1;
+		header.NumIndexBuffers = 1;
+		header.NumMeshes = 1;
+		header.NumTotalSubsets = subsetCount;
+		header.NumFrames = 1;
+		header.NumMaterials = materialCount;
+		header.VertexStreamHeadersOffset = sizeof(Header);
+		header.IndexStreamHeadersOffset = header.VertexStreamHeadersOffset + sizeof(VertexBufferHeader);
+		header.MeshDataOffset = header.IndexStreamHeadersOffset + sizeof(IndexBufferHeader);
+		header.HeaderSize = header.MeshDataOffset;
+		header.SubsetDataOffset = header.MeshDataOffset + sizeof(Mesh);
+		header.FrameDataOffset = header.SubsetDataOffset + subsetCount * sizeof(Subset);
+		header.MaterialDataOffset = header.FrameDataOffset + sizeof(Frame);
+		uint64_t subsetIndexOffset = header.MaterialDataOffset + materialCount * sizeof(Material);
+		uint64_t influenceOffset = subsetIndexOffset + subsetCount * sizeof(uint32_t);
+		uint64_t bufferOffset = influenceOffset + sizeof(uint32_t);
+		header.NonBufferDataSize = bufferOffset - header.HeaderSize;
+
+		uint64_t vertexBytes = model.vertices.size() * sizeof(ObjVertex);
+		uint64_t indexBytes = model.indices.size() * indexSize;
+		header.BufferDataSize = Align(vertexBytes) + Align(indexBytes);
+
+		std::vector<uint8_t> file(static_cast<size_t>(bufferOffset + header.BufferDataSize), 0);
+		Put(file, 0, header);
+
+		VertexBufferHeader vertexBuffer = {};
+		vertexBuffer.NumVertices = model.vertices.size();
+		vertexBuffer.SizeBytes = vertexBytes;
+		vertexBuffer.StrideBytes = sizeof(ObjVertex);
+		vertexBuffer.Decl[0] = { 0, 0, DECLTYPE_FLOAT3, 0, DECLUSAGE_POSITION, 0 };
+		vertexBuffer.Decl[1] = { 0, 12, DECLTYPE_FLOAT3, 0, DECLUSAGE_NORMAL, 0 };
+		vertexBuffer.Decl[2] = { 0, 24, DECLTYPE_FLOAT2, 0, DECLUSAGE_TEXCOORD, 0 };
+		vertexBuffer.Decl[3] = { 0xff, 0, DECLTYPE_UNUSED, 0, 0, 0 };
+		vertexBuffer.DataOffset = bufferOffset;
+		Put(file, header.VertexStreamHeadersOffset, vertexBuffer);
+
+		IndexBufferHeader indexBuffer = {};
+		indexBuffer.NumIndices = model.indices.size();
+		indexBuffer.SizeBytes = indexBytes;
+		indexBuffer.IndexType = shortIndices ? INDEX_16BIT : INDEX_32BIT;
+		indexBuffer.DataOffset = bufferOffset + Align(vertexBytes);
+		Put(file, header.IndexStreamHeadersOffset, indexBuffer);
+
+		Mesh mesh = {};
+		mesh.NumVertexBuffers = 1;
+		mesh.NumSubsets = subsetCount;
+		mesh.NumFrameInfluences = 1;
+		mesh.BoundingBoxCenter = { (model.boundsMin.x + model.boundsMax.x) / 2, (model.boundsMin.y + model.boundsMax.y) / 2,
+			(model.boundsMin.z + model.boundsMax.z) / 2 };
+		mesh.BoundingBoxExtents = { (model.boundsMax.x - model.boundsMin.x) / 2, (model.boundsMax.y - model.boundsMin.y) / 2,
+			(model.boundsMax.z - model.boundsMin.z) / 2 };
+		mesh.SubsetOffset = subsetIndexOffset;
+		mesh.FrameInfluenceOffset = influenceOffset;
+		Put(file, header.MeshDataOffset, mesh);
+
+		for (uint32_t s = 0; s < subsetCount; s++)
+		{
+			auto& from = model.subsets[s];
+			Subset subset = {};
+			subset.MaterialID = from.material;
+			subset.PrimitiveType = PRIMITIVE_TRIANGLE_LIST;
+			subset.IndexStart = from.indexStart;
+			subset.IndexCount = from.indexCount;
+			subset.VertexStart = 0;
+			subset.VertexCount = model.vertices.size();
+			Put(file, header.SubsetDataOffset + s * sizeof(Subset), subset);
+			Put(file, subsetIndexOffset + s * sizeof(uint32_t), s);
+		}
+		Put(file, influenceOffset, uint32_t(0));
+
+		Frame frame = {};
+		CopyName(frame.Name, "root");
+		frame.Mesh = 0;
+		frame.ParentFrame = frame.ChildFrame = frame.SiblingFrame = INVALID;
+		for (int n = 0; n < 4; n++)
+		{
+			frame.Matrix[n][n] = 1.f;
+		}
+		frame.AnimationDataIndex = INVALID;
+		Put(file, header.FrameDataOffset, frame);
+
+		for (uint32_t m = 0; m < materialCount; m++)
+		{
+			auto& from = model.materials[m];
+			Material material = {};
+			CopyName(material.Name, m == 0 && from.name.empty() ? std::string("default") : from.name);
+			CopyName(material.DiffuseTexture, from.diffuseTexture);
+			float diffuse[4] = { from.diffuse.x, from.diffuse.y, from.diffuse.z, from.alpha };
+			float ambient[4] = { from.ambient.x, from.ambient.y, from.ambient.z, 1.f };
+			float emissive[4] = { from.emissive.x, from.emissive.y, from.emissive.z, 0.f };
+			memcpy(material.Diffuse, diffuse, sizeof(diffuse));
+			memcpy(material.Ambient, ambient, sizeof(ambient));
+			memcpy(material.Emissive, emissive, sizeof(emissive));
+
+			// As meshconvert: specular only with illum 2, and a power of 1
+			// when there is no highlight
+			bool specular = from.specularLit && (from.specular.x > 0.f || from.specular.y > 0.f || from.specular.z > 0.f);
+			if (specular)
+			{
+				float color[4] = { from.specular.x, from.specular.y, from.specular.z, 0.f };
+				memcpy(material.Specular, color, sizeof(color));
+			}
+			material.Power = specular ? from.shininess : 1.f;
+			Put(file, header.MaterialDataOffset + m * sizeof(Material), material);
+		}
+
+		memcpy(file.data() + vertexBuffer.DataOffset, model.vertices.data(), static_cast<size_t>(vertexBytes));
+		uint8_t* indices = file.data() + indexBuffer.DataOffset;
+		if (shortIndices)
+		{
+			for (size_t i = 0; i < model.indices.size(); i++)
+			{
+				uint16_t index = static_cast<uint16_t>(model.indices[i]);
+				memcpy(indices + i * 2, &index, 2);
+			}
+		}
+		else
+		{
+			memcpy(indices, model.indices.data(), static_cast<size_t>(indexBytes));
+		}
+		return file;
+	}
+
+	void SaveSdkMesh(const std::filesystem::path& path, const ObjModel& model)
+	{
+		auto data = WriteSdkMesh(model);
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		if (!file)
+		{
+			throw std::runtime_error("Cannot create " + path.u8string());
+		}
+		file.write(reinterpret_cast<const char*>(data.data()), data.size());
+		if (!file)
+		{
+			throw std::runtime_error("Cannot write " + path.u8string());
+		}
+	}
+
+	ObjModel ReadSdkMesh(const std::vector<uint8_t>& file)
+	{
+		auto header = Get<Header>(file, 0);
+		if (header.Version != SDKMESH_FILE_VERSION || header.IsBigEndian || header.NumVertexBuffers == 0 || header.NumIndexBuffers == 0)
+		{
+			throw std::runtime_error("SDKMESH: not a static mesh file");
+		}
+		auto vertexBuffer = Get<VertexBufferHeader>(file, header.VertexStreamHeadersOffset);
+		auto indexBuffer = Get<IndexBufferHeader>(file, header.IndexStreamHeadersOffset);
+		if (vertexBuffer.StrideBytes != sizeof(ObjVertex) ||
+			vertexBuffer.Decl[0].Usage != DECLUSAGE_POSITION || vertexBuffer.Decl[0].Offset != 0 ||
+			vertexBuffer.Decl[1].Usage != DECLUSAGE_NORMAL || vertexBuffer.Decl[1].Offset != 12 ||
+			vertexBuffer.Decl[2].Usage != DECLUSAGE_TEXCOORD || vertexBuffer.Decl[2].Offset != 24)
+		{
+			throw std::runtime_error("SDKMESH: vertices are not position / normal / texcoord");
+		}
+		uint64_t indexSize = indexBuffer.IndexType == INDEX_16BIT ? 2 : 4;
+		if (!Fits(file, vertexBuffer.DataOffset, vertexBuffer.NumVertices * sizeof(ObjVertex)) ||
+			!Fits(file, indexBuffer.DataOffset, indexBuffer.NumIndices * indexSize))
+		{
+			throw std::runtime_error("SDKMESH: truncated file");
+		}
+
+		ObjModel model;
+		model.vertices.resize(static_cast<size_t>(vertexBuffer.NumVertices));
+		memcpy(model.vertices.data(), file.data() + vertexBuffer.DataOffset, model.vertices.size() * sizeof(ObjVertex));
+		model.indices.resize(static_cast<size_t>(indexBuffer.NumIndices));
+		const uint8_t* indices = file.data() + indexBuffer.DataOffset;
+		for (size_t i = 0; i < model.indices.size(); i++)
+		{
+			if (indexSize == 2)
+			{
+				uint16_t index;
+				memcpy(&index, indices + i * 2, 2);
+				model.indices[i] = index;
+			}
+			else
+			{
+				memcpy(&model.indices[i], indices + i * 4, 4);
+			}
+			if (model.indices[i] >= model.vertices.size())
+			{
+				throw std::runtime_error("SDKMESH: index out of range");
+			}
+		}
+		return model;
+	}
+
+	ObjModel LoadSdkMesh(const std::filesystem::path& path)
+	{
+		std::ifstream file(path, std::ios::binary | std::ios::ate);
+		if (!file)
+		{
+			throw std::runtime_error("Cannot open " + path.u8string());
+		}
+		std::vector<uint8_t> data(static_cast<size_t>(file.tellg()));
+		file.seekg(0);
+		file.read(reinterpret_cast<char*>(data.data()), data.size());
+		if (!file)
+		{
+			throw std::runtime_error("Cannot read " + path.u8string());
+		}
+		return ReadSdkMesh(data);
+	}
+
+	std::vector<std::string> ReadSdkMeshTextures(const std::vector<uint8_t>& file)
+	{
+		std::vector<std::string> names;
+		if (!Fits(file, 0, sizeof(Header)))
+		{
+			return names;
+		}
+		auto header = Get<Header>(file, 0);
+		if (header.Version != SDKMESH_FILE_VERSION || header.IsBigEndian ||
+			!Fits(file, header.MaterialDataOffset, uint64_t(header.NumMaterials) * sizeof(Material)))
+		{
+			return names;
+		}
+		for (uint32_t m = 0; m < header.NumMaterials; m++)
+		{
+			auto material = Get<Material>(file, header.MaterialDataOffset + m * sizeof(Material));
+			for (auto texture : { material.DiffuseTexture, material.NormalTexture, material.SpecularTexture })
+			{
+				std::string name(texture, strnlen(texture, sizeof(material.DiffuseTexture)));
+				if (!name.empty() && std::find(names.begin(), names.end(), name) == names.end())
+				{
+					names.push_back(name);
+				}
+			}
+		}
+		return names;
+	}
+
+	void ConvertObjToSdkMesh(const std::filesystem::path& source, const std::filesystem::path& target, const ObjOptions& options)
+	{
+		SaveSdkMesh(target, LoadObj(source, options));
+	}
+}
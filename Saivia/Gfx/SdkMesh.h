@@ -0,0 +1,37 @@
+//
+// SdkMesh.h - Writes SDKMESH (version 101) files for DirectX::Model
+//
+
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "ObjImport.h"
+
+namespace Gfx
+{
+	// The file meshconvert -sdkmesh writes for a static mesh: one vertex
+	// buffer (position, normal, texcoord), one index buffer (16 bit when
+	// the vertices allow), one mesh with a subset per material and a root
+	// frame. Texture names are written as they are.
+	std::vector<uint8_t> WriteSdkMesh(const ObjModel& model);
+
+	void SaveSdkMesh(const std::filesystem::path& path, const ObjModel& model);
+
+	// Vertices and indices of a file in that layout (the first vertex and
+	// index buffer), to compare a conversion with meshconvert's output.
+	// Throws std::runtime_error on a file it cannot read.
+	ObjModel ReadSdkMesh(const std::vector<uint8_t>& file);
+	ObjModel LoadSdkMesh(const std::filesystem::path& path);
+
+	// The distinct texture names of the materials (diffuse, normal,
+	// specular), as the file has them; empty for a file it cannot read.
+	std::vector<std::string> ReadSdkMeshTextures(const std::vector<uint8_t>& file);
+
+	// LoadObj + SaveSdkMesh; what the editor used to run meshconvert for
+	void ConvertObjToSdkMesh(const std::filesystem::path& source, const std::filesystem::path& target,
+		const ObjOptions& options = {});
+}
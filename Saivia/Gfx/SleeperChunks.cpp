@@ -0,0 +1,200 @@
+//
+// SleeperChunks.cpp
+//
+
+#include "SleeperChunks.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "../Track/Parallel.h"
+#include "../Track/TrackGenerator.h"
+
+namespace Gfx
+{
+	namespace
+	{
+		Float3 ToFloat(const Track::Vec3& v)
+		{
+			return { float(v.x), float(v.y), float(v.z) };
+		}
+
+		// Sleepers per chunk and the chunk of the first sleeper of an edge
+		void ChunkLayout(const Track::TrackGraph& graph, uint32_t edge, long long& perChunk, long long& firstIndex)
+		{
+			auto& e = graph.Edges()[edge];
+			long long last;
+			Track::SampleIndices(graph.Alignments()[e.railway], e.s0, e.s1, Track::SLEEPER_SPACING, firstIndex, last);
+			perChunk = std::max(1LL, static_cast<long long>(std::llround(CHUNK_LENGTH / Track::SLEEPER_SPACING)));
+		}
+	}
+
+	void SleeperChunks::Rebuild(const Track::TrackGraph& graph)
+	{
+		m_chunks.assign(graph.Edges().size(), std::vector<SleeperChunk>());
+		m_changes.resize(m_chunks.size());
+		Track::ParallelFor(m_chunks.size(), [&](size_t e)
+		{
+			m_changes[e] = { static_cast<uint32_t>(e), ChunkEdge(graph, static_cast<uint32_t>(e), 0) };
+		});
+	}
+
+	void SleeperChunks::Update(const Track::TrackGraph& graph)
+	{
+		if (m_chunks.size() != graph.Edges().size())
+		{
+			Rebuild(graph);
+			return;
+		}
+
+		auto& changes = graph.Changes();
+		m_changes.resize(changes.size());
+		Track::ParallelFor(changes.size(), [&](size_t c)
+		{
+			m_changes[c] = { changes[c].edge, ChunkEdge(graph, changes[c].edge, changes[c].firstFrame) };
+		});
+	}
+
+	size_t SleeperChunks::ChunkEdge(const Track::TrackGraph& graph, uint32_t edge, size_t firstFrame)
+	{
+		auto& frames = graph.EdgeFrames(edge);
+		auto& chunks = m_chunks[edge];
+
+		long long perChunk, firstIndex;
+		ChunkLayout(graph, edge, perChunk, firstIndex);
+
+		// Sleeper k (chainage k * spacing) belongs to chunk floor((k - 1) / perChunk),
+		// i.e. a chunk holds the chainage range (j * CHUNK_LENGTH, (j + 1) * CHUNK_LENGTH]
+		auto chunkOf = [&](size_t frame)
+		{
+			long long k = firstIndex + static_cast<long long>(frame) - 1;
+			return k >= 0 ? k / perChunk : -((-k + perChunk - 1) / perChunk);
+		};
+
+		auto& e = graph.Edges()[edge];
+		double chunkLength = static_cast<double>(perChunk) * Track::SLEEPER_SPACING;
+		auto chunkEnd = [&](long long id) { return std::min(e.s1, static_cast<double>(id + 1) * chunkLength); };
+
+		// Keep the chunks that end before the first changed frame, and the
+		// last one only while the edge still ends where it did
+		while (!chunks.empty() && (chunks.back().firstFrame + chunks.back().Count() > firstFrame ||
+			chunks.back().s1 != chunkEnd(chunkOf(chunks.back().firstFrame))))
+		{
+			chunks.pop_back();
+		}
+		size_t kept = chunks.size();
+
+		size_t frame = chunks.empty() ? 0 : chunks.back().firstFrame + chunks.back().Count();
+		while (frame < frames.size())
+		{
+			SleeperChunk chunk;
+			chunk.edge = edge;
+			chunk.firstFrame = frame;
+			chunk.origin = frames[frame].Pos;
+
+			long long id = chunkOf(frame);
+			chunk.s0 = std::max(e.s0, static_cast<double>(id) * chunkLength);
+			chunk.s1 = chunkEnd(id);
+			size_t end = frame;
+			while (end < frames.size() && chunkOf(end) == id)
+			{
+				end++;
+			}
+
+			chunk.positions.resize(end - frame);
+			chunk.rotations.resize(end - frame);
+			chunk.boundsMin = { 0.f, 0.f, 0.f };
+			chunk.boundsMax = { 0.f, 0.f, 0.f };
+			for (size_t n = frame; n < end; n++)
+			{
+				auto& f = frames[n];
+				Float3 p = ToFloat(f.Pos - chunk.origin);
+				chunk.positions[n - frame] = p;
+				chunk.rotations[n - frame] = PackRotation(f.B, f.N, f.T);
+
+				chunk.boundsMin = { std::min(chunk.boundsMin.x, p.x), std::min(chunk.boundsMin.y, p.y), std::min(chunk.boundsMin.z, p.z) };
+				chunk.boundsMax = { std::max(chunk.boundsMax.x, p.x), std::max(chunk.boundsMax.y, p.y), std::max(chunk.boundsMax.z, p.z) };
+			}
+			chunks.push_back(std::move(chunk));
+			frame = end;
+		}
+		return kept;
+	}
+
+	void SleeperChunks::PackInstances(const Track::Vec3& origin, InstanceTransform* out) const
+	{
+		// Every chunk writes its own range of out
+		std::vector<const SleeperChunk*> chunks;
+		std::vector<size_t> offsets;
+		size_t offset = 0;
+		for (auto& edge : m_chunks)
+		{
+			for (auto& chunk : edge)
+			{
+				chunks.push_back(&chunk);
+				offsets.push_back(offset);
+				offset += chunk.Count();
+			}
+		}
+
+		Track::ParallelFor(chunks.size(), [&](size_t c)
+		{
+			auto& chunk = *chunks[c];
+			Float3 shift = ToFloat(chunk.origin - origin);
+			InstanceTransform* instance = out + offsets[c];
+			for (size_t n = 0; n < chunk.Count(); n++)
+			{
+				Float3 B, N, T;
+				UnpackRotation(chunk.rotations[n], B, N, T);
+				auto& p = chunk.positions[n];
+				*instance++ = { {
+					{ B.x, N.x, T.x, p.x + shift.x },
+					{ B.y, N.y, T.y, p.y + shift.y },
+					{ B.z, N.z, T.z, p.z + shift.z } } };
+			}
+		});
+	}
+
+	size_t SleeperChunks::InstanceCount() const
+	{
+		size_t count = 0;
+		for (auto& edge : m_chunks)
+		{
+			for (auto& chunk : edge)
+			{
+				count += chunk.Count();
+			}
+		}
+		return count;
+	}
+
+	size_t SleeperChunks::MemoryUsage() const
+	{
+		size_t bytes = 0;
+		for (auto& edge : m_chunks)
+		{
+			bytes += edge.capacity() * sizeof(SleeperChunk);
+			for (auto& chunk : edge)
+			{
+				bytes += chunk.positions.capacity() * sizeof(Float3) + chunk.rotations.capacity() * sizeof(PackedRotation);
+			}
+		}
+		return bytes;
+	}
+
+	size_t SleeperChunks::ChunkCount() const
+	{
+		size_t count = 0;
+		for (auto& edge : m_chunks)
+		{
+			count += edge.size();
+		}
+		return count;
+	}
+
+	Track::Vec3 SleeperChunks::Position(const SleeperChunk& chunk, size_t frame)
+	{
+		auto& p = chunk.positions[frame];
+		return chunk.origin + Track::Vec3{ p.x, p.y, p.z };
+	}
+}
@@ -0,0 +1,80 @@
+//
+// SleeperChunks.h - Sleeper instances stored per chunk relative to a chunk origin
+//
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "../Track/TrackGraph.h"
+#include "PackedTransform.h"
+
+namespace Gfx
+{
+	// Chainage covered by one chunk. Chunk boundaries sit at multiples of it,
+	// so regenerating part of an edge leaves the chunks before it untouched.
+	const double CHUNK_LENGTH = 100.0;
+
+	// Sleepers of one chunk as structure of arrays, 20 bytes each: position
+	// relative to the chunk origin (float keeps well under 0.1 mm within a
+	// chunk; the absolute route coordinates stay in double) and the packed
+	// B N T rotation. Full matrices only exist in the per-frame upload.
+	struct SleeperChunk
+	{
+		uint32_t edge = 0;
+		size_t firstFrame = 0;      // index of the chunk's first frame in the edge
+		double s0 = 0.0;            // chainage range covered, clipped to the edge
+		double s1 = 0.0;
+		Track::Vec3 origin;         // absolute, double precision
+		std::vector<Float3> positions;
+		std::vector<PackedRotation> rotations;
+		Float3 boundsMin;           // box around the positions, relative to origin
+		Float3 boundsMax;
+
+		size_t Count() const { return positions.size(); }
+	};
+
+	class SleeperChunks
+	{
+	public:
+		// Re-chunks every edge of the graph.
+		void Rebuild(const Track::TrackGraph& graph);
+
+		// Re-chunks what graph.Changes() reports: the chunks of a changed edge
+		// from the one holding the first changed frame on.
+		void Update(const Track::TrackGraph& graph);
+
+		// Chunks of an edge rebuilt in the last Rebuild / Update: every chunk
+		// from firstChunk to the end of the edge is new.
+		struct Change
+		{
+			uint32_t edge;
+			size_t firstChunk;
+		};
+		const std::vector<Change>& Changes() const { return m_changes; }
+
+		// Instance transforms relative to origin (the render origin, kept near
+		// the camera): each chunk's shift, chunk origin - origin, is taken in
+		// double and rounded to float once, then the sleeper's float position
+		// within the chunk is added in float. Both stay small near the camera,
+		// so the sum keeps float precision there. out must hold
+		// InstanceCount() entries.
+		void PackInstances(const Track::Vec3& origin, InstanceTransform* out) const;
+
+		size_t InstanceCount() const;
+		size_t ChunkCount() const;
+		size_t MemoryUsage() const;   // bytes held by the instance arrays
+		uint32_t EdgeCount() const { return static_cast<uint32_t>(m_chunks.size()); }
+		const std::vector<SleeperChunk>& EdgeChunks(uint32_t edge) const { return m_chunks[edge]; }
+
+		static Track::Vec3 Position(const SleeperChunk& chunk, size_t frame);
+
+	private:
+		// Returns the number of chunks kept
+		size_t ChunkEdge(const Track::TrackGraph& graph, uint32_t edge, size_t firstFrame);
+
+		std::vector<std::vector<SleeperChunk>> m_chunks;    // per edge
+		std::vector<Change> m_changes;
+	};
+}
@@ -0,0 +1,133 @@
+//
+// TrackLod.cpp
+//
+
+#include "TrackLod.h"
+
+#include <cmath>
+
+#include "RailSweep.h"
+
+namespace Gfx
+{
+	namespace
+	{
+		const float TEXTURE_LENGTH = 4.f;   // metres along the track per texture repeat
+
+		// Cross sections in the sleeper frame: x along B, y along N, the frame
+		// origin on the track centre line at the sleeper bottom. Each strip is
+		// drawn left to right over the top, so its faces point outwards.
+		struct Point
+		{
+			float x, y;
+		};
+
+		struct Strip
+		{
+			Point points[4];
+			uint32_t color;
+		};
+
+		const float RAIL_X = float(RAIL_GAUGE * 0.5) + 0.035f;   // rail centres, heads 70 mm wide
+		const Strip STRIPS[] =
+		{
+			// Ballast bed
+			{ { { -2.2f, -0.4f }, { -1.5f, 0.f }, { 1.5f, 0.f }, { 2.2f, -0.4f } }, 0xff909090 },
+			// Rails, head and both sides
+			{ { { -RAIL_X - 0.035f, RAIL_BASE }, { -RAIL_X - 0.035f, RAIL_BASE + 0.15f }, { -RAIL_X + 0.035f, RAIL_BASE + 0.15f }, { -RAIL_X + 0.035f, RAIL_BASE } }, 0xff383838 },
+			{ { { RAIL_X - 0.035f, RAIL_BASE }, { RAIL_X - 0.035f, RAIL_BASE + 0.15f }, { RAIL_X + 0.035f, RAIL_BASE + 0.15f }, { RAIL_X + 0.035f, RAIL_BASE } }, 0xff383838 },
+		};
+
+		struct Section
+		{
+			Float3 position;
+			Float3 B, N;
+			float distance;
+		};
+
+		Float3 Combine(const Float3& B, float x, const Float3& N, float y)
+		{
+			return { B.x * x + N.x * y, B.y * x + N.y * y, B.z * x + N.z * y };
+		}
+	}
+
+	void BuildLodMesh(const SleeperChunk& chunk, const SleeperChunk* next, MeshData& mesh)
+	{
+		mesh.vertices.clear();
+		mesh.indices.clear();
+
+		std::vector<Section> sections;
+		auto addSection = [&sections](const Float3& position, const PackedRotation& rotation)
+		{
+			Section section;
+			Float3 T;
+			UnpackRotation(rotation, section.B, section.N, T);
+			section.position = position;
+			section.distance = 0.f;
+			if (!sections.empty())
+			{
+				auto& last = sections.back().position;
+				float dx = position.x - last.x, dy = position.y - last.y, dz = position.z - last.z;
+				section.distance = sections.back().distance + std::sqrt(dx * dx + dy * dy + dz * dz);
+			}
+			sections.push_back(section);
+		};
+
+		size_t count = chunk.Count();
+		for (size_t n = 0; n < count; n += LOD_STEP)
+		{
+			addSection(chunk.positions[n], chunk.rotations[n]);
+		}
+		if (count > 1 && (count - 1) % LOD_STEP != 0)
+		{
+			addSection(chunk.positions[count - 1], chunk.rotations[count - 1]);
+		}
+		if (next && next->Count() > 0)
+		{
+			// Into this chunk's frame in double, then float
+			Track::Vec3 p = next->origin - chunk.origin;
+			auto& q = next->positions[0];
+			addSection({ float(p.x) + q.x, float(p.y) + q.y, float(p.z) + q.z }, next->rotations[0]);
+		}
+		if (sections.size() < 2)
+		{
+			return;
+		}
+
+		// Every face of every strip is a band of quads with a flat normal
+		for (auto& strip : STRIPS)
+		{
+			for (int face = 0; face < 3; face++)
+			{
+				Point a = strip.points[face];
+				Point b = strip.points[face + 1];
+				float dx = b.x - a.x, dy = b.y - a.y;
+				float length = std::sqrt(dx * dx + dy * dy);
+				Point normal = { -dy / length, dx / length };
+
+				uint32_t base = static_cast<uint32_t>(mesh.vertices.size());
+				for (auto& section : sections)
+				{
+					Float3 n = Combine(section.B, normal.x, section.N, normal.y);
+					float v = section.distance / TEXTURE_LENGTH;
+					for (auto& point : { a, b })
+					{
+						Float3 offset = Combine(section.B, point.x, section.N, point.y);
+						MeshVertex vertex;
+						vertex.position = { section.position.x + offset.x, section.position.y + offset.y, section.position.z + offset.z };
+						vertex.normal = n;
+						vertex.color = strip.color;
+						vertex.u = (point.x + 2.2f) / 4.4f;
+						vertex.v = v;
+						mesh.vertices.push_back(vertex);
+					}
+				}
+				for (uint32_t s = 0; s + 1 < sections.size(); s++)
+				{
+					uint32_t i = base + s * 2;
+					mesh.indices.insert(mesh.indices.end(), { i, i + 2, i + 1, i + 1, i + 2, i + 3 });
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,20 @@
+//
+// TrackLod.h - Low-detail chunk meshes for track far from the camera
+//
+
+#pragma once
+
+#include "GfxTypes.h"
+#include "SleeperChunks.h"
+
+namespace Gfx
+{
+	// Every LOD_STEP-th sleeper frame of a chunk becomes a cross section.
+	const size_t LOD_STEP = 5;
+
+	// Ballast strip and both rails swept along the sleeper frames of chunk,
+	// without the sleepers themselves, positions relative to chunk.origin.
+	// next is the following chunk on the same edge (nullptr at the end); the
+	// strip runs on to its first frame so neighbouring chunks meet.
+	void BuildLodMesh(const SleeperChunk& chunk, const SleeperChunk* next, MeshData& mesh);
+}
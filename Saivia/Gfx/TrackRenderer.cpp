@@ -0,0 +1,389 @@
+//
+// TrackRenderer.cpp
+//
+
+#include "TrackRenderer.h"
+
+#include <algorithm>
+
+#include "../Track/Parallel.h"
+#include "ChunkBaker.h"
+#include "TrackLod.h"
+
+namespace Gfx
+{
+	namespace
+	{
+		// A chunk mesh not drawn for this many frames is released
+		const uint64_t MESH_KEEP_FRAMES = 120;
+	}
+
+	void TrackRenderer::SetSleeperModel(uint32_t model, float radius)
+	{
+		m_sleeperModel = model;
+		m_sleeperRadius = radius;
+		Invalidate();
+	}
+
+	void TrackRenderer::SetSleeperMeshes(std::vector<MeshData> parts)
+	{
+		m_sleeperMeshes = std::move(parts);
+		Invalidate();
+	}
+
+	void TrackRenderer::SetRailModel(uint32_t model)
+	{
+		m_railModel = model;
+	}
+
+	void TrackRenderer::SetRailProfile(RailProfile profile)
+	{
+		m_railProfile = std::move(profile);
+		Invalidate();
+	}
+
+	void TrackRenderer::Invalidate(const SleeperChunks& sleepers)
+	{
+		if (m_invalidFrom.size() != sleepers.EdgeCount())
+		{
+			// The edges themselves changed
+			m_invalidAll = true;
+			m_invalidFrom.assign(sleepers.EdgeCount(), SIZE_MAX);
+		}
+		for (auto& change : sleepers.Changes())
+		{
+			auto& from = m_invalidFrom[change.edge];
+			from = std::min(from, change.firstChunk);
+		}
+		m_dirty = true;
+		m_geometryDirty = true;
+	}
+
+	void TrackRenderer::Invalidate()
+	{
+		m_invalidAll = true;
+		m_dirty = true;
+		m_geometryDirty = true;
+	}
+
+	void TrackRenderer::FollowCamera(const Track::Vec3& camera, double rebaseDistance)
+	{
+		// Positions are shifted by -origin in double before they become float,
+		// so the instances only need repacking after a step
+		m_camera = camera;
+		if ((camera - m_origin).Length() > rebaseDistance)
+		{
+			m_origin = camera;
+			m_dirty = true;
+		}
+	}
+
+	void TrackRenderer::Release(RenderBackend& backend, size_t resident)
+	{
+		for (auto mesh : m_residents[resident].meshes)
+		{
+			backend.ReleaseMesh(mesh);
+		}
+		m_residents[resident] = std::move(m_residents.back());
+		m_residents.pop_back();
+	}
+
+	void TrackRenderer::ReleaseMeshes(RenderBackend& backend)
+	{
+		while (!m_residents.empty())
+		{
+			Release(backend, m_residents.size() - 1);
+		}
+		for (auto& resident : m_resident)
+		{
+			std::fill(resident.begin(), resident.end(), NONE);
+		}
+	}
+
+	void TrackRenderer::UpdateResidents(RenderBackend& backend)
+	{
+		// Meshes of rebuilt chunks go, the others move to the new chunk numbering
+		for (size_t r = 0; r < m_residents.size(); )
+		{
+			auto& resident = m_residents[r];
+			if (m_invalidAll || resident.edge >= m_invalidFrom.size() || resident.index >= m_invalidFrom[resident.edge])
+			{
+				Release(backend, r);
+				continue;
+			}
+			resident.chunk = m_culler.FirstChunk(resident.edge) + resident.index;
+			r++;
+		}
+
+		size_t count = m_culler.ChunkCount();
+		m_far.assign(count, 0);
+		for (auto& resident : m_resident)
+		{
+			resident.assign(count, NONE);
+		}
+		for (uint32_t r = 0; r < m_residents.size(); r++)
+		{
+			auto& resident = m_residents[r];
+			m_resident[resident.kind][resident.chunk] = r;
+			if (resident.kind == LodMeshes)
+			{
+				m_far[resident.chunk] = 1;
+			}
+		}
+
+		m_invalidAll = false;
+		m_invalidFrom.assign(m_invalidFrom.size(), SIZE_MAX);
+	}
+
+	void TrackRenderer::AddResident(uint32_t chunk, Kind kind, std::vector<uint32_t> meshes)
+	{
+		auto& sleeperChunk = m_culler.GetChunk(chunk);
+		Resident resident;
+		resident.edge = sleeperChunk.edge;
+		resident.index = chunk - m_culler.FirstChunk(sleeperChunk.edge);
+		resident.chunk = chunk;
+		resident.kind = kind;
+		resident.lastUsed = m_frame;
+		resident.meshes = std::move(meshes);
+
+		m_resident[kind][chunk] = static_cast<uint32_t>(m_residents.size());
+		m_residents.push_back(std::move(resident));
+	}
+
+	void TrackRenderer::Render(RenderBackend& backend, const SleeperChunks& sleepers, const RailSweep& rails,
+		const Catenary* catenary, const Float4x4& view, const Float4x4& projection)
+	{
+		if ((catenary != nullptr) != m_catenary)
+		{
+			// The LOD meshes carry the overhead line, the culling boxes reach up to it
+			m_catenary = catenary != nullptr;
+			Invalidate();
+		}
+		float reach = catenary ? catenary->Reach() : 0.f;
+		if (m_dirty || reach != m_cullReach)
+		{
+			m_instances.resize(sleepers.InstanceCount());
+			sleepers.PackInstances(m_origin, m_instances.data());
+			m_culler.Build(sleepers, m_origin, m_sleeperRadius, reach);
+			m_cullReach = reach;
+			m_uploadValid = false;
+			m_dirty = false;
+		}
+		if (m_geometryDirty || m_far.size() != m_culler.ChunkCount())
+		{
+			// A move of the render origin keeps the chunks and their meshes
+			m_invalidFrom.resize(sleepers.EdgeCount(), SIZE_MAX);
+			UpdateResidents(backend);
+			m_geometryDirty = false;
+		}
+		m_frame++;
+
+		auto frustum = Frustum::FromViewProjection(view, projection);
+		m_culler.CullChunks(frustum, m_visibleChunks);
+
+		auto eyeOffset = m_camera - m_origin;
+		Float3 eye = { float(eyeOffset.x), float(eyeOffset.y), float(eyeOffset.z) };
+		bool baked = m_staticBatching && !m_sleeperMeshes.empty();
+		m_visible.clear();
+		m_nearVisible.clear();
+		m_bakedVisible.clear();
+		m_farVisible.clear();
+		for (auto& chunk : m_visibleChunks)
+		{
+			float distance = m_culler.Distance(chunk.chunk, eye);
+			auto& far = m_far[chunk.chunk];
+			if (far ? distance < LOD_DISTANCE - LOD_HYSTERESIS : distance > LOD_DISTANCE + LOD_HYSTERESIS)
+			{
+				far = !far;
+			}
+
+			if (far)
+			{
+				m_farVisible.push_back(chunk.chunk);
+				continue;
+			}
+			m_nearVisible.push_back(chunk.chunk);
+			if (baked)
+			{
+				m_bakedVisible.push_back(chunk.chunk);
+			}
+			else
+			{
+				m_culler.AppendInstances(frustum, chunk, m_visible);
+			}
+		}
+
+		// All near sleepers in one instanced draw per mesh part
+		if (!m_uploadValid || m_visible != m_uploaded)
+		{
+			m_batcher.Clear();
+			InstanceTransform* out = m_batcher.Append(m_sleeperModel, m_visible.size());
+			for (auto index : m_visible)
+			{
+				*out++ = m_instances[index];
+			}
+			m_batcher.Upload(backend);
+			m_uploaded = m_visible;
+			m_uploadValid = true;
+		}
+
+		backend.SetMatrices(IdentityMatrix(), view, projection);
+		m_batcher.Draw(backend);
+
+		DrawBakedChunks(backend, view, projection);
+		DrawNearChunks(backend, RailMeshes, 2, [&](const SleeperChunk& chunk, size_t index, size_t rail, MeshData& data)
+		{
+			RailSweep::BuildMesh(rails.GetChunk(chunk.edge, index), m_railProfile, static_cast<int>(rail), data);
+		}, view, projection);
+		if (catenary)
+		{
+			DrawNearChunks(backend, CatenaryMeshes, 1, [&](const SleeperChunk& chunk, size_t index, size_t, MeshData& data)
+			{
+				Catenary::AppendMesh(catenary->GetChunk(chunk.edge, index), catenary->Settings(), true, data);
+			}, view, projection);
+		}
+		DrawFarChunks(backend, catenary, view, projection);
+
+		// Meshes of chunks that stayed out of view (or switched LOD)
+		for (size_t r = 0; r < m_residents.size(); )
+		{
+			auto& resident = m_residents[r];
+			if (m_frame - resident.lastUsed <= MESH_KEEP_FRAMES)
+			{
+				r++;
+				continue;
+			}
+			m_resident[resident.kind][resident.chunk] = NONE;
+			Release(backend, r);
+			if (r < m_residents.size())
+			{
+				auto& moved = m_residents[r];
+				m_resident[moved.kind][moved.chunk] = static_cast<uint32_t>(r);
+			}
+		}
+	}
+
+	void TrackRenderer::DrawResident(RenderBackend& backend, Resident& resident, const Float4x4& view, const Float4x4& projection)
+	{
+		resident.lastUsed = m_frame;
+		auto& offset = m_culler.ChunkOffset(resident.chunk);
+		backend.SetMatrices(TranslationMatrix(offset.x, offset.y, offset.z), view, projection);
+		bool railModel = (resident.kind == RailMeshes || resident.kind == CatenaryMeshes) && m_railModel != NONE;
+		uint32_t model = railModel ? m_railModel : m_sleeperModel;
+		for (uint32_t m = 0; m < resident.meshes.size(); m++)
+		{
+			// Baked meshes follow the model parts, the others use the first
+			backend.DrawMesh(resident.meshes[m], model, resident.kind == BakedMeshes ? m : 0);
+		}
+	}
+
+	void TrackRenderer::DrawBakedChunks(RenderBackend& backend, const Float4x4& view, const Float4x4& projection)
+	{
+		// Chunks coming into view are baked together, spread over the pool
+		std::vector<const SleeperChunk*> missing;
+		std::vector<uint32_t> missingChunks;
+		for (auto c : m_bakedVisible)
+		{
+			if (m_resident[BakedMeshes][c] == NONE)
+			{
+				missing.push_back(&m_culler.GetChunk(c));
+				missingChunks.push_back(c);
+			}
+		}
+		if (!missing.empty())
+		{
+			std::vector<MeshData> baked;
+			BakeChunks(m_sleeperMeshes, missing, baked);
+			size_t parts = m_sleeperMeshes.size();
+			for (size_t m = 0; m < missing.size(); m++)
+			{
+				std::vector<uint32_t> meshes;
+				for (size_t p = 0; p < parts; p++)
+				{
+					meshes.push_back(backend.CreateMesh(baked[m * parts + p]));
+				}
+				AddResident(missingChunks[m], BakedMeshes, std::move(meshes));
+			}
+		}
+
+		for (auto c : m_bakedVisible)
+		{
+			DrawResident(backend, m_residents[m_resident[BakedMeshes][c]], view, projection);
+		}
+	}
+
+	void TrackRenderer::DrawNearChunks(RenderBackend& backend, Kind kind, size_t meshes,
+		const std::function<void(const SleeperChunk& chunk, size_t index, size_t mesh, MeshData& data)>& build,
+		const Float4x4& view, const Float4x4& projection)
+	{
+		// The meshes of every chunk coming into view are built in parallel
+		auto& residents = m_resident[kind];
+		std::vector<uint32_t> missing;
+		for (auto c : m_nearVisible)
+		{
+			if (residents[c] == NONE)
+			{
+				missing.push_back(c);
+			}
+		}
+		if (!missing.empty())
+		{
+			std::vector<MeshData> data(missing.size() * meshes);
+			Track::ParallelFor(data.size(), [&](size_t m)
+			{
+				uint32_t chunk = missing[m / meshes];
+				auto& sleeperChunk = m_culler.GetChunk(chunk);
+				build(sleeperChunk, chunk - m_culler.FirstChunk(sleeperChunk.edge), m % meshes, data[m]);
+			});
+			for (size_t c = 0; c < missing.size(); c++)
+			{
+				if (data[c * meshes].indices.empty())
+				{
+					continue;
+				}
+				std::vector<uint32_t> created;
+				for (size_t m = 0; m < meshes; m++)
+				{
+					created.push_back(backend.CreateMesh(data[c * meshes + m]));
+				}
+				AddResident(missing[c], kind, std::move(created));
+			}
+		}
+
+		for (auto c : m_nearVisible)
+		{
+			if (residents[c] != NONE)
+			{
+				DrawResident(backend, m_residents[residents[c]], view, projection);
+			}
+		}
+	}
+
+	void TrackRenderer::DrawFarChunks(RenderBackend& backend, const Catenary* catenary, const Float4x4& view, const Float4x4& projection)
+	{
+		for (auto c : m_farVisible)
+		{
+			if (m_resident[LodMeshes][c] == NONE)
+			{
+				auto& chunk = m_culler.GetChunk(c);
+				const SleeperChunk* next = nullptr;
+				if (c + 1 < m_culler.ChunkCount() && m_culler.GetChunk(c + 1).edge == chunk.edge)
+				{
+					next = &m_culler.GetChunk(c + 1);
+				}
+				BuildLodMesh(chunk, next, m_lodMesh);
+				if (catenary)
+				{
+					size_t index = c - m_culler.FirstChunk(chunk.edge);
+					Catenary::AppendMesh(catenary->GetChunk(chunk.edge, index), catenary->Settings(), false, m_lodMesh);
+				}
+				if (m_lodMesh.indices.empty())
+				{
+					continue;
+				}
+				AddResident(c, LodMeshes, { backend.CreateMesh(m_lodMesh) });
+			}
+			DrawResident(backend, m_residents[m_resident[LodMeshes][c]], view, projection);
+		}
+	}
+}
@@ -0,0 +1,155 @@
+//
+// TrackRenderer.h - Submits the track of a route to a RenderBackend
+//
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "Catenary.h"
+#include "ChunkCuller.h"
+#include "InstanceBatcher.h"
+#include "RailSweep.h"
+#include "RenderBackend.h"
+#include "SleeperChunks.h"
+
+namespace Gfx
+{
+	// Everything the frame needs from the route, independent of the GPU API:
+	// the same calls reach D3D12 in the game and a RecordingRenderBackend in
+	// trackgen, so draw counts can be checked without a device.
+	//
+	// Visible chunks near the camera are drawn as sleeper instances, or with
+	// static batching as one baked mesh per chunk and model part (see
+	// ChunkBaker.h). Chunks beyond LOD_DISTANCE are one low-detail mesh each
+	// (see TrackLod.h). The switch has a hysteresis band, so a chunk at the
+	// threshold does not flip every frame. Near chunks also get both rails as
+	// continuous swept meshes (see RailSweep.h). The overhead line (see
+	// Catenary.h) is one more mesh per near chunk and part of the LOD mesh
+	// of a far one.
+	//
+	// Chunk meshes are built when a chunk is first drawn that way and
+	// released after it has not been for a while; an edit only drops the
+	// meshes of the chunks it rebuilt.
+	class TrackRenderer
+	{
+	public:
+		static constexpr float LOD_DISTANCE = 150.f;
+		static constexpr float LOD_HYSTERESIS = 10.f;   // on either side of LOD_DISTANCE
+
+		// Backend id of the sleeper model and the radius of its bounding
+		// sphere around the instance origin (for culling).
+		void SetSleeperModel(uint32_t model, float radius);
+
+		// The parts of the sleeper model as plain meshes, in the order the
+		// backend draws them, for static batching.
+		void SetSleeperMeshes(std::vector<MeshData> parts);
+
+		// Backend model whose first part textures the swept rails and the
+		// overhead line (the sleeper model if none is set), and the rail
+		// cross section.
+		void SetRailModel(uint32_t model);
+		void SetRailProfile(RailProfile profile);
+
+		// Near chunks as baked meshes instead of instances. Needs
+		// SetSleeperMeshes.
+		void SetStaticBatching(bool enabled) { m_staticBatching = enabled; }
+		bool StaticBatching() const { return m_staticBatching; }
+
+		// The sleepers changed: sleepers.Changes() tells which chunks, only
+		// their meshes (and rails) are rebuilt. Without arguments everything is.
+		void Invalidate(const SleeperChunks& sleepers);
+		void Invalidate();
+
+		// Moves the render origin to the camera when it got further than
+		// rebaseDistance away. Views are built relative to Origin(); the
+		// camera also decides the LOD of every chunk.
+		void FollowCamera(const Track::Vec3& camera, double rebaseDistance);
+		const Track::Vec3& Origin() const { return m_origin; }
+
+		// Culls against the view frustum and draws what is visible. The
+		// visible instances are only uploaded again when the set changed.
+		// rails and catenary must be built from the same chunks as sleepers;
+		// catenary may be null for track without overhead line.
+		void Render(RenderBackend& backend, const SleeperChunks& sleepers, const RailSweep& rails,
+			const Catenary* catenary, const Float4x4& view, const Float4x4& projection);
+
+		// Backend meshes go with the backend: releases them all.
+		void ReleaseMeshes(RenderBackend& backend);
+
+		size_t VisibleCount() const { return m_visible.size(); }
+		size_t BakedChunkCount() const { return m_bakedVisible.size(); }
+		size_t FarChunkCount() const { return m_farVisible.size(); }
+		size_t NearChunkCount() const { return m_nearVisible.size(); }
+
+	private:
+		static constexpr uint32_t NONE = 0xffffffffu;
+
+		enum Kind : uint8_t
+		{
+			LodMeshes,                  // one low-detail mesh
+			BakedMeshes,                // one baked mesh per sleeper model part
+			RailMeshes,                 // one swept mesh per rail
+			CatenaryMeshes,             // one overhead line mesh
+			KIND_COUNT
+		};
+
+		// Backend meshes of one chunk
+		struct Resident
+		{
+			uint32_t edge;
+			uint32_t index;             // chunk within the edge
+			uint32_t chunk;             // culler chunk
+			Kind kind;
+			uint64_t lastUsed;
+			std::vector<uint32_t> meshes;
+		};
+
+		void UpdateResidents(RenderBackend& backend);
+		void Release(RenderBackend& backend, size_t resident);
+		void AddResident(uint32_t chunk, Kind kind, std::vector<uint32_t> meshes);
+		void DrawBakedChunks(RenderBackend& backend, const Float4x4& view, const Float4x4& projection);
+		void DrawNearChunks(RenderBackend& backend, Kind kind, size_t meshes,
+			const std::function<void(const SleeperChunk& chunk, size_t index, size_t mesh, MeshData& data)>& build,
+			const Float4x4& view, const Float4x4& projection);
+		void DrawFarChunks(RenderBackend& backend, const Catenary* catenary, const Float4x4& view, const Float4x4& projection);
+		void DrawResident(RenderBackend& backend, Resident& resident, const Float4x4& view, const Float4x4& projection);
+
+		InstanceBatcher m_batcher;
+		ChunkCuller m_culler;
+		std::vector<InstanceTransform> m_instances;  // every sleeper, relative to m_origin
+		std::vector<ChunkCuller::VisibleChunk> m_visibleChunks;
+		std::vector<uint32_t> m_visible;
+		std::vector<uint32_t> m_uploaded;            // visible set in the backend's buffer
+		uint32_t m_sleeperModel = 0;
+		float m_sleeperRadius = 0.f;
+		std::vector<MeshData> m_sleeperMeshes;
+		uint32_t m_railModel = NONE;
+		RailProfile m_railProfile = RailProfile::FlatBottom();
+		bool m_staticBatching = false;
+		bool m_dirty = true;
+		bool m_geometryDirty = true;
+		bool m_uploadValid = false;
+		bool m_catenary = false;                     // built into the LOD meshes
+		float m_cullReach = 0.f;
+		Track::Vec3 m_origin;
+		Track::Vec3 m_camera;
+
+		// Edits since the last Render: per edge the first rebuilt chunk
+		bool m_invalidAll = true;
+		std::vector<size_t> m_invalidFrom;
+
+		// Per culler chunk: drawn far, and its resident meshes of each kind
+		// (index into m_residents or NONE)
+		std::vector<uint8_t> m_far;
+		std::vector<uint32_t> m_resident[KIND_COUNT];
+		std::vector<Resident> m_residents;
+		std::vector<uint32_t> m_farVisible;
+		std::vector<uint32_t> m_nearVisible;
+		std::vector<uint32_t> m_bakedVisible;
+		MeshData m_lodMesh;
+		uint64_t m_frame = 0;
+	};
+}
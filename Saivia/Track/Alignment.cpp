@@ -0,0 +1,350 @@
+//
+// Alignment.cpp
+//
+
+#include "Alignment.h"
+
+#include <algorithm>
+#include <complex>
+
+#include "Fresnel.h"
+
+namespace Track
+{
+	namespace
+	{
+		const double PI = 3.14159265358979323846;
+
+		// Below this |dk/ds| * length^2 the quadratic heading term is far under a
+		// micro-radian and the segment is evaluated as an arc of mean curvature.
+		const double TRANSITION_EPSILON = 1e-9;
+
+		// sin(x) / x, exact enough around 0 for the chord of a nearly straight arc
+		double Sinc(double x)
+		{
+			if (std::abs(x) < 1e-4)
+			{
+				return 1.0 - x * x / 6.0;
+			}
+			return std::sin(x) / x;
+		}
+
+		double CurvatureRate(const Segment& segment)
+		{
+			return segment.length > 0.0 ? (segment.endCurvature - segment.curvature) / segment.length : 0.0;
+		}
+
+		// Offset from the start of an arc whose mean curvature over [0, ds] is k
+		Vec3 ArcOffset(double heading, double k, double ds)
+		{
+			double half = 0.5 * k * ds;
+			double chord = ds * Sinc(half);
+			double mean = heading + half;
+			return { std::sin(mean) * chord, 0.0, std::cos(mean) * chord };
+		}
+
+		// Clothoid with heading h0 + k0 t + a t^2 / 2. Written as a complex number
+		// (z + i x) the offset is e^(i h0) * integral 0..ds of e^(i (k0 t + a t^2 / 2)) dt.
+		// Completing the square turns the integral into a difference of Fresnel
+		// integrals F = C + i S:
+		//     sqrt(pi / a) e^(-i k0^2 / 2a) (F(x0 + ds sqrt(a / pi)) - F(x0)),  x0 = k0 / sqrt(pi a)
+		// For a < 0 the integral is the conjugate of the one for (-k0, -a).
+		struct Clothoid
+		{
+			std::complex<double> factor; // e^(i h0) * sqrt(pi / |a|) e^(-i k0^2 / 2|a|), sign folded in
+			std::complex<double> F0;
+			double x0;
+			double xPerDistance;
+			bool conjugate;
+
+			Clothoid(double heading, double k0, double a)
+			{
+				conjugate = a < 0.0;
+				double absA = std::abs(a);
+				double kappa = conjugate ? -k0 : k0;
+
+				x0 = kappa / std::sqrt(PI * absA);
+				xPerDistance = std::sqrt(absA / PI);
+
+				double C0, S0;
+				Fresnel(x0, C0, S0);
+				F0 = { C0, S0 };
+
+				// conj(p * (F - F0)) = conj(p) * (conj(F) - conj(F0)); the conjugate of
+				// the phase is taken here, the Fresnel values are conjugated per point.
+				std::complex<double> phase = std::polar(std::sqrt(PI / absA), -kappa * kappa / (2.0 * absA));
+				if (conjugate)
+				{
+					phase = std::conj(phase);
+					F0 = std::conj(F0);
+				}
+				factor = std::polar(1.0, heading) * phase;
+			}
+
+			Vec3 Offset(double C, double S) const
+			{
+				std::complex<double> F(C, conjugate ? -S : S);
+				std::complex<double> w = factor * (F - F0);
+				return { w.imag(), 0.0, w.real() };
+			}
+		};
+	}
+
+	bool Segment::IsTransition() const
+	{
+		double a = CurvatureRate(*this);
+		return std::abs(a) * length * length >= TRANSITION_EPSILON;
+	}
+
+	void Alignment::Clear(const Pose& start)
+	{
+		m_start = start;
+		m_start.Pos.y = 0.0;
+		m_startElevation = start.Pos.y;
+		m_segments.clear();
+		m_commandSegment.clear();
+		m_profile.Reset(start.Pos.y, start.grade);
+	}
+
+	double Alignment::Rebuild(const Railway& railway, size_t firstCommand)
+	{
+		firstCommand = std::min(firstCommand, m_commandSegment.size());
+		if (firstCommand < m_commandSegment.size())
+		{
+			m_segments.resize(m_commandSegment[firstCommand]);
+			m_commandSegment.resize(firstCommand);
+		}
+		double changed = Length();
+
+		// The profile is a handful of pieces; replaying the kept gradients is
+		// cheaper than remembering every intermediate state.
+		m_profile.Reset(m_startElevation, m_start.grade);
+		for (size_t n = 0; n < firstCommand; n++)
+		{
+			auto& command = railway.data[n];
+			if (command.type == CommandType::Gradient)
+			{
+				m_profile.AddGradeChange(CommandChainage(n), command.gradient / 1000.0, command.length);
+			}
+		}
+
+		for (size_t n = firstCommand; n < railway.data.size(); n++)
+		{
+			Append(railway.data[n]);
+		}
+		return changed;
+	}
+
+	double Alignment::CommandChainage(size_t command) const
+	{
+		if (command >= m_commandSegment.size())
+		{
+			return Length();
+		}
+		size_t segments = m_commandSegment[command];
+		return segments == 0 ? 0.0 : m_segments[segments - 1].s0 + m_segments[segments - 1].length;
+	}
+
+	void Alignment::Build(const Railway& railway, const Pose& start)
+	{
+		Clear(start);
+		m_segments.reserve(railway.data.size() + 1);
+		m_commandSegment.reserve(railway.data.size());
+
+		if (railway.hasBranch && railway.branch.radius > 0.0 && railway.branch.frogNumber > 0.0)
+		{
+			// Diverging lead curve of the turnout, up to the frog angle
+			auto& branch = railway.branch;
+			Segment lead;
+			lead.start = m_start.Pos;
+			lead.heading = m_start.heading;
+			lead.length = branch.radius * std::atan(1.0 / branch.frogNumber);
+			lead.curvature = ((branch.turn == Turn::Left) ? 1.0 : -1.0) / branch.radius;
+			lead.endCurvature = lead.curvature;
+			m_segments.push_back(lead);
+		}
+
+		for (auto& command : railway.data)
+		{
+			Append(command);
+		}
+	}
+
+	void Alignment::Append(const Command& command)
+	{
+		m_commandSegment.push_back(m_segments.size());
+
+		if (command.type == CommandType::Gradient)
+		{
+			m_profile.AddGradeChange(Length(), command.gradient / 1000.0, command.length);
+			return;
+		}
+
+		Pose end = End();
+
+		Segment segment;
+		segment.s0 = Length();
+		segment.length = command.length;
+		segment.start = end.Pos;
+		segment.heading = end.heading;
+
+		double sign = (command.turn == Turn::Left) ? 1.0 : -1.0;
+
+		switch (command.type)
+		{
+		case CommandType::Straight:
+			break;
+		case CommandType::Curve:
+			if (command.radius != 0)
+			{
+				segment.curvature = sign / command.radius;
+				// World.json cant is applied as a rotation of sin(cant) towards the center
+				segment.bank = sign * std::sin(command.cant);
+			}
+			break;
+		case CommandType::TransitionCurve:
+			// Starts from wherever the previous segment ended
+			segment.curvature = end.curvature;
+			segment.bank = end.bank;
+			if (command.radius != 0)
+			{
+				segment.endCurvature = sign / command.radius;
+				segment.endBank = sign * std::sin(command.cant);
+			}
+			m_segments.push_back(segment);
+			return;
+		case CommandType::Gradient:
+			break;
+		}
+
+		segment.endCurvature = segment.curvature;
+		segment.endBank = segment.bank;
+		m_segments.push_back(segment);
+	}
+
+	double Alignment::Length() const
+	{
+		if (m_segments.empty())
+		{
+			return 0.0;
+		}
+		auto& last = m_segments.back();
+		return last.s0 + last.length;
+	}
+
+	Pose Alignment::Evaluate(const Segment& segment, double ds)
+	{
+		double a = CurvatureRate(segment);
+		double t = segment.length > 0.0 ? ds / segment.length : 0.0;
+
+		Pose pose;
+		EvaluatePositions(segment, &ds, 1, &pose.Pos);
+		pose.heading = segment.heading + (segment.curvature + 0.5 * a * ds) * ds;
+		pose.curvature = segment.curvature + a * ds;
+		pose.bank = segment.bank + (segment.endBank - segment.bank) * t;
+		return pose;
+	}
+
+	void Alignment::EvaluatePositions(const Segment& segment, const double* ds, size_t n, Vec3* positions)
+	{
+		double a = CurvatureRate(segment);
+
+		if (!segment.IsTransition())
+		{
+			// Arc (or straight): the chord from the start has length 2 sin(k ds / 2) / k
+			// and points along the mean heading.
+			for (size_t i = 0; i < n; i++)
+			{
+				double k = segment.curvature + 0.5 * a * ds[i];
+				positions[i] = segment.start + ArcOffset(segment.heading, k, ds[i]);
+			}
+			return;
+		}
+
+		Clothoid clothoid(segment.heading, segment.curvature, a);
+
+		const size_t BATCH = 256;
+		double x[BATCH], C[BATCH], S[BATCH];
+		for (size_t base = 0; base < n; base += BATCH)
+		{
+			size_t count = std::min(BATCH, n - base);
+			for (size_t i = 0; i < count; i++)
+			{
+				x[i] = clothoid.x0 + ds[base + i] * clothoid.xPerDistance;
+			}
+			FresnelBatch(x, count, C, S);
+			for (size_t i = 0; i < count; i++)
+			{
+				positions[base + i] = segment.start + clothoid.Offset(C[i], S[i]);
+			}
+		}
+	}
+
+	size_t Alignment::FindSegment(double s) const
+	{
+		auto it = std::upper_bound(m_segments.begin(), m_segments.end(), s,
+			[](double value, const Segment& segment) { return value < segment.s0; });
+		return it == m_segments.begin() ? 0 : static_cast<size_t>(it - m_segments.begin()) - 1;
+	}
+
+	Pose Alignment::EvaluateClamped(size_t index, double& s) const
+	{
+		if (m_segments.empty())
+		{
+			s = 0.0;
+			return m_start;
+		}
+		auto& segment = m_segments[index];
+		double ds = std::min(std::max(s - segment.s0, 0.0), segment.length);
+		s = segment.s0 + ds;
+		return Evaluate(segment, ds);
+	}
+
+	Pose Alignment::At(double s) const
+	{
+		Pose pose = EvaluateClamped(FindSegment(s), s);
+		m_profile.Evaluate(s, pose.Pos.y, pose.grade);
+		return pose;
+	}
+
+	Frame Alignment::FrameAt(double s) const
+	{
+		return MakeFrame(At(s));
+	}
+
+	Pose Alignment::Cursor::At(double s)
+	{
+		auto& segments = m_alignment->m_segments;
+		if (!segments.empty())
+		{
+			// Re-seek also when the alignment was rebuilt shorter under the cursor
+			if (m_index >= segments.size() || s < segments[m_index].s0)
+			{
+				m_index = m_alignment->FindSegment(s);
+			}
+			while (m_index + 1 < segments.size() && segments[m_index + 1].s0 <= s)
+			{
+				m_index++;
+			}
+		}
+
+		Pose pose = m_alignment->EvaluateClamped(m_index, s);
+		m_profile.Evaluate(s, pose.Pos.y, pose.grade);
+		return pose;
+	}
+
+	Frame Alignment::Cursor::FrameAt(double s)
+	{
+		return MakeFrame(At(s));
+	}
+
+	Pose Alignment::End() const
+	{
+		if (m_segments.empty())
+		{
+			return m_start;
+		}
+		auto& last = m_segments.back();
+		return Evaluate(last, last.length);
+	}
+}
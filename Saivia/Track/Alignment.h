@@ -0,0 +1,141 @@
+//
+// Alignment.h - Analytic horizontal alignment built from railway commands
+//
+
+#pragma once
+
+#include <vector>
+
+#include "Railway.h"
+#include "TrackMath.h"
+#include "VerticalProfile.h"
+
+namespace Track
+{
+	// Heading is measured in the XZ plane from +Z towards +X, so a heading of 0
+	// matches the initial T = (0, 0, 1). Curvature is signed (1 / R), positive
+	// turns left (towards +X, the initial B).
+	struct Segment
+	{
+		double s0 = 0.0;        // chainage at start
+		double length = 0.0;
+		Vec3 start;             // position at s0
+		double heading = 0.0;   // heading at s0
+		double curvature = 0.0; // at s0
+		double bank = 0.0;      // cant at s0, rotation of N around T (positive tilts towards +B)
+
+		// Curvature and bank change linearly along the segment. Curvature only
+		// changes on a transition curve (clothoid); the bank can also ramp
+		// along an arc of one radius.
+		double endCurvature = 0.0;
+		double endBank = 0.0;
+
+		bool IsTransition() const;
+	};
+
+	// Position and orientation of the centre line at one chainage.
+	struct Pose
+	{
+		Vec3 Pos;
+		double heading = 0.0;
+		double curvature = 0.0;
+		double bank = 0.0;
+		double grade = 0.0;     // dy/ds of the vertical profile
+	};
+
+	class Alignment
+	{
+	public:
+		// Builds the alignment of a railway starting at `start` (position,
+		// heading, elevation and grade; the default is the origin heading +Z).
+		void Build(const Railway& railway, const Pose& start = Pose());
+		void Append(const Command& command);
+		void Clear(const Pose& start = Pose());
+
+		// Rebuilds from command firstCommand on after railway.data was edited
+		// there; the segments of the earlier commands are kept as they are.
+		// Returns the chainage from which the alignment may have changed.
+		double Rebuild(const Railway& railway, size_t firstCommand);
+
+		// Chainage at which a command of the last Build starts.
+		double CommandChainage(size_t command) const;
+
+		const std::vector<Segment>& Segments() const { return m_segments; }
+		const VerticalProfile& Profile() const { return m_profile; }
+		double Length() const;
+
+		// Horizontal pose at distance ds (0..length) into a segment; closed form,
+		// no stepping. Elevation and grade come from Profile().
+		static Pose Evaluate(const Segment& segment, double ds);
+
+		// Centre-line positions at n distances into one segment. Transition
+		// curves evaluate their Fresnel integrals in one batch.
+		static void EvaluatePositions(const Segment& segment, const double* ds, size_t n, Vec3* positions);
+
+		// Full pose (including elevation and grade) at chainage s, clamped to
+		// the alignment. Binary search over the segments.
+		Pose At(double s) const;
+		Frame FrameAt(double s) const;
+		size_t FindSegment(double s) const;
+
+		// Sequential queries (camera, train, structure placement). Moving
+		// forward walks the segment and profile indices along, so a run of
+		// increasing chainages costs amortized O(1) each; moving backward
+		// falls back to the binary search.
+		class Cursor
+		{
+		public:
+			Cursor() : m_alignment(nullptr), m_index(0) {}
+			explicit Cursor(const Alignment& alignment) : m_alignment(&alignment), m_index(0), m_profile(alignment.Profile()) {}
+
+			Pose At(double s);
+			Frame FrameAt(double s);
+
+		private:
+			const Alignment* m_alignment;
+			size_t m_index;
+			VerticalProfile::Cursor m_profile;
+		};
+
+		// Horizontal pose at the end of the alignment, i.e. where the next command starts.
+		Pose End() const;
+
+	private:
+		Pose EvaluateClamped(size_t index, double& s) const;
+
+		Pose m_start;
+		double m_startElevation = 0.0;
+		std::vector<Segment> m_segments;
+		std::vector<size_t> m_commandSegment;   // segments before each appended command
+		VerticalProfile m_profile;
+	};
+
+	// B N T frame: T follows the heading pitched up by the grade, N is
+	// perpendicular to T in the vertical plane and banked around T.
+	inline Frame MakeFrame(const Vec3& pos, double sinHeading, double cosHeading, double grade, double sinBank, double cosBank)
+	{
+		double cp = 1.0 / std::sqrt(1.0 + grade * grade);
+		double sp = grade * cp;
+
+		// Unbanked: T = (sin h cos p, sin p, cos h cos p), N = (-sin h sin p, cos p, -cos h sin p)
+		// and B = N x T = (cos h, 0, -sin h). Banking rotates N and B around T.
+		Frame frame;
+		frame.T = { sinHeading * cp, sp, cosHeading * cp };
+		frame.N = {
+			-sinHeading * sp * cosBank + cosHeading * sinBank,
+			cp * cosBank,
+			-cosHeading * sp * cosBank - sinHeading * sinBank };
+		frame.B = {
+			cosHeading * cosBank + sinHeading * sp * sinBank,
+			-cp * sinBank,
+			-sinHeading * cosBank + cosHeading * sp * sinBank };
+		frame.Pos = pos;
+		return frame;
+	}
+
+	inline Frame MakeFrame(const Pose& pose)
+	{
+		return MakeFrame(pose.Pos, std::sin(pose.heading), std::cos(pose.heading), pose.grade,
+			std::sin(pose.bank), std::cos(pose.bank));
+	}
+}
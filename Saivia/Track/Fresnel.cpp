@@ -0,0 +1,104 @@
+//
+// Fresnel.cpp
+//
+
+#include "Fresnel.h"
+
+#include <cmath>
+#include <complex>
+
+namespace Track
+{
+	namespace
+	{
+		const double PI = 3.14159265358979323846;
+		const double EPS = 1e-16;
+		const double SERIES_LIMIT = 1.5;
+		const int MAX_ITERATIONS = 100;
+
+		// C(x) = sum (-1)^n (pi/2)^2n x^(4n+1) / ((2n)! (4n+1))
+		// S(x) = sum (-1)^n (pi/2)^(2n+1) x^(4n+3) / ((2n+1)! (4n+3))
+		void FresnelSeries(double ax, double& C, double& S)
+		{
+			double fact = 0.5 * PI * ax * ax;
+			double term = ax;
+			double sumC = ax;
+			double sumS = 0.0;
+			double sign = 1.0;
+			for (int k = 1; k < MAX_ITERATIONS; k += 2)
+			{
+				// odd k feeds S, the following even k feeds C
+				term *= fact / k;
+				sumS += sign * term / (2 * k + 1);
+				term *= fact / (k + 1);
+				sign = -sign;
+				double c = sign * term / (2 * k + 3);
+				sumC += c;
+				if (term < EPS * sumC)
+				{
+					break;
+				}
+			}
+			C = sumC;
+			S = sumS;
+		}
+
+		// Continued fraction for erfc of the complex argument (1 - i) sqrt(pi) x / 2
+		void FresnelContinuedFraction(double ax, double& C, double& S)
+		{
+			using complex = std::complex<double>;
+
+			double pix2 = PI * ax * ax;
+			complex b(1.0, -pix2);
+			complex cc(1e300, 0.0);
+			complex d = 1.0 / b;
+			complex h = d;
+			int n = -1;
+			for (int k = 2; k <= MAX_ITERATIONS; k++)
+			{
+				n += 2;
+				double a = -n * (n + 1.0);
+				b += 4.0;
+				d = 1.0 / (a * d + b);
+				cc = b + a / cc;
+				complex del = cc * d;
+				h *= del;
+				if (std::abs(del.real() - 1.0) + std::abs(del.imag()) < EPS)
+				{
+					break;
+				}
+			}
+			h *= complex(ax, -ax);
+			complex cs = complex(0.5, 0.5) * (1.0 - complex(std::cos(0.5 * pix2), std::sin(0.5 * pix2)) * h);
+			C = cs.real();
+			S = cs.imag();
+		}
+	}
+
+	void Fresnel(double x, double& C, double& S)
+	{
+		double ax = std::abs(x);
+		if (ax <= SERIES_LIMIT)
+		{
+			FresnelSeries(ax, C, S);
+		}
+		else
+		{
+			FresnelContinuedFraction(ax, C, S);
+		}
+
+		if (x < 0.0)
+		{
+			C = -C;
+			S = -S;
+		}
+	}
+
+	void FresnelBatch(const double* x, size_t n, double* C, double* S)
+	{
+		for (size_t i = 0; i < n; i++)
+		{
+			Fresnel(x[i], C[i], S[i]);
+		}
+	}
+}
@@ -0,0 +1,18 @@
+//
+// Fresnel.h - Fresnel integrals for clothoid (transition curve) evaluation
+//
+
+#pragma once
+
+#include <cstddef>
+
+namespace Track
+{
+	// C(x) = integral 0..x of cos(pi t^2 / 2) dt, S(x) = integral 0..x of sin(pi t^2 / 2) dt.
+	// Power series for |x| <= 1.5, continued fraction (modified Lentz) above;
+	// accurate to about 1e-15.
+	void Fresnel(double x, double& C, double& S);
+
+	// Same as Fresnel for n arguments (all the sleeper stations of one segment).
+	void FresnelBatch(const double* x, size_t n, double* C, double* S);
+}
@@ -0,0 +1,98 @@
+//
+// NumberParser.h - Locale-free decimal numbers for the text formats the
+// program reads (OBJ / MTL, BVE maps)
+//
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+namespace Track
+{
+	inline bool IsDecimalDigit(char c)
+	{
+		return unsigned(c - '0') < 10u;
+	}
+
+	// Unsigned decimal with optional fraction and exponent ("12", "1.5",
+	// ".5", "3e-2"); a sign is left to the caller. The first 19 significant
+	// digits are gathered into an integer and scaled once, which is exact to
+	// well within a float; strtod would need the text to be terminated and
+	// depends on the locale. On success p is moved past the number.
+	inline bool ParseDecimal(const char*& p, const char* end, double& value)
+	{
+		static const double POWERS[] = {
+			1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+			1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+		const char* s = p;
+		uint64_t mantissa = 0;
+		int digits = 0;
+		int exponent = 0;
+		bool any = false;
+		for (; s < end && IsDecimalDigit(*s); s++, any = true)
+		{
+			if (digits < 19)
+			{
+				mantissa = mantissa * 10 + (*s - '0');
+				digits += mantissa != 0;
+			}
+			else
+			{
+				exponent++;
+			}
+		}
+		if (s < end && *s == '.')
+		{
+			for (s++; s < end && IsDecimalDigit(*s); s++, any = true)
+			{
+				if (digits < 19)
+				{
+					mantissa = mantissa * 10 + (*s - '0');
+					digits += mantissa != 0;
+					exponent--;
+				}
+			}
+		}
+		if (!any)
+		{
+			return false;
+		}
+		if (s < end && (*s == 'e' || *s == 'E'))
+		{
+			const char* e = s + 1;
+			bool negative = false;
+			if (e < end && (*e == '-' || *e == '+'))
+			{
+				negative = *e++ == '-';
+			}
+			if (e < end && IsDecimalDigit(*e))
+			{
+				int power = 0;
+				for (; e < end && IsDecimalDigit(*e); e++)
+				{
+					power = std::min(power * 10 + (*e - '0'), 1000);
+				}
+				exponent += negative ? -power : power;
+				s = e;
+			}
+		}
+
+		value = double(mantissa);
+		if (mantissa != 0 && exponent != 0)
+		{
+			if (exponent >= -22 && exponent <= 22)
+			{
+				value = exponent < 0 ? value / POWERS[-exponent] : value * POWERS[exponent];
+			}
+			else
+			{
+				value *= std::pow(10.0, exponent);
+			}
+		}
+		p = s;
+		return true;
+	}
+}
@@ -0,0 +1,184 @@
+//
+// Parallel.cpp
+//
+
+#include "Parallel.h"
+
+#include <algorithm>
+
+namespace Track
+{
+	namespace
+	{
+		// Set on pool workers and on a caller while it runs a job
+		thread_local bool t_insideJob = false;
+	}
+
+	ThreadPool::ThreadPool(size_t threads)
+	{
+		if (threads == 0)
+		{
+			threads = std::max(1u, std::thread::hardware_concurrency());
+		}
+		m_workers.reserve(threads - 1);
+		for (size_t n = 1; n < threads; n++)
+		{
+			m_workers.emplace_back(&ThreadPool::Work, this);
+		}
+	}
+
+	ThreadPool::~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stop = true;
+		}
+		m_wake.notify_all();
+		for (auto& worker : m_workers)
+		{
+			worker.join();
+		}
+	}
+
+	ThreadPool& ThreadPool::Shared()
+	{
+		static ThreadPool pool;
+		return pool;
+	}
+
+	void ThreadPool::ParallelFor(size_t count, const std::function<void(size_t)>& fn)
+	{
+		if (m_workers.empty() || count <= 1 || t_insideJob)
+		{
+			for (size_t i = 0; i < count; i++)
+			{
+				fn(i);
+			}
+			return;
+		}
+
+		std::lock_guard<std::mutex> job(m_jobMutex);
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_job = &fn;
+			m_count = count;
+			m_next = 0;
+			m_busy = m_workers.size();
+			m_generation++;
+		}
+		m_wake.notify_all();
+
+		t_insideJob = true;
+		RunItems();
+		t_insideJob = false;
+
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_done.wait(lock, [this]() { return m_busy == 0; });
+		m_job = nullptr;
+	}
+
+	void ThreadPool::RunItems()
+	{
+		for (size_t i = m_next++; i < m_count; i = m_next++)
+		{
+			(*m_job)(i);
+		}
+	}
+
+	void ThreadPool::Work()
+	{
+		t_insideJob = true;
+		uint64_t seen = 0;
+		for (;;)
+		{
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_wake.wait(lock, [&]() { return m_stop || m_generation != seen; });
+				if (m_stop)
+				{
+					return;
+				}
+				seen = m_generation;
+			}
+
+			RunItems();
+
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (--m_busy == 0)
+			{
+				m_done.notify_one();
+			}
+		}
+	}
+
+	WorkQueue::WorkQueue(size_t threads)
+	{
+		threads = std::max<size_t>(threads, 1);
+		m_workers.reserve(threads);
+		for (size_t n = 0; n < threads; n++)
+		{
+			m_workers.emplace_back(&WorkQueue::Work, this);
+		}
+	}
+
+	WorkQueue::~WorkQueue()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_jobs.clear();
+			m_stop = true;
+		}
+		m_wake.notify_all();
+		for (auto& worker : m_workers)
+		{
+			worker.join();
+		}
+	}
+
+	void WorkQueue::Push(std::function<void()> job)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_jobs.push_back(std::move(job));
+		}
+		m_wake.notify_one();
+	}
+
+	void WorkQueue::Cancel()
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_jobs.clear();
+		m_idle.wait(lock, [this]() { return m_running == 0; });
+	}
+
+	size_t WorkQueue::Pending() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_jobs.size() + m_running;
+	}
+
+	void WorkQueue::Work()
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		for (;;)
+		{
+			m_wake.wait(lock, [this]() { return m_stop || !m_jobs.empty(); });
+			if (m_stop)
+			{
+				return;
+			}
+			auto job = std::move(m_jobs.front());
+			m_jobs.pop_front();
+			m_running++;
+
+			lock.unlock();
+			job();
+			lock.lock();
+
+			if (--m_running == 0)
+			{
+				m_idle.notify_all();
+			}
+		}
+	}
+}
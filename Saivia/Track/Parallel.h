@@ -0,0 +1,105 @@
+//
+// Parallel.h - Thread pool and parallel-for over independent work items
+//
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Track
+{
+	// Persistent worker threads, so a generation pass does not pay for
+	// creating threads. The calling thread works along with the pool.
+	class ThreadPool
+	{
+	public:
+		// threads = total threads working on a job including the caller;
+		// 0 uses one per core.
+		explicit ThreadPool(size_t threads = 0);
+		~ThreadPool();
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+
+		// Runs fn(i) for every i in [0, count) and returns when all are done.
+		// Items are handed out one at a time, so uneven items still balance.
+		// fn must be safe to call concurrently for different i. A call made
+		// from inside a job runs serially on the calling thread.
+		void ParallelFor(size_t count, const std::function<void(size_t)>& fn);
+
+		size_t Size() const { return m_workers.size() + 1; }
+
+		// Pool shared by the track library (one thread per core).
+		static ThreadPool& Shared();
+
+	private:
+		void Work();
+		void RunItems();
+
+		std::vector<std::thread> m_workers;
+		std::mutex m_jobMutex;              // one job at a time
+
+		std::mutex m_mutex;
+		std::condition_variable m_wake;
+		std::condition_variable m_done;
+		const std::function<void(size_t)>* m_job = nullptr;
+		size_t m_count = 0;
+		std::atomic<size_t> m_next{ 0 };
+		size_t m_busy = 0;                  // workers still on the current job
+		uint64_t m_generation = 0;
+		bool m_stop = false;
+	};
+
+	// Background threads for work nobody waits for (loading files while
+	// frames go on). Jobs start in the order they were pushed; with more
+	// than one thread they may finish in any order.
+	class WorkQueue
+	{
+	public:
+		explicit WorkQueue(size_t threads = 1);
+		~WorkQueue();                       // cancels and joins
+
+		WorkQueue(const WorkQueue&) = delete;
+		WorkQueue& operator=(const WorkQueue&) = delete;
+
+		void Push(std::function<void()> job);
+
+		// Drops the jobs that have not started and waits for the running ones.
+		void Cancel();
+
+		// Jobs queued or running
+		size_t Pending() const;
+
+	private:
+		void Work();
+
+		std::vector<std::thread> m_workers;
+		mutable std::mutex m_mutex;
+		std::condition_variable m_wake;
+		std::condition_variable m_idle;
+		std::deque<std::function<void()>> m_jobs;
+		size_t m_running = 0;
+		bool m_stop = false;
+	};
+
+	template <typename Fn>
+	void ParallelFor(size_t count, Fn&& fn)
+	{
+		if (count <= 1)
+		{
+			for (size_t i = 0; i < count; i++)
+			{
+				fn(i);
+			}
+			return;
+		}
+		ThreadPool::Shared().ParallelFor(count, std::function<void(size_t)>(std::forward<Fn>(fn)));
+	}
+}
@@ -0,0 +1,130 @@
+//
+// Railway.cpp
+//
+
+#include "Railway.h"
+
+#include <fstream>
+#include <stdexcept>
+
+#include "../JSON/json.hpp"
+
+namespace Track
+{
+	namespace
+	{
+		Command ParseCommand(const nlohmann::json& data, std::string& error)
+		{
+			Command command;
+			auto& parameter = data.at("Parameter");
+
+			if (data.at("Command") == "Straight")
+			{
+				command.type = CommandType::Straight;
+				command.length = parameter.at(0);
+			}
+			else if (data.at("Command") == "Curve")
+			{
+				command.type = CommandType::Curve;
+				std::string turn = parameter.at(0);
+				command.turn = (turn == "Right") ? Turn::Right : Turn::Left;
+				command.radius = parameter.at(1);
+				command.length = parameter.at(2);
+				command.cant = parameter.at(3);
+				command.scale = static_cast<double>(parameter.at(4)) / 100.0;
+			}
+			else if (data.at("Command") == "TransitionCurve")
+			{
+				command.type = CommandType::TransitionCurve;
+				std::string turn = parameter.at(0);
+				command.turn = (turn == "Right") ? Turn::Right : Turn::Left;
+				command.radius = parameter.at(1);
+				command.length = parameter.at(2);
+				command.cant = parameter.at(3);
+			}
+			else if (data.at("Command") == "Gradient")
+			{
+				command.type = CommandType::Gradient;
+				command.gradient = parameter.at(0);
+				command.length = parameter.at(1);
+			}
+			else
+			{
+				error = "invalid command " + data.at("Command").dump();
+			}
+			return command;
+		}
+	}
+
+	World LoadWorld(std::istream& jsonData)
+	{
+		nlohmann::json json;
+		jsonData >> json;
+
+		World world;
+		for (auto& railwayJson : json["Railway"])
+		{
+			Railway railway;
+			railway.name = railwayJson.value("Name", std::string());
+			railway.route = railwayJson.value("Route", std::string());
+
+			if (railwayJson.contains("Branch"))
+			{
+				try
+				{
+					auto& branch = railwayJson["Branch"];
+					std::string turn = branch.at("Turn");
+					railway.branch.from = branch.at("From");
+					railway.branch.at = branch.at("At");
+					railway.branch.turn = (turn == "Right") ? Turn::Right : Turn::Left;
+					railway.branch.radius = branch.at("Radius");
+					railway.branch.frogNumber = branch.at("Frog");
+					railway.hasBranch = true;
+				}
+				catch (const nlohmann::json::exception& e)
+				{
+					world.errors.push_back(railway.name + ": Branch " + e.what());
+				}
+			}
+
+			// A railway with a Route gets its Data from the map
+			static const nlohmann::json NO_DATA = nlohmann::json::array();
+			const nlohmann::json& dataJson = (railway.route.empty() || railwayJson.contains("Data")) ? railwayJson.at("Data") : NO_DATA;
+			for (auto& data : dataJson)
+			{
+				std::string error;
+				Command command;
+				try
+				{
+					command = ParseCommand(data, error);
+				}
+				catch (const nlohmann::json::exception& e)
+				{
+					error = data.dump() + ": " + e.what();
+				}
+
+				if (error.empty())
+				{
+					railway.data.push_back(command);
+				}
+				else
+				{
+					world.errors.push_back(railway.name + ": " + error);
+				}
+			}
+
+			world.railways.push_back(std::move(railway));
+		}
+		return world;
+	}
+
+	World LoadWorldFile(const std::string& path)
+	{
+		std::ifstream jsonData(path);
+		if (!jsonData)
+		{
+			throw std::runtime_error("Cannot open " + path);
+		}
+		return LoadWorld(jsonData);
+	}
+}
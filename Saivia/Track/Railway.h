@@ -0,0 +1,101 @@
+//
+// Railway.h - Railway command list as described by World.json
+//
+
+#pragma once
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+namespace Track
+{
+	enum class CommandType
+	{
+		Straight,
+		Curve,
+		TransitionCurve,
+		Gradient,
+	};
+
+	enum class Turn
+	{
+		Left,
+		Right,
+	};
+
+	// One entry of Railway[].Data
+	//   Straight        [length]
+	//   Curve           [turn, radius, length, cant, scale]
+	//   TransitionCurve [turn, radius, length, cant]
+	//       clothoid from the curvature / cant where the previous command ended
+	//       to those of the given radius / cant; radius 0 eases back to straight.
+	//   Gradient        [gradient (per mille), length]
+	//       vertical curve from the current gradient to the given one over
+	//       length (0 = sharp change); takes no horizontal distance.
+	struct Command
+	{
+		CommandType type = CommandType::Straight;
+		double length = 0.0;    // units (m)
+		Turn turn = Turn::Left;
+		double radius = 0.0;
+		double cant = 0.0;
+		double scale = 1.0;     // Parameter[4] / 100
+		double gradient = 0.0;  // per mille
+	};
+
+	// Optional "Branch" of a railway: it leaves railway `from` through a turnout
+	// at chainage `at`. The diverging lead curve (radius, up to the frog angle
+	// atan(1 / frogNumber)) is generated before the railway's own Data.
+	//   "Branch": { "From": "Main_Railway", "At": 12, "Turn": "Left", "Radius": 190, "Frog": 10 }
+	struct Branch
+	{
+		std::string from;
+		double at = 0.0;
+		Turn turn = Turn::Left;
+		double radius = 0.0;
+		double frogNumber = 0.0;
+	};
+
+	// Optional "Route" of a railway: a BveTs map file (relative to World.json)
+	// whose Curve / Gradient statements replace Data, filled in by
+	// Bve::LoadRoutes.
+	//   { "Name": "Chiba_Line", "Route": "Map.txt" }
+	struct Railway
+	{
+		std::string name;
+		std::vector<Command> data;
+		std::string route;
+
+		bool hasBranch = false;
+		Branch branch;
+	};
+
+	struct World
+	{
+		std::vector<Railway> railways;
+
+		// Commands that could not be understood; they are skipped, not fatal.
+		std::vector<std::string> errors;
+	};
+
+	// Used to find the first edited command when World.json is reloaded.
+	inline bool operator==(const Command& a, const Command& b)
+	{
+		return a.type == b.type && a.length == b.length && a.turn == b.turn && a.radius == b.radius &&
+			a.cant == b.cant && a.scale == b.scale && a.gradient == b.gradient;
+	}
+	inline bool operator!=(const Command& a, const Command& b) { return !(a == b); }
+
+	inline bool operator==(const Branch& a, const Branch& b)
+	{
+		return a.from == b.from && a.at == b.at && a.turn == b.turn && a.radius == b.radius &&
+			a.frogNumber == b.frogNumber;
+	}
+	inline bool operator!=(const Branch& a, const Branch& b) { return !(a == b); }
+
+	// Reads the "Railway" array of a World.json document.
+	// Throws std::exception (nlohmann::json::exception) on malformed JSON.
+	World LoadWorld(std::istream& jsonData);
+	World LoadWorldFile(const std::string& path);
+}
@@ -0,0 +1,191 @@
+//
+// TrackGenerator.cpp
+//
+
+#include "TrackGenerator.h"
+
+#include <algorithm>
+
+namespace Track
+{
+	namespace
+	{
+		// Index range [first, last] of the sleepers k * spacing inside (from, to]
+		void SampleRange(double from, double to, double spacing, long long& first, long long& last)
+		{
+			const double eps = 1e-9;
+			first = static_cast<long long>(std::floor(from / spacing + eps)) + 1;
+			last = static_cast<long long>(std::floor(to / spacing + eps));
+		}
+
+		void SampleRange(const Segment& segment, double spacing, long long& first, long long& last)
+		{
+			SampleRange(segment.s0, segment.s0 + segment.length, spacing, first, last);
+		}
+
+		// Transition curve: positions of all stations go through one Fresnel batch,
+		// heading and bank are polynomials in ds.
+		void SampleTransition(const Segment& segment, VerticalProfile::Cursor& profile,
+			long long first, long long last, double spacing, Frame* out)
+		{
+			size_t count = static_cast<size_t>(last - first + 1);
+			std::vector<double> ds(count);
+			std::vector<Vec3> positions(count);
+			for (size_t i = 0; i < count; i++)
+			{
+				ds[i] = (first + static_cast<long long>(i)) * spacing - segment.s0;
+			}
+			Alignment::EvaluatePositions(segment, ds.data(), count, positions.data());
+
+			double a = (segment.endCurvature - segment.curvature) / segment.length;
+			double bankRate = (segment.endBank - segment.bank) / segment.length;
+			for (size_t i = 0; i < count; i++)
+			{
+				Pose pose;
+				pose.Pos = positions[i];
+				profile.Evaluate(segment.s0 + ds[i], pose.Pos.y, pose.grade);
+				pose.heading = segment.heading + (segment.curvature + 0.5 * a * ds[i]) * ds[i];
+				pose.bank = segment.bank + bankRate * ds[i];
+				out[i] = MakeFrame(pose);
+			}
+		}
+	}
+
+	size_t CountSamples(const Segment& segment, double spacing)
+	{
+		long long first, last;
+		SampleRange(segment, spacing, first, last);
+		return last >= first ? static_cast<size_t>(last - first + 1) : 0;
+	}
+
+	void SampleSegment(const Segment& segment, const VerticalProfile& profile, std::vector<Frame>& frames, double spacing)
+	{
+		long long first, last;
+		SampleRange(segment, spacing, first, last);
+		if (last < first)
+		{
+			return;
+		}
+
+		size_t base = frames.size();
+		frames.resize(base + static_cast<size_t>(last - first + 1));
+		SampleSegment(segment, profile, first, last, spacing, frames.data() + base);
+	}
+
+	void SampleSegment(const Segment& segment, const VerticalProfile& profile,
+		long long first, long long last, double spacing, Frame* out)
+	{
+		VerticalProfile::Cursor cursor(profile);
+		if (segment.IsTransition())
+		{
+			SampleTransition(segment, cursor, first, last, spacing, out);
+			return;
+		}
+
+		const double k = segment.curvature;
+		const double sh0 = std::sin(segment.heading);
+		const double ch0 = std::cos(segment.heading);
+		double sb = std::sin(segment.bank);
+		double cb = std::cos(segment.bank);
+
+		// An arc can still ramp its cant (a transition of the bank alone);
+		// Alignment::Evaluate interpolates it the same way
+		const bool ramp = segment.endBank != segment.bank;
+		const double bankRate = (segment.endBank - segment.bank) / segment.length;
+
+		// Same closed form as Alignment::Evaluate, with one sin/cos per sleeper:
+		// half = k ds / 2 gives both the chord direction (h0 + half) and the
+		// tangent (h0 + 2 half) through angle addition.
+		for (long long i = first; i <= last; i++)
+		{
+			double ds = i * spacing - segment.s0;
+			double half = 0.5 * k * ds;
+			double s = std::sin(half);
+			double c = std::cos(half);
+			double chord = (std::abs(half) < 1e-12) ? ds : s / (0.5 * k);
+
+			double smean = sh0 * c + ch0 * s;
+			double cmean = ch0 * c - sh0 * s;
+			double s2 = 2.0 * s * c;
+			double c2 = c * c - s * s;
+			double sh = sh0 * c2 + ch0 * s2;
+			double ch = ch0 * c2 - sh0 * s2;
+
+			Vec3 pos = segment.start + Vec3(smean * chord, 0.0, cmean * chord);
+			double grade;
+			cursor.Evaluate(i * spacing, pos.y, grade);
+			if (ramp)
+			{
+				double bank = segment.bank + bankRate * ds;
+				sb = std::sin(bank);
+				cb = std::cos(bank);
+			}
+
+			*out++ = MakeFrame(pos, sh, ch, grade, sb, cb);
+		}
+	}
+
+	void SampleIndices(const Alignment& alignment, double from, double to, double spacing, long long& first, long long& last)
+	{
+		SampleRange(std::max(from, 0.0), std::min(to, alignment.Length()), spacing, first, last);
+	}
+
+	size_t CountSamples(const Alignment& alignment, double from, double to, double spacing)
+	{
+		long long first, last;
+		SampleIndices(alignment, from, to, spacing, first, last);
+		return last >= first ? static_cast<size_t>(last - first + 1) : 0;
+	}
+
+	void SampleFrames(const Alignment& alignment, long long first, long long last, double spacing, Frame* out)
+	{
+		auto& segments = alignment.Segments();
+		if (segments.empty() || last < first)
+		{
+			return;
+		}
+
+		// A sleeper on a segment boundary belongs to the segment ending there
+		for (size_t n = alignment.FindSegment((first - 1) * spacing); n < segments.size() && first <= last; n++)
+		{
+			long long segmentFirst, segmentLast;
+			SampleRange(segments[n], spacing, segmentFirst, segmentLast);
+			segmentFirst = std::max(segmentFirst, first);
+			segmentLast = std::min(segmentLast, last);
+			if (segmentLast < segmentFirst)
+			{
+				continue;
+			}
+
+			SampleSegment(segments[n], alignment.Profile(), segmentFirst, segmentLast, spacing, out);
+			out += segmentLast - segmentFirst + 1;
+			first = segmentLast + 1;
+		}
+	}
+
+	void SampleFrames(const Alignment& alignment, double from, double to, std::vector<Frame>& frames, double spacing)
+	{
+		long long first, last;
+		SampleIndices(alignment, from, to, spacing, first, last);
+		if (last < first)
+		{
+			return;
+		}
+
+		size_t base = frames.size();
+		frames.resize(base + static_cast<size_t>(last - first + 1));
+		SampleFrames(alignment, first, last, spacing, frames.data() + base);
+	}
+
+	void SampleFrames(const Alignment& alignment, std::vector<Frame>& frames, double spacing)
+	{
+		SampleFrames(alignment, 0.0, alignment.Length(), frames, spacing);
+	}
+
+	void GenerateRailway(const Railway& railway, std::vector<Frame>& frames)
+	{
+		Alignment alignment;
+		alignment.Build(railway);
+		SampleFrames(alignment, frames);
+	}
+}
@@ -0,0 +1,43 @@
+//
+// TrackGenerator.h - Turns a railway command list into sleeper frames
+//
+
+#pragma once
+
+#include <vector>
+
+#include "Alignment.h"
+
+namespace Track
+{
+	// Sleepers sit at every multiple of spacing along the chainage, so a
+	// segment's samples only depend on its own start pose and chainage.
+	const double SLEEPER_SPACING = 1.0;
+
+	// Number of sleepers whose chainage lies in (s0, s0 + length].
+	size_t CountSamples(const Segment& segment, double spacing = SLEEPER_SPACING);
+
+	// Appends the sleeper frames of one segment. Every frame is evaluated
+	// independently from the segment start (no accumulated state); elevation
+	// and pitch come from the vertical profile at the sleeper's chainage.
+	void SampleSegment(const Segment& segment, const VerticalProfile& profile, std::vector<Frame>& frames,
+		double spacing = SLEEPER_SPACING);
+	// Writes the sleepers first..last (chainage index * spacing) of a segment to out.
+	void SampleSegment(const Segment& segment, const VerticalProfile& profile,
+		long long first, long long last, double spacing, Frame* out);
+
+	// Sleepers of a whole alignment, or only those with chainage in (from, to].
+	void SampleFrames(const Alignment& alignment, std::vector<Frame>& frames, double spacing = SLEEPER_SPACING);
+	void SampleFrames(const Alignment& alignment, double from, double to, std::vector<Frame>& frames,
+		double spacing = SLEEPER_SPACING);
+	size_t CountSamples(const Alignment& alignment, double from, double to, double spacing = SLEEPER_SPACING);
+
+	// Index range [first, last] of the sleepers (chainage index * spacing) in
+	// (from, to] of an alignment, and the frames of such a range written to
+	// out. Lets callers split a long range into blocks for parallel sampling.
+	void SampleIndices(const Alignment& alignment, double from, double to, double spacing, long long& first, long long& last);
+	void SampleFrames(const Alignment& alignment, long long first, long long last, double spacing, Frame* out);
+
+	// Appends one frame per unit of every command to frames.
+	void GenerateRailway(const Railway& railway, std::vector<Frame>& frames);
+}
@@ -0,0 +1,332 @@
+//
+// TrackGraph.cpp
+//
+
+#include "TrackGraph.h"
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+
+#include "Parallel.h"
+#include "TrackGenerator.h"
+
+namespace Track
+{
+	namespace
+	{
+		// Sleepers per parallel work item
+		const long long SAMPLE_BLOCK = 4096;
+	}
+
+	void TrackGraph::Build(const World& world, std::vector<std::string>& errors)
+	{
+		m_railways = world.railways;
+		size_t count = m_railways.size();
+
+		std::unordered_map<std::string, uint32_t> byName;
+		for (uint32_t r = 0; r < count; r++)
+		{
+			byName.emplace(m_railways[r].name, r);
+		}
+
+		m_parent.assign(count, NONE);
+		for (uint32_t r = 0; r < count; r++)
+		{
+			auto& railway = m_railways[r];
+			if (!railway.hasBranch)
+			{
+				continue;
+			}
+
+			auto it = byName.find(railway.branch.from);
+			if (it == byName.end() || it->second == r)
+			{
+				errors.push_back(railway.name + ": Branch from unknown railway \"" + railway.branch.from + "\"");
+				railway.hasBranch = false;
+				continue;
+			}
+			m_parent[r] = it->second;
+		}
+
+		// Parents before branches; a cycle is cut where it is found
+		enum : uint8_t { Unvisited, Visiting, Done };
+		std::vector<uint8_t> state(count, Unvisited);
+		m_order.clear();
+		m_order.reserve(count);
+		for (uint32_t r = 0; r < count; r++)
+		{
+			// Walk up to the first visited ancestor, then emit the chain top-down
+			std::vector<uint32_t> chain;
+			for (uint32_t n = r; n != NONE && state[n] == Unvisited; n = m_parent[n])
+			{
+				state[n] = Visiting;
+				chain.push_back(n);
+
+				uint32_t parent = m_parent[n];
+				if (parent != NONE && state[parent] == Visiting)
+				{
+					errors.push_back(m_railways[n].name + ": Branch from \"" + m_railways[parent].name + "\" forms a loop");
+					m_railways[n].hasBranch = false;
+					m_parent[n] = NONE;
+				}
+			}
+			for (auto it = chain.rbegin(); it != chain.rend(); ++it)
+			{
+				state[*it] = Done;
+				m_order.push_back(*it);
+			}
+		}
+	}
+
+	void TrackGraph::Generate()
+	{
+		m_alignments.assign(m_railways.size(), Alignment());
+		for (auto r : m_order)
+		{
+			m_alignments[r].Build(m_railways[r], BranchStart(r));
+		}
+
+		BuildEdges();
+
+		m_frames.assign(m_edges.size(), std::vector<Frame>());
+		Resample(std::vector<double>(m_railways.size(), -INFINITY));
+	}
+
+	Pose TrackGraph::BranchStart(uint32_t railway) const
+	{
+		Pose start;
+		if (m_parent[railway] != NONE)
+		{
+			// The branch leaves from the switch frame of its parent
+			start = m_alignments[m_parent[railway]].At(m_railways[railway].branch.at);
+			start.curvature = 0.0;
+			start.bank = 0.0;
+		}
+		return start;
+	}
+
+	void TrackGraph::Update(const World& world, std::vector<std::string>& errors)
+	{
+		bool sameLayout = world.railways.size() == m_railways.size() && m_alignments.size() == m_railways.size();
+		for (size_t r = 0; sameLayout && r < m_railways.size(); r++)
+		{
+			auto& before = m_railways[r];
+			auto& after = world.railways[r];
+			sameLayout = before.name == after.name && before.hasBranch == after.hasBranch &&
+				(!after.hasBranch || before.branch == after.branch);
+		}
+		if (!sameLayout)
+		{
+			Build(world, errors);
+			Generate();
+			return;
+		}
+
+		// Chainage from which each railway changed, +inf if it did not
+		std::vector<double> changedFrom(m_railways.size(), INFINITY);
+		for (auto r : m_order)
+		{
+			auto& before = m_railways[r].data;
+			auto& after = world.railways[r].data;
+
+			size_t first = 0;
+			size_t common = std::min(before.size(), after.size());
+			while (first < common && before[first] == after[first])
+			{
+				first++;
+			}
+			bool edited = first < before.size() || first < after.size();
+			if (edited)
+			{
+				m_railways[r].data = after;
+			}
+
+			uint32_t parent = m_parent[r];
+			if (parent != NONE && changedFrom[parent] <= m_railways[r].branch.at)
+			{
+				// The switch moved: the whole branch moves with it
+				m_alignments[r].Build(m_railways[r], BranchStart(r));
+				changedFrom[r] = -INFINITY;
+			}
+			else if (edited)
+			{
+				changedFrom[r] = m_alignments[r].Rebuild(m_railways[r], first);
+			}
+		}
+
+		// A turnout clamped to the end of a railway that got shorter / longer
+		// changes the edge layout
+		std::vector<Turnout> turnouts = m_turnouts;
+		std::vector<Edge> edges = m_edges;
+		BuildEdges();
+		bool sameEdges = edges.size() == m_edges.size();
+		for (size_t t = 0; sameEdges && t < turnouts.size(); t++)
+		{
+			sameEdges = turnouts[t].chainage == m_turnouts[t].chainage;
+		}
+		if (!sameEdges)
+		{
+			m_frames.assign(m_edges.size(), std::vector<Frame>());
+			std::fill(changedFrom.begin(), changedFrom.end(), -INFINITY);
+		}
+		Resample(changedFrom);
+	}
+
+	void TrackGraph::Resample(const std::vector<double>& changedFrom)
+	{
+		// Frames up to one spacing before the change are kept: the frame at the
+		// changed chainage itself already belongs to the new segment.
+		m_changes.clear();
+		std::vector<double> resampleFrom;
+		for (uint32_t e = 0; e < m_edges.size(); e++)
+		{
+			auto& edge = m_edges[e];
+			auto& alignment = m_alignments[edge.railway];
+			double from = std::max(changedFrom[edge.railway] - SLEEPER_SPACING, edge.s0);
+			if (from >= edge.s1 && m_frames[e].size() == CountSamples(alignment, edge.s0, edge.s1))
+			{
+				continue;
+			}
+
+			Change change;
+			change.edge = e;
+			change.firstFrame = CountSamples(alignment, edge.s0, from);
+			if (change.firstFrame > m_frames[e].size())
+			{
+				change.firstFrame = 0;
+				from = edge.s0;
+			}
+			m_changes.push_back(change);
+			resampleFrom.push_back(from);
+		}
+
+		// Every edge gets its output region preallocated, then the regions are
+		// filled in blocks so that one long railway still spreads over all
+		// threads and many parallel tracks do not run one after another.
+		struct Block
+		{
+			uint32_t edge;
+			long long first;
+			long long last;
+			size_t offset;
+		};
+		std::vector<Block> blocks;
+		for (size_t c = 0; c < m_changes.size(); c++)
+		{
+			auto& change = m_changes[c];
+			auto& edge = m_edges[change.edge];
+
+			long long first, last;
+			SampleIndices(m_alignments[edge.railway], resampleFrom[c], edge.s1, SLEEPER_SPACING, first, last);
+			size_t count = last >= first ? static_cast<size_t>(last - first + 1) : 0;
+			m_frames[change.edge].resize(change.firstFrame + count);
+
+			for (long long begin = first; begin <= last; begin += SAMPLE_BLOCK)
+			{
+				Block block;
+				block.edge = change.edge;
+				block.first = begin;
+				block.last = std::min(last, begin + SAMPLE_BLOCK - 1);
+				block.offset = change.firstFrame + static_cast<size_t>(begin - first);
+				blocks.push_back(block);
+			}
+		}
+
+		ParallelFor(blocks.size(), [this, &blocks](size_t b)
+		{
+			auto& block = blocks[b];
+			SampleFrames(m_alignments[m_edges[block.edge].railway], block.first, block.last, SLEEPER_SPACING,
+				m_frames[block.edge].data() + block.offset);
+		});
+	}
+
+	void TrackGraph::BuildEdges()
+	{
+		uint32_t count = static_cast<uint32_t>(m_railways.size());
+
+		m_turnouts.clear();
+		std::vector<std::vector<uint32_t>> onRailway(count);
+		for (uint32_t r = 0; r < count; r++)
+		{
+			uint32_t parent = m_parent[r];
+			if (parent == NONE)
+			{
+				continue;
+			}
+
+			Turnout turnout;
+			turnout.railway = parent;
+			turnout.branch = r;
+			turnout.chainage = std::min(std::max(m_railways[r].branch.at, 0.0), m_alignments[parent].Length());
+			onRailway[parent].push_back(static_cast<uint32_t>(m_turnouts.size()));
+			m_turnouts.push_back(turnout);
+		}
+
+		// Cut every railway at its turnouts
+		m_edges.clear();
+		std::vector<uint32_t> firstEdge(count);
+		for (uint32_t r = 0; r < count; r++)
+		{
+			auto& turnouts = onRailway[r];
+			std::stable_sort(turnouts.begin(), turnouts.end(),
+				[this](uint32_t a, uint32_t b) { return m_turnouts[a].chainage < m_turnouts[b].chainage; });
+
+			firstEdge[r] = static_cast<uint32_t>(m_edges.size());
+
+			Edge edge;
+			edge.railway = r;
+			for (auto t : turnouts)
+			{
+				auto& turnout = m_turnouts[t];
+				edge.s1 = turnout.chainage;
+				edge.to = t;
+				turnout.toe = static_cast<uint32_t>(m_edges.size());
+				turnout.through = turnout.toe + 1;
+				m_edges.push_back(edge);
+
+				edge = Edge();
+				edge.railway = r;
+				edge.s0 = turnout.chainage;
+				edge.from = t;
+			}
+			edge.s1 = m_alignments[r].Length();
+			m_edges.push_back(edge);
+		}
+
+		for (uint32_t t = 0; t < m_turnouts.size(); t++)
+		{
+			auto& turnout = m_turnouts[t];
+			turnout.diverging = firstEdge[turnout.branch];
+			m_edges[turnout.diverging].from = t;
+		}
+
+		// Precomputed adjacency: facing moves pick through / diverging, trailing
+		// moves (from either side back over the switch) always reach the toe.
+		for (auto& edge : m_edges)
+		{
+			if (edge.to != NONE)
+			{
+				auto& turnout = m_turnouts[edge.to];
+				edge.next[Forward][0] = turnout.through;
+				edge.next[Forward][1] = turnout.diverging;
+			}
+			if (edge.from != NONE)
+			{
+				auto& turnout = m_turnouts[edge.from];
+				edge.next[Backward][0] = turnout.toe;
+				edge.next[Backward][1] = turnout.toe;
+			}
+		}
+	}
+
+	size_t TrackGraph::FrameCount() const
+	{
+		size_t count = 0;
+		for (auto& frames : m_frames)
+		{
+			count += frames.size();
+		}
+		return count;
+	}
+}
@@ -0,0 +1,114 @@
+//
+// TrackGraph.h - Railways connected by turnouts
+//
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Alignment.h"
+#include "Railway.h"
+
+namespace Track
+{
+	// Every railway of a World.json is cut into edges at the turnouts placed on
+	// it. A railway with a "Branch" starts at the diverging side of a turnout on
+	// its parent railway; railways without one are independent roots.
+	//
+	//            toe           through
+	//   ---------------->*--------------->   parent railway
+	//                     `.
+	//                       `-------->      branch railway (diverging: lead curve + Data)
+	//
+	class TrackGraph
+	{
+	public:
+		static constexpr uint32_t NONE = 0xffffffffu;
+
+		enum Direction : uint32_t
+		{
+			Forward = 0,  // increasing chainage
+			Backward = 1,
+		};
+
+		struct Turnout
+		{
+			uint32_t railway = NONE;   // railway the switch sits on
+			uint32_t branch = NONE;    // railway leaving on the diverging side
+			double chainage = 0.0;
+			uint32_t toe = NONE;       // edges meeting at the turnout
+			uint32_t through = NONE;
+			uint32_t diverging = NONE;
+		};
+
+		struct Edge
+		{
+			uint32_t railway = NONE;
+			double s0 = 0.0;           // chainage range on the railway
+			double s1 = 0.0;
+			uint32_t from = NONE;      // turnout at s0 / s1, NONE for an open end
+			uint32_t to = NONE;
+
+			// next[direction][diverging]: edge reached when leaving this edge in
+			// direction with the switch at that end set straight (0) or diverging (1).
+			uint32_t next[2][2] = { { NONE, NONE }, { NONE, NONE } };
+		};
+
+		// Resolves the branch references of the world; unknown or cyclic parents
+		// are reported in errors and the railway is treated as a root.
+		void Build(const World& world, std::vector<std::string>& errors);
+
+		// Builds every alignment (parents before branches), cuts the edges and
+		// samples the sleeper frames of all edges in parallel on the shared
+		// thread pool, each edge into its own preallocated frame array.
+		void Generate();
+
+		// Frames of an edge that changed in the last Generate / Update: every
+		// frame from firstFrame to the end of the edge was rewritten.
+		struct Change
+		{
+			uint32_t edge;
+			size_t firstFrame;
+		};
+
+		// Applies an edited world. Railways are diffed command by command: an
+		// edit at command k only rebuilds that railway's segments from k on and
+		// resamples the sleepers after the edit (plus branches leaving beyond
+		// it). Added / removed / renamed railways or changed branches fall back
+		// to Build + Generate.
+		void Update(const World& world, std::vector<std::string>& errors);
+
+		const std::vector<Change>& Changes() const { return m_changes; }
+
+		// O(1) edge-to-edge step for simulation.
+		uint32_t Next(uint32_t edge, Direction direction, bool diverging) const
+		{
+			return m_edges[edge].next[direction][diverging ? 1 : 0];
+		}
+
+		const std::vector<Railway>& Railways() const { return m_railways; }
+		const std::vector<Alignment>& Alignments() const { return m_alignments; }
+		const std::vector<Turnout>& Turnouts() const { return m_turnouts; }
+		const std::vector<Edge>& Edges() const { return m_edges; }
+		const std::vector<Frame>& EdgeFrames(uint32_t edge) const { return m_frames[edge]; }
+
+		size_t FrameCount() const;
+
+	private:
+		Pose BranchStart(uint32_t railway) const;
+		void BuildEdges();
+		void Resample(const std::vector<double>& changedFrom);
+
+		std::vector<Railway> m_railways;
+		std::vector<uint32_t> m_parent;    // parent railway per railway, NONE for roots
+		std::vector<uint32_t> m_order;     // railways, every parent before its branches
+
+		std::vector<Alignment> m_alignments;
+		std::vector<Turnout> m_turnouts;
+		std::vector<Edge> m_edges;
+		std::vector<std::vector<Frame>> m_frames;
+		std::vector<Change> m_changes;
+	};
+}
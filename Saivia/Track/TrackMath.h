@@ -0,0 +1,68 @@
+//
+// TrackMath.h - Minimal vector math for the portable track-geometry library
+//
+
+#pragma once
+
+#include <cmath>
+
+namespace Track
+{
+	struct Vec3
+	{
+		double x = 0.0;
+		double y = 0.0;
+		double z = 0.0;
+
+		Vec3() = default;
+		constexpr Vec3(double ix, double iy, double iz) : x(ix), y(iy), z(iz) {}
+
+		Vec3& operator+=(const Vec3& v) { x += v.x; y += v.y; z += v.z; return *this; }
+		Vec3& operator-=(const Vec3& v) { x -= v.x; y -= v.y; z -= v.z; return *this; }
+		Vec3& operator*=(double s) { x *= s; y *= s; z *= s; return *this; }
+
+		double Dot(const Vec3& v) const { return x * v.x + y * v.y + z * v.z; }
+
+		// Same convention as SimpleMath::Vector3::Cross (this x v)
+		Vec3 Cross(const Vec3& v) const
+		{
+			return { y * v.z - z * v.y, z * v.x - x * v.z, x * v.y - y * v.x };
+		}
+
+		double Length() const { return std::sqrt(Dot(*this)); }
+
+		void Normalize()
+		{
+			double len = Length();
+			if (len > 0.0)
+			{
+				*this *= 1.0 / len;
+			}
+		}
+	};
+
+	inline Vec3 operator+(Vec3 a, const Vec3& b) { return a += b; }
+	inline Vec3 operator-(Vec3 a, const Vec3& b) { return a -= b; }
+	inline Vec3 operator-(const Vec3& v) { return { -v.x, -v.y, -v.z }; }
+	inline Vec3 operator*(Vec3 v, double s) { return v *= s; }
+	inline Vec3 operator*(double s, Vec3 v) { return v *= s; }
+
+	// Rotates v around a unit axis (right-handed, same as Matrix::CreateFromAxisAngle)
+	inline Vec3 RotateAxisAngle(const Vec3& v, const Vec3& axis, double angle)
+	{
+		double c = std::cos(angle);
+		double s = std::sin(angle);
+		return v * c + axis.Cross(v) * s + axis * (axis.Dot(v) * (1.0 - c));
+	}
+
+	// One placed object. B N T are the rows of the world matrix, Pos is the translation.
+	//   B N T
+	//   Pos
+	struct Frame
+	{
+		Vec3 B;
+		Vec3 N;
+		Vec3 T;
+		Vec3 Pos;
+	};
+}
@@ -0,0 +1,93 @@
+//
+// VerticalProfile.cpp
+//
+
+#include "VerticalProfile.h"
+
+#include <algorithm>
+
+namespace Track
+{
+	void VerticalProfile::Reset(double elevation, double grade)
+	{
+		Piece piece;
+		piece.elevation = elevation;
+		piece.grade = grade;
+
+		m_pieces.clear();
+		m_pieces.push_back(piece);
+	}
+
+	void VerticalProfile::AddGradeChange(double s, double grade, double transitionLength)
+	{
+		auto& last = m_pieces.back();
+		s = std::max(s, last.s0);
+
+		Piece start;
+		start.s0 = s;
+		EvaluatePiece(last, s, start.elevation, start.grade);
+
+		// A change at the same chainage as the last one replaces it
+		if (s == last.s0)
+		{
+			m_pieces.pop_back();
+		}
+
+		if (transitionLength > 0.0)
+		{
+			start.gradeRate = (grade - start.grade) / transitionLength;
+			m_pieces.push_back(start);
+
+			Piece end;
+			end.s0 = s + transitionLength;
+			EvaluatePiece(start, end.s0, end.elevation, end.grade);
+			end.grade = grade;
+			m_pieces.push_back(end);
+		}
+		else
+		{
+			start.grade = grade;
+			m_pieces.push_back(start);
+		}
+	}
+
+	size_t VerticalProfile::Find(double s) const
+	{
+		auto it = std::upper_bound(m_pieces.begin(), m_pieces.end(), s,
+			[](double value, const Piece& piece) { return value < piece.s0; });
+		return it == m_pieces.begin() ? 0 : static_cast<size_t>(it - m_pieces.begin()) - 1;
+	}
+
+	void VerticalProfile::EvaluatePiece(const Piece& piece, double s, double& elevation, double& grade)
+	{
+		double ds = s - piece.s0;
+		grade = piece.grade + piece.gradeRate * ds;
+		elevation = piece.elevation + (piece.grade + 0.5 * piece.gradeRate * ds) * ds;
+	}
+
+	void VerticalProfile::Evaluate(double s, double& elevation, double& grade) const
+	{
+		EvaluatePiece(m_pieces[Find(s)], s, elevation, grade);
+	}
+
+	double VerticalProfile::Elevation(double s) const
+	{
+		double elevation, grade;
+		Evaluate(s, elevation, grade);
+		return elevation;
+	}
+
+	void VerticalProfile::Cursor::Evaluate(double s, double& elevation, double& grade)
+	{
+		auto& pieces = m_profile->m_pieces;
+		if (m_index >= pieces.size() || s < pieces[m_index].s0)
+		{
+			m_index = m_profile->Find(s);
+		}
+		while (m_index + 1 < pieces.size() && pieces[m_index + 1].s0 <= s)
+		{
+			m_index++;
+		}
+		EvaluatePiece(pieces[m_index], s, elevation, grade);
+	}
+}
@@ -0,0 +1,68 @@
+//
+// VerticalProfile.h - Gradients and parabolic vertical curves along the chainage
+//
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace Track
+{
+	// Elevation as a piecewise quadratic of the (horizontal) chainage. Each piece
+	// has a constant rate of grade change: 0 on a constant gradient, non-zero on
+	// a vertical curve, where the grade changes linearly (a parabola).
+	class VerticalProfile
+	{
+	public:
+		struct Piece
+		{
+			double s0 = 0.0;
+			double elevation = 0.0; // at s0
+			double grade = 0.0;     // dy/ds at s0
+			double gradeRate = 0.0; // d(grade)/ds
+		};
+
+		VerticalProfile() { Clear(); }
+
+		void Clear() { Reset(0.0, 0.0); }
+
+		// Starts the profile at chainage 0 with the given elevation and grade
+		// (a branch continues the profile of the railway it leaves).
+		void Reset(double elevation, double grade);
+
+		// Changes the grade to `grade` (rise over run, 10 per mille = 0.01) starting
+		// at chainage s, linearly over transitionLength (0 = sharp change).
+		// Changes must be added in chainage order; one that starts before the
+		// previous vertical curve has finished is moved to its end.
+		void AddGradeChange(double s, double grade, double transitionLength);
+
+		// Index of the piece containing s, by binary search.
+		size_t Find(double s) const;
+
+		void Evaluate(double s, double& elevation, double& grade) const;
+		double Elevation(double s) const;
+
+		const std::vector<Piece>& Pieces() const { return m_pieces; }
+
+		static void EvaluatePiece(const Piece& piece, double s, double& elevation, double& grade);
+
+		// Amortized O(1) evaluation for increasing chainages (sleeper sampling,
+		// train physics); falls back to a search when s moves backwards.
+		class Cursor
+		{
+		public:
+			Cursor() : m_profile(nullptr), m_index(0) {}
+			explicit Cursor(const VerticalProfile& profile) : m_profile(&profile), m_index(0) {}
+
+			void Evaluate(double s, double& elevation, double& grade);
+
+		private:
+			const VerticalProfile* m_profile;
+			size_t m_index;
+		};
+
+	private:
+		std::vector<Piece> m_pieces;
+	};
+}
@@ -0,0 +1,315 @@
+//
+// BveMap.cpp - Headless parser / compiler benchmark for BveTs Map 2.0x routes
+//
+// Usage: bvemap [Map.txt] [-repeat N] [-iterations K] [-window W] [-dump]
+//   -repeat N      parse the statements of the file N times over, each copy
+//                  moved past the end of the one before, as one text (a long
+//                  route)
+//   -iterations K  parse K times and report min / average time
+//   -window W      length (m) of the view window moved along the route to
+//                  expand repeaters (default 1000)
+//   -dump          print the sorted statement table
+//
+// Each iteration also compiles the statements into the event table and
+// converts the curves and gradients into railway commands. Then every
+// structure of the route, repeated ones included, is placed in the world.
+//
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <string>
+#include <string_view>
+
+#include "../Bve/MapCompiler.h"
+#include "../Bve/Repeaters.h"
+#include "../Bve/StructurePlacer.h"
+#include "../Bve/RouteAlignment.h"
+
+namespace
+{
+	struct Options
+	{
+		std::string mapPath = "Assets/Map.txt";
+		int repeat = 1;
+		int iterations = 10;
+		double window = 1000.0;
+		bool dump = false;
+	};
+
+	Options ParseOptions(int argc, char** argv)
+	{
+		Options options;
+		for (int i = 1; i < argc; i++)
+		{
+			if (!strcmp(argv[i], "-repeat") && i + 1 < argc)
+				options.repeat = std::max(1, atoi(argv[++i]));
+			else if (!strcmp(argv[i], "-iterations") && i + 1 < argc)
+				options.iterations = std::max(1, atoi(argv[++i]));
+			else if (!strcmp(argv[i], "-window") && i + 1 < argc)
+				options.window = std::max(0.0, atof(argv[++i]));
+			else if (!strcmp(argv[i], "-dump"))
+				options.dump = true;
+			else
+				options.mapPath = argv[i];
+		}
+		return options;
+	}
+
+	// Appends text with every distance statement (a line of just "123;")
+	// moved by offset
+	void AppendShifted(std::string& out, std::string_view text, double offset)
+	{
+		while (!text.empty())
+		{
+			size_t end = std::min(text.find('\n'), text.size() - 1) + 1;
+			std::string_view line = text.substr(0, end);
+			text.remove_prefix(end);
+
+			size_t first = line.find_first_not_of(" \t");
+			if (first != std::string_view::npos && (isdigit(uint8_t(line[first])) || line[first] == '.'))
+			{
+				std::string number(line.substr(first, line.find(';', first) - first));
+				char* numberEnd = nullptr;
+				double distance = strtod(number.c_str(), &numberEnd);
+				size_t semicolon = line.find(';', first);
+				if (semicolon != std::string_view::npos && numberEnd != number.c_str() &&
+					std::string_view(numberEnd).find_first_not_of(" \t") == std::string_view::npos)
+				{
+					char shifted[64];
+					snprintf(shifted, sizeof(shifted), "%.17g", distance + offset);
+					out.append(line.substr(0, first)).append(shifted).append(line.substr(semicolon));
+					continue;
+				}
+			}
+			out.append(line);
+		}
+	}
+
+	// Moves a view window along the whole route the way a train would,
+	// 10 m at a time, expanding the repeaters that come into it
+	void BenchmarkRepeaters(const Bve::EventTable& table, double window)
+	{
+		if (table.Size() == 0)
+			return;
+		double begin = table.distances.front();
+		double end = table.distances.back();
+
+		auto start = std::chrono::steady_clock::now();
+		Bve::RepeaterIndex index;
+		index.Build(table, end);
+		auto built = std::chrono::steady_clock::now();
+
+		Bve::RepeaterWindow view(index);
+		size_t steps = 0, chunks = 0, peakInstances = 0, peakMemory = 0;
+		for (double s = begin; s <= end; s += 10.0, steps++)
+		{
+			chunks += view.Update(s, s + window);
+			peakInstances = std::max(peakInstances, view.InstanceCount());
+			peakMemory = std::max(peakMemory, view.MemoryUsage());
+		}
+		auto walked = std::chrono::steady_clock::now();
+
+		// The same instances, expanded for the whole route at once
+		std::vector<Bve::RepeaterInstance> all;
+		index.Expand(begin, end, all);
+
+		printf("repeaters  %zu spans, %zu instances over the route (%.1f MB expanded)  index %.3f ms\n",
+			index.Spans().size(), index.InstanceCount(), all.size() * sizeof(Bve::RepeaterInstance) / 1e6,
+			std::chrono::duration<double, std::milli>(built - start).count());
+		printf("window     %.0f m: %zu steps, %zu chunks expanded  %.3f ms (%.2f us per step)  peak %zu instances, %.1f KB\n",
+			window, steps, chunks, std::chrono::duration<double, std::milli>(walked - built).count(),
+			std::chrono::duration<double, std::micro>(walked - built).count() / std::max<size_t>(steps, 1),
+			peakInstances, peakMemory / 1e3);
+	}
+
+	// World frames of every Structure.Put of the route in one pass, and of
+	// every repeated structure, chunk by chunk as the window would
+	void BenchmarkPlacement(const Bve::EventTable& table, const Bve::RouteAlignment& route)
+	{
+		if (table.Size() == 0)
+			return;
+
+		Track::Railway railway;
+		railway.data = route.commands;
+		Track::Alignment alignment;
+		alignment.Build(railway);
+
+		Bve::RepeaterIndex index;
+		index.Build(table, table.distances.back());
+
+		auto start = std::chrono::steady_clock::now();
+		Bve::TrackOffsets offsets;
+		offsets.Build(table);
+		auto built = std::chrono::steady_clock::now();
+
+		std::vector<Bve::PlacedStructure> placed;
+		Bve::StructurePlacer placer(table, alignment, offsets, route.origin);
+		placer.PlaceStructures(placed);
+		auto structures = std::chrono::steady_clock::now();
+
+		Bve::StructurePlacer repeaterPlacer(table, alignment, offsets, route.origin);
+		std::vector<Bve::RepeaterInstance> instances;
+		size_t repeated = 0;
+		long long first = static_cast<long long>(std::floor(table.distances.front() / Bve::REPEATER_CHUNK_LENGTH));
+		long long last = static_cast<long long>(std::floor(table.distances.back() / Bve::REPEATER_CHUNK_LENGTH));
+		for (long long chunk = first; chunk <= last; chunk++)
+		{
+			instances.clear();
+			index.Expand(chunk * Bve::REPEATER_CHUNK_LENGTH, (chunk + 1) * Bve::REPEATER_CHUNK_LENGTH, instances);
+			placed.clear();
+			repeaterPlacer.PlaceRepeaters(instances, placed);
+			repeated += placed.size();
+		}
+		auto end = std::chrono::steady_clock::now();
+
+		double structureMs = std::chrono::duration<double, std::milli>(structures - built).count();
+		double repeaterMs = std::chrono::duration<double, std::milli>(end - structures).count();
+		printf("tracks     %zu offset curves  build %.3f ms\n", offsets.TrackCount(),
+			std::chrono::duration<double, std::milli>(built - start).count());
+		printf("place      %zu structures %.3f ms, %zu repeated (expanded per chunk) %.3f ms  (%.1f Mobjects/s)\n",
+			table.structures.size(), structureMs, repeated, repeaterMs,
+			(table.structures.size() + repeated) / ((structureMs + repeaterMs) * 1e3));
+	}
+
+	void PrintArgument(const Bve::MapFile& map, const Bve::MapArgument& argument)
+	{
+		switch (argument.type)
+		{
+		case Bve::ArgumentType::Null:
+			printf("null");
+			break;
+		case Bve::ArgumentType::Number:
+			printf("%g", argument.number);
+			break;
+		case Bve::ArgumentType::String:
+		{
+			auto name = map.symbols.Name(argument.string);
+			printf("'%.*s'", int(name.size()), name.data());
+			break;
+		}
+		}
+	}
+
+	const char* EVENT_TYPE_NAMES[Bve::EVENT_TYPE_COUNT] = {
+		"CurveTransition", "Curve", "Gauge", "GradientTransition", "Gradient", "TrackPosition", "TrackCant",
+		"StructurePut", "RepeaterBegin", "RepeaterEnd", "Signal", "Section", "Beacon", "SpeedLimit", "Station",
+	};
+
+	void DumpStatements(const Bve::MapFile& map)
+	{
+		auto name = [&map](Bve::Symbol symbol) { return map.symbols.Name(symbol); };
+		for (auto& statement : map.statements)
+		{
+			auto element = name(statement.element);
+			printf("%10.3f  line %5u  %.*s", statement.distance, statement.line, int(element.size()), element.data());
+			if (statement.key != Bve::NO_SYMBOL)
+			{
+				printf("['%.*s']", int(name(statement.key).size()), name(statement.key).data());
+			}
+			if (statement.subElement != Bve::NO_SYMBOL)
+			{
+				printf(".%.*s", int(name(statement.subElement).size()), name(statement.subElement).data());
+			}
+			printf(".%.*s(", int(name(statement.function).size()), name(statement.function).data());
+			auto arguments = map.Arguments(statement);
+			for (uint32_t n = 0; n < statement.argumentCount; n++)
+			{
+				if (n > 0)
+					printf(", ");
+				PrintArgument(map, arguments[n]);
+			}
+			printf(")\n");
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	auto options = ParseOptions(argc, argv);
+
+	Bve::MapFile map;
+	try
+	{
+		map = Bve::LoadMap(options.mapPath);
+	}
+	catch (const std::exception& e)
+	{
+		fprintf(stderr, "bvemap: %s\n", e.what());
+		return 1;
+	}
+
+	auto events = Bve::CompileMap(map);
+	for (auto& error : map.errors)
+	{
+		fprintf(stderr, "bvemap: skipped %s\n", error.c_str());
+	}
+	for (auto& error : events.errors)
+	{
+		fprintf(stderr, "bvemap: not compiled %s\n", error.c_str());
+	}
+	if (options.dump)
+	{
+		DumpStatements(map);
+	}
+
+	// The header once, then the body repeated along the route
+	std::string_view text(map.source->Data(), map.source->Size());
+	std::string_view body = text.substr(std::min(text.find('\n'), text.size()));
+	std::string repeated(text.substr(0, text.size() - body.size()));
+	double period = map.statements.empty() ? 0.0 : std::ceil(map.statements.back().distance / 100.0) * 100.0 + 100.0;
+	for (int r = 0; r < options.repeat; r++)
+	{
+		AppendShifted(repeated, body, r * period);
+	}
+
+	double best = 1e30;
+	double total = 0.0;
+	double bestCompile = 1e30;
+	double bestConvert = 1e30;
+	Bve::MapFile parsed;
+	Bve::EventTable compiled;
+	Bve::RouteAlignment route;
+	for (int i = 0; i < options.iterations; i++)
+	{
+		parsed = Bve::MapFile();
+		auto start = std::chrono::steady_clock::now();
+		Bve::ParseMap(repeated, parsed);
+		auto parsedAt = std::chrono::steady_clock::now();
+		compiled = Bve::CompileMap(parsed);
+		auto compiledAt = std::chrono::steady_clock::now();
+		route = Bve::ConvertAlignment(compiled);
+		auto end = std::chrono::steady_clock::now();
+
+		double ms = std::chrono::duration<double, std::milli>(parsedAt - start).count();
+		best = std::min(best, ms);
+		total += ms;
+		bestCompile = std::min(bestCompile, std::chrono::duration<double, std::milli>(compiledAt - parsedAt).count());
+		bestConvert = std::min(bestConvert, std::chrono::duration<double, std::milli>(end - compiledAt).count());
+	}
+
+	printf("version    %s\n", map.version.c_str());
+	printf("lines      %zu\n", parsed.lines);
+	printf("statements %zu\n", parsed.statements.size());
+	printf("arguments  %zu\n", parsed.arguments.size());
+	printf("symbols    %zu\n", parsed.symbols.Size());
+	printf("errors     %zu\n", parsed.errors.size());
+	printf("parse      min %.3f ms  avg %.3f ms  (%d iterations, %.1f MB)\n",
+		best, total / options.iterations, options.iterations, repeated.size() / 1e6);
+	printf("throughput %.1f MB/s  %.2f Mstatements/s\n",
+		repeated.size() / (best * 1e3), parsed.statements.size() / (best * 1e3));
+	printf("compile    min %.3f ms  %zu events, %zu errors\n", bestCompile, compiled.Size(), compiled.errors.size());
+	for (size_t type = 0; type < Bve::EVENT_TYPE_COUNT; type++)
+	{
+		printf("  %-20s %zu\n", EVENT_TYPE_NAMES[type], compiled.rows[type].size());
+	}
+	printf("alignment  min %.3f ms  %.1f km, %zu commands\n", bestConvert, route.length / 1000.0, route.commands.size());
+	BenchmarkRepeaters(compiled, options.window);
+	BenchmarkPlacement(compiled, route);
+	return 0;
+}
@@ -0,0 +1,153 @@
+//
+// ObjConvert.cpp - Batch OBJ -> SDKMESH converter, in place of meshconvert -sdkmesh -nodds -flipv
+//
+// Usage: objconvert [-o out.sdkmesh] [-compare ref.sdkmesh] [-noflipu] [-flipv] [-iterations K] file.obj...
+//   -o out         output file (one input only); default: the input with the
+//                  extension .sdkmesh
+//   -compare ref   check that the triangles (positions, normals, texcoords)
+//                  are those of ref, meshconvert's output for the same file;
+//                  one input only, fails when they differ
+//   -noflipu       keep the OBJ texture u as it is (meshconvert stores 1 - u)
+//   -flipv         store 1 - v
+//   -iterations K  convert each file K times and report the fastest time
+//
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "../Gfx/SdkMesh.h"
+
+namespace
+{
+	struct Options
+	{
+		std::vector<std::string> inputs;
+		std::string output;
+		std::string compare;
+		Gfx::ObjOptions obj;
+		int iterations = 1;
+	};
+
+	Options ParseOptions(int argc, char** argv)
+	{
+		Options options;
+		for (int i = 1; i < argc; i++)
+		{
+			if (!strcmp(argv[i], "-o") && i + 1 < argc)
+				options.output = argv[++i];
+			else if (!strcmp(argv[i], "-compare") && i + 1 < argc)
+				options.compare = argv[++i];
+			else if (!strcmp(argv[i], "-noflipu"))
+				options.obj.flipU = false;
+			else if (!strcmp(argv[i], "-flipv"))
+				options.obj.flipV = true;
+			else if (!strcmp(argv[i], "-iterations") && i + 1 < argc)
+				options.iterations = std::max(1, atoi(argv[++i]));
+			else
+				options.inputs.push_back(argv[i]);
+		}
+		return options;
+	}
+
+	// A triangle as comparable values: its corners rounded to 1e-3 and
+	// rotated to start at the smallest, which keeps the winding
+	using Corner = std::array<long long, 8>;
+	using Triangle = std::array<Corner, 3>;
+
+	std::vector<Triangle> Triangles(const Gfx::ObjModel& model)
+	{
+		std::vector<Triangle> triangles(model.indices.size() / 3);
+		for (size_t t = 0; t < triangles.size(); t++)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				auto& v = model.vertices[model.indices[t * 3 + k]];
+				float values[8] = { v.position.x, v.position.y, v.position.z, v.normal.x, v.normal.y, v.normal.z, v.u, v.v };
+				for (int n = 0; n < 8; n++)
+				{
+					triangles[t][k][n] = std::llround(values[n] * 1e3);
+				}
+			}
+			auto& triangle = triangles[t];
+			std::rotate(triangle.begin(), std::min_element(triangle.begin(), triangle.end()), triangle.end());
+		}
+		std::sort(triangles.begin(), triangles.end());
+		return triangles;
+	}
+
+	// Triangles of model missing from the reference
+	size_t CompareTriangles(const Gfx::ObjModel& model, const Gfx::ObjModel& reference)
+	{
+		auto ours = Triangles(model);
+		auto theirs = Triangles(reference);
+		std::vector<Triangle> missing;
+		std::set_difference(ours.begin(), ours.end(), theirs.begin(), theirs.end(), std::back_inserter(missing));
+		return missing.size() + (theirs.size() > ours.size() ? theirs.size() - ours.size() : 0);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	auto options = ParseOptions(argc, argv);
+	if (options.inputs.empty() || ((!options.output.empty() || !options.compare.empty()) && options.inputs.size() > 1))
+	{
+		fprintf(stderr, "usage: objconvert [-o out.sdkmesh] [-compare ref.sdkmesh] [-noflipu] [-flipv] [-iterations K] file.obj...\n");
+		return 1;
+	}
+
+	int failed = 0;
+	for (auto& input : options.inputs)
+	{
+		std::filesystem::path source = std::filesystem::u8path(input);
+		std::filesystem::path target = options.output.empty() ?
+			std::filesystem::path(source).replace_extension(".sdkmesh") : std::filesystem::u8path(options.output);
+		try
+		{
+			double loadBest = 1e30, writeBest = 1e30;
+			Gfx::ObjModel model;
+			for (int i = 0; i < options.iterations; i++)
+			{
+				auto start = std::chrono::steady_clock::now();
+				model = Gfx::LoadObj(source, options.obj);
+				auto middle = std::chrono::steady_clock::now();
+				Gfx::SaveSdkMesh(target, model);
+				auto end = std::chrono::steady_clock::now();
+				loadBest = std::min(loadBest, std::chrono::duration<double, std::milli>(middle - start).count());
+				writeBest = std::min(writeBest, std::chrono::duration<double, std::milli>(end - middle).count());
+			}
+
+			double megabytes = std::filesystem::file_size(source) / 1e6;
+			printf("%s -> %s\n", source.u8string().c_str(), target.u8string().c_str());
+			printf("  %zu vertices  %zu triangles  %zu subsets  %zu materials\n",
+				model.vertices.size(), model.indices.size() / 3, model.subsets.size(), model.materials.size());
+			printf("  %.1f MB  parse min %.3f ms (%.1f MB/s)  write min %.3f ms\n",
+				megabytes, loadBest, megabytes / (loadBest / 1e3), writeBest);
+
+			if (!options.compare.empty())
+			{
+				size_t differ = CompareTriangles(model, Gfx::LoadSdkMesh(std::filesystem::u8path(options.compare)));
+				printf("  %s: %zu of %zu triangles differ\n", options.compare.c_str(), differ, model.indices.size() / 3);
+				if (differ > 0)
+				{
+					failed++;
+				}
+			}
+		}
+		catch (const std::exception& e)
+		{
+			fprintf(stderr, "objconvert: %s: %s\n", input.c_str(), e.what());
+			failed++;
+		}
+	}
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,543 @@
+//
+// TrackGen.cpp - Headless route generator / benchmark for the track library
+//
+// Usage: trackgen [World.json] [-repeat N] [-iterations K] [-queries Q] [-camera S] [-maxdraws D] [-static] [-catenary] [-edit] [-dump]
+//   -repeat N      concatenate each railway's command list N times (long route)
+//   -iterations K  generate K times and report min / average time
+//   -queries Q     time Q chainage queries (random At() and a forward Cursor) and
+//                  check the cursor against At() (exit code 3 when they differ)
+//   -camera S      chainage on the first railway the frame is rendered from
+//                  (default: its end)
+//   -maxdraws D    fail (exit code 2) if that frame issues more than D draws
+//   -static        draw near chunks as baked meshes (static batching) instead of
+//                  instances, with a box standing in for the sleeper model
+//   -catenary      draw the overhead line as well
+//   -edit          time an incremental Update after editing one command near the
+//                  end of the first railway, and check it against a full Generate
+//                  (exit code 3 when they differ)
+//   -dump          print every generated frame (B N T Pos)
+//
+// Railways with a "Route" take their commands from that BVE map.
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "../Bve/RouteAlignment.h"
+#include "../Gfx/Catenary.h"
+#include "../Gfx/ChunkBaker.h"
+#include "../Gfx/ChunkCuller.h"
+#include "../Gfx/RailSweep.h"
+#include "../Gfx/RecordingRenderBackend.h"
+#include "../Gfx/SleeperChunks.h"
+#include "../Gfx/TrackRenderer.h"
+#include "../Track/Railway.h"
+#include "../Track/TrackGraph.h"
+
+namespace
+{
+	struct Options
+	{
+		std::string worldPath = "Assets/World.json";
+		int repeat = 1;
+		int iterations = 10;
+		int queries = 0;
+		double camera = INFINITY;
+		long long maxDraws = -1;
+		bool staticBatching = false;
+		bool catenary = false;
+		bool edit = false;
+		bool dump = false;
+	};
+
+	Options ParseOptions(int argc, char** argv)
+	{
+		Options options;
+		for (int i = 1; i < argc; i++)
+		{
+			if (!strcmp(argv[i], "-repeat") && i + 1 < argc)
+				options.repeat = std::max(1, atoi(argv[++i]));
+			else if (!strcmp(argv[i], "-iterations") && i + 1 < argc)
+				options.iterations = std::max(1, atoi(argv[++i]));
+			else if (!strcmp(argv[i], "-queries") && i + 1 < argc)
+				options.queries = std::max(0, atoi(argv[++i]));
+			else if (!strcmp(argv[i], "-camera") && i + 1 < argc)
+				options.camera = atof(argv[++i]);
+			else if (!strcmp(argv[i], "-maxdraws") && i + 1 < argc)
+				options.maxDraws = atoll(argv[++i]);
+			else if (!strcmp(argv[i], "-static"))
+				options.staticBatching = true;
+			else if (!strcmp(argv[i], "-catenary"))
+				options.catenary = true;
+			else if (!strcmp(argv[i], "-edit"))
+				options.edit = true;
+			else if (!strcmp(argv[i], "-dump"))
+				options.dump = true;
+			else
+				options.worldPath = argv[i];
+		}
+		return options;
+	}
+
+	void DumpFrames(const std::vector<Track::Frame>& frames)
+	{
+		for (size_t n = 0; n < frames.size(); n++)
+		{
+			auto& f = frames[n];
+			printf("%zu B(%.4f %.4f %.4f) N(%.4f %.4f %.4f) T(%.4f %.4f %.4f) Pos(%.4f %.4f %.4f)\n", n,
+				f.B.x, f.B.y, f.B.z, f.N.x, f.N.y, f.N.z, f.T.x, f.T.y, f.T.z, f.Pos.x, f.Pos.y, f.Pos.z);
+		}
+	}
+
+	// Largest difference between a cursor's frames and a binary search's
+	const double QUERY_TOLERANCE = 1e-9;
+
+	double FrameDifference(const Track::Frame& a, const Track::Frame& b)
+	{
+		return std::max((a.Pos - b.Pos).Length(), (a.N - b.N).Length());
+	}
+
+	// Random access against sequential stepping over the longest railway.
+	// False when the cursor does not give the frames FrameAt does.
+	bool BenchmarkQueries(const Track::TrackGraph& graph, int queries)
+	{
+		const Track::Alignment* longest = nullptr;
+		for (auto& alignment : graph.Alignments())
+		{
+			if (!longest || alignment.Length() > longest->Length())
+				longest = &alignment;
+		}
+		if (!longest || longest->Length() <= 0.0)
+			return true;
+
+		double length = longest->Length();
+		double step = length / queries;
+		double sink = 0.0;
+
+		std::vector<double> chainages(queries);
+		unsigned int seed = 12345;
+		for (auto& s : chainages)
+		{
+			seed = seed * 1103515245u + 12345u;
+			s = length * ((seed >> 8) / double(1u << 24));
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		for (auto s : chainages)
+		{
+			sink += longest->FrameAt(s).Pos.x;
+		}
+		auto middle = std::chrono::steady_clock::now();
+		Track::Alignment::Cursor cursor(*longest);
+		for (int i = 0; i < queries; i++)
+		{
+			sink += cursor.FrameAt(i * step).Pos.x;
+		}
+		auto end = std::chrono::steady_clock::now();
+
+		double random = std::chrono::duration<double, std::nano>(middle - start).count() / queries;
+		double sequential = std::chrono::duration<double, std::nano>(end - middle).count() / queries;
+		printf("query      %zu segments  random %.1f ns  cursor %.1f ns  (%d queries, checksum %.3f)\n",
+			longest->Segments().size(), random, sequential, queries, sink);
+
+		// One cursor walked forward, then over the random chainages, which
+		// jump back about every other query and make it seek again
+		double difference = 0.0;
+		Track::Alignment::Cursor check(*longest);
+		for (int i = 0; i < queries; i++)
+		{
+			difference = std::max(difference, FrameDifference(check.FrameAt(i * step), longest->FrameAt(i * step)));
+		}
+		for (auto s : chainages)
+		{
+			difference = std::max(difference, FrameDifference(check.FrameAt(s), longest->FrameAt(s)));
+		}
+		bool matches = difference <= QUERY_TOLERANCE;
+		printf("query      cursor %s FrameAt (max difference %.3g)\n", matches ? "matches" : "MISMATCHES", difference);
+		return matches;
+	}
+
+	// 2.6 x 0.2 x 0.24 m box, 24 vertices: stands in for the sleeper model
+	Gfx::MeshData SleeperBox()
+	{
+		const float half[3] = { 1.3f, 0.1f, 0.12f };
+		Gfx::MeshData mesh;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			for (float sign : { -1.f, 1.f })
+			{
+				// Face perpendicular to axis, corners around it
+				int u = (axis + 1) % 3, v = (axis + 2) % 3;
+				uint32_t base = static_cast<uint32_t>(mesh.vertices.size());
+				for (int corner = 0; corner < 4; corner++)
+				{
+					float p[3], n[3] = { 0.f, 0.f, 0.f };
+					p[axis] = sign * half[axis];
+					p[u] = ((corner & 1) ? 1.f : -1.f) * half[u];
+					p[v] = ((corner & 2) ? 1.f : -1.f) * half[v];
+					n[axis] = sign;
+					mesh.vertices.push_back({ { p[0], p[1], p[2] }, { n[0], n[1], n[2] }, 0xffffffff,
+						float(corner & 1), float(corner >> 1) });
+				}
+				mesh.indices.insert(mesh.indices.end(), { base, base + 1, base + 2, base + 2, base + 1, base + 3 });
+			}
+		}
+		return mesh;
+	}
+
+	// Static batching throughput over the first chunks
+	void BenchmarkBaking(const Gfx::SleeperChunks& chunks, int iterations)
+	{
+		std::vector<const Gfx::SleeperChunk*> selected;
+		size_t vertices = 0;
+		std::vector<Gfx::MeshData> parts = { SleeperBox() };
+		for (uint32_t edge = 0; edge < chunks.EdgeCount() && selected.size() < 64; edge++)
+		{
+			for (auto& chunk : chunks.EdgeChunks(edge))
+			{
+				if (selected.size() == 64)
+					break;
+				selected.push_back(&chunk);
+				vertices += chunk.Count() * parts[0].vertices.size();
+			}
+		}
+		if (selected.empty())
+			return;
+
+		std::vector<Gfx::MeshData> baked;
+		double best = 1e30;
+		for (int i = 0; i < iterations; i++)
+		{
+			auto start = std::chrono::steady_clock::now();
+			Gfx::BakeChunks(parts, selected, baked);
+			auto end = std::chrono::steady_clock::now();
+			best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+		}
+		printf("bake       %zu chunks  %zu vertices  min %.3f ms  %.1f Mvertices/s\n",
+			selected.size(), vertices, best, vertices / (best * 1e3));
+	}
+
+	// Sampling every chunk's rails (what an edit of the whole route costs)
+	// and extruding both rails of the first chunks
+	void BenchmarkRails(const Track::TrackGraph& graph, const Gfx::SleeperChunks& chunks, int iterations)
+	{
+		Gfx::RailSweep rails;
+		double sampleBest = 1e30;
+		for (int i = 0; i < iterations; i++)
+		{
+			auto start = std::chrono::steady_clock::now();
+			rails.Rebuild(graph, chunks);
+			auto end = std::chrono::steady_clock::now();
+			sampleBest = std::min(sampleBest, std::chrono::duration<double, std::milli>(end - start).count());
+		}
+
+		auto profile = Gfx::RailProfile::FlatBottom();
+		Gfx::MeshData mesh;
+		size_t meshed = 0, vertices = 0;
+		auto start = std::chrono::steady_clock::now();
+		for (uint32_t edge = 0; edge < chunks.EdgeCount() && meshed < 64; edge++)
+		{
+			for (size_t c = 0; c < chunks.EdgeChunks(edge).size() && meshed < 64; c++, meshed++)
+			{
+				for (int rail = 0; rail < 2; rail++)
+				{
+					Gfx::RailSweep::BuildMesh(rails.GetChunk(edge, c), profile, rail, mesh);
+					vertices += mesh.vertices.size();
+				}
+			}
+		}
+		auto end = std::chrono::steady_clock::now();
+
+		printf("rails      %zu sections (%.1f per chunk)  sample min %.3f ms  mesh %zu chunks %zu vertices %.3f ms\n",
+			rails.SectionCount(), chunks.ChunkCount() ? double(rails.SectionCount()) / chunks.ChunkCount() : 0.0,
+			sampleBest, meshed, vertices, std::chrono::duration<double, std::milli>(end - start).count());
+	}
+
+	// Placing the overhead line of the whole route and building the meshes
+	// of every chunk
+	void BenchmarkCatenary(const Track::TrackGraph& graph, const Gfx::SleeperChunks& chunks, int iterations)
+	{
+		Gfx::Catenary catenary;
+		Gfx::MeshData mesh;
+		double best = 1e30;
+		for (int i = 0; i < iterations; i++)
+		{
+			auto start = std::chrono::steady_clock::now();
+			catenary.Rebuild(graph, chunks);
+			mesh.vertices.clear();
+			mesh.indices.clear();
+			for (uint32_t edge = 0; edge < chunks.EdgeCount(); edge++)
+			{
+				for (size_t c = 0; c < chunks.EdgeChunks(edge).size(); c++)
+				{
+					Gfx::Catenary::AppendMesh(catenary.GetChunk(edge, c), catenary.Settings(), true, mesh);
+				}
+			}
+			auto end = std::chrono::steady_clock::now();
+			best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+		}
+
+		double length = 0.0;
+		for (auto& edge : graph.Edges())
+		{
+			length += edge.s1 - edge.s0;
+		}
+		printf("catenary   %.1f km  %zu supports  %zu vertices  min %.3f ms\n",
+			length / 1000.0, catenary.SupportCount(), mesh.vertices.size(), best);
+	}
+
+	// Serial and parallel culling of every chunk against the frame's frustum
+	void BenchmarkCulling(const Gfx::SleeperChunks& chunks, const Track::Vec3& origin,
+		const Gfx::Float4x4& view, const Gfx::Float4x4& projection, int iterations)
+	{
+		Gfx::ChunkCuller culler;
+		auto buildStart = std::chrono::steady_clock::now();
+		culler.Build(chunks, origin, 1.5f);
+		auto buildEnd = std::chrono::steady_clock::now();
+
+		auto frustum = Gfx::Frustum::FromViewProjection(view, projection);
+		std::vector<uint32_t> serial, parallel;
+		double serialBest = 1e30, parallelBest = 1e30;
+		for (int i = 0; i < iterations; i++)
+		{
+			auto start = std::chrono::steady_clock::now();
+			culler.Cull(frustum, serial);
+			auto middle = std::chrono::steady_clock::now();
+			culler.CullParallel(frustum, parallel);
+			auto end = std::chrono::steady_clock::now();
+			serialBest = std::min(serialBest, std::chrono::duration<double, std::milli>(middle - start).count());
+			parallelBest = std::min(parallelBest, std::chrono::duration<double, std::milli>(end - middle).count());
+		}
+
+		printf("cull       %zu instances  build %.3f ms  serial min %.3f ms  parallel min %.3f ms  %zu visible%s\n",
+			chunks.InstanceCount(), std::chrono::duration<double, std::milli>(buildEnd - buildStart).count(),
+			serialBest, parallelBest, serial.size(), serial == parallel ? "" : "  PARALLEL MISMATCH");
+	}
+
+	// Largest difference between incrementally updated and regenerated frames
+	const double EDIT_TOLERANCE = 1e-9;
+
+	// False when the incremental result differs from a full Generate
+	bool BenchmarkEdit(Track::TrackGraph& graph, Track::World world, int iterations)
+	{
+		if (world.railways.empty() || world.railways[0].data.empty())
+			return true;
+
+		// Lengthen / shorten one command back and forth, ending lengthened
+		auto& data = world.railways[0].data;
+		size_t edited = data.size() * 9 / 10;
+		std::vector<std::string> errors;
+		double best = 1e30;
+		for (int i = 0; i < iterations * 2 - 1; i++)
+		{
+			data[edited].length += (i % 2) ? -3 : 3;
+
+			auto start = std::chrono::steady_clock::now();
+			graph.Update(world, errors);
+			auto end = std::chrono::steady_clock::now();
+			best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+		}
+
+		size_t changedFrames = 0;
+		for (auto& change : graph.Changes())
+		{
+			changedFrames += graph.EdgeFrames(change.edge).size() - change.firstFrame;
+		}
+
+		// The incremental result must match generating the edited world from scratch
+		Track::TrackGraph full;
+		full.Build(world, errors);
+		full.Generate();
+		double deviation = 0.0;
+		bool sameCount = full.Edges().size() == graph.Edges().size();
+		for (uint32_t e = 0; sameCount && e < full.Edges().size(); e++)
+		{
+			auto& a = full.EdgeFrames(e);
+			auto& b = graph.EdgeFrames(e);
+			sameCount = a.size() == b.size();
+			for (size_t n = 0; sameCount && n < a.size(); n++)
+			{
+				deviation = std::max(deviation, (a[n].Pos - b[n].Pos).Length() + (a[n].N - b[n].N).Length());
+			}
+		}
+
+		bool matches = sameCount && deviation <= EDIT_TOLERANCE;
+		printf("edit       command %zu  update min %.3f ms  %zu frames rewritten  %s (max deviation %.3g)\n",
+			edited, best, changedFrames,
+			!sameCount ? "FRAME COUNT MISMATCH" : matches ? "matches full generate" : "FRAME MISMATCH", deviation);
+		return matches;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	auto options = ParseOptions(argc, argv);
+
+	Track::World world;
+	try
+	{
+		world = Track::LoadWorldFile(options.worldPath);
+	}
+	catch (const std::exception& e)
+	{
+		fprintf(stderr, "trackgen: %s\n", e.what());
+		return 1;
+	}
+	Bve::LoadRoutes(world, std::filesystem::path(options.worldPath).parent_path());
+
+	for (auto& error : world.errors)
+	{
+		fprintf(stderr, "trackgen: skipped %s\n", error.c_str());
+	}
+
+	for (auto& railway : world.railways)
+	{
+		auto data = railway.data;
+		for (int r = 1; r < options.repeat; r++)
+		{
+			railway.data.insert(railway.data.end(), data.begin(), data.end());
+		}
+	}
+
+	Track::TrackGraph graph;
+	std::vector<std::string> errors;
+	graph.Build(world, errors);
+	for (auto& error : errors)
+	{
+		fprintf(stderr, "trackgen: %s\n", error.c_str());
+	}
+
+	double best = 1e30;
+	double total = 0.0;
+	for (int i = 0; i < options.iterations; i++)
+	{
+		auto start = std::chrono::steady_clock::now();
+		graph.Generate();
+		auto end = std::chrono::steady_clock::now();
+
+		double ms = std::chrono::duration<double, std::milli>(end - start).count();
+		best = std::min(best, ms);
+		total += ms;
+	}
+
+	if (options.dump)
+	{
+		for (uint32_t e = 0; e < graph.Edges().size(); e++)
+		{
+			auto& edge = graph.Edges()[e];
+			printf("edge %u railway %s (%.3f, %.3f]\n", e, graph.Railways()[edge.railway].name.c_str(), edge.s0, edge.s1);
+			DumpFrames(graph.EdgeFrames(e));
+		}
+	}
+
+	size_t commands = 0;
+	for (auto& railway : world.railways)
+	{
+		commands += railway.data.size();
+	}
+	size_t frames = graph.FrameCount();
+
+	printf("railways   %zu\n", world.railways.size());
+	printf("turnouts   %zu\n", graph.Turnouts().size());
+	printf("edges      %zu\n", graph.Edges().size());
+	printf("commands   %zu\n", commands);
+	printf("frames     %zu\n", frames);
+	printf("generate   min %.3f ms  avg %.3f ms  (%d iterations)\n", best, total / options.iterations, options.iterations);
+	printf("throughput %.1f Mframes/s\n", frames / (best * 1e3));
+
+	// One frame submitted through the recording backend the way Game::Render
+	// does it: the reference cube, then the track
+	Gfx::SleeperChunks chunks;
+	chunks.Rebuild(graph);
+	Gfx::RailSweep rails;
+	rails.Rebuild(graph, chunks);
+	Gfx::Catenary catenary;
+	catenary.Rebuild(graph, chunks);
+	printf("chunks     %zu  %.1f bytes/sleeper\n", chunks.ChunkCount(),
+		chunks.InstanceCount() ? double(chunks.MemoryUsage()) / chunks.InstanceCount() : 0.0);
+
+	// Camera on the first railway, eye height above the track, looking ahead;
+	// same projection as the game
+	Track::Frame cameraFrame;
+	if (!graph.Alignments().empty())
+	{
+		auto& first = graph.Alignments()[0];
+		cameraFrame = first.FrameAt(std::min(std::max(options.camera, 0.0), first.Length()));
+	}
+	Track::Vec3 camera = cameraFrame.Pos + Track::Vec3{ 0.0, 2.5, 0.0 };
+
+	Gfx::RecordingRenderBackend backend;
+	uint32_t cube = backend.RegisterModel(1);
+	static const int heap = 0;   // any address stands in for the texture heap
+	Gfx::TrackRenderer renderer;
+	renderer.SetSleeperModel(backend.RegisterModel(1, &heap), 1.5f);
+	renderer.SetRailModel(backend.RegisterModel(1, &heap));
+	if (options.staticBatching)
+	{
+		renderer.SetSleeperMeshes({ SleeperBox() });
+		renderer.SetStaticBatching(true);
+	}
+
+	Gfx::Float4x4 view;
+	auto projection = Gfx::PerspectiveFovRH(3.14159265f / 4.f, 16.f / 9.f, 0.1f, 500.f);
+	auto renderFrame = [&]()
+	{
+		backend.Reset();
+		backend.BeginFrame();
+		renderer.FollowCamera(camera, 500.0);
+		auto& origin = renderer.Origin();
+		auto eye = camera - origin;
+		Gfx::Float3 eyeF = { float(eye.x), float(eye.y), float(eye.z) };
+		Gfx::Float3 target = { eyeF.x + float(cameraFrame.T.x), eyeF.y + float(cameraFrame.T.y), eyeF.z + float(cameraFrame.T.z) };
+		view = Gfx::LookAtRH(eyeF, target, { 0.f, 1.f, 0.f });
+
+		backend.SetMatrices(Gfx::TranslationMatrix(float(-origin.x), float(-origin.y), float(-origin.z)), view, projection);
+		backend.Draw(cube);
+		renderer.Render(backend, chunks, rails, options.catenary ? &catenary : nullptr, view, projection);
+	};
+
+	auto frameStart = std::chrono::steady_clock::now();
+	renderFrame();
+	auto frameEnd = std::chrono::steady_clock::now();
+	auto first = backend.GetStats();
+	printf("frame      first %.3f ms  %zu bytes uploaded  %zu draws  %zu visible  %zu mesh draws  %zu state changes\n",
+		std::chrono::duration<double, std::milli>(frameEnd - frameStart).count(),
+		first.uploadedBytes, first.draws, first.instances, first.meshDraws, first.stateChanges);
+
+	renderFrame();
+	auto& steady = backend.GetStats();
+	printf("frame      steady %zu bytes uploaded  %zu draws  %zu visible  %zu mesh draws  %zu state changes\n",
+		steady.uploadedBytes, steady.draws, steady.instances, steady.meshDraws, steady.stateChanges);
+
+	BenchmarkCulling(chunks, renderer.Origin(), view, projection, options.iterations);
+	BenchmarkBaking(chunks, options.iterations);
+	BenchmarkRails(graph, chunks, options.iterations);
+	BenchmarkCatenary(graph, chunks, options.iterations);
+
+	if (options.maxDraws >= 0 && first.draws > size_t(options.maxDraws))
+	{
+		fprintf(stderr, "trackgen: frame issued %zu draws, limit %lld\n", first.draws, options.maxDraws);
+		return 2;
+	}
+
+	if (options.queries > 0 && !BenchmarkQueries(graph, options.queries))
+	{
+		fprintf(stderr, "trackgen: cursor frames differ from FrameAt\n");
+		return 3;
+	}
+
+	if (options.edit && !BenchmarkEdit(graph, world, options.iterations))
+	{
+		fprintf(stderr, "trackgen: incremental update differs from a full generate\n");
+		return 3;
+	}
+	return 0;
+}